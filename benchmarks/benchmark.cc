@@ -32,12 +32,24 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <string>
 #include <vector>
 
 #include "google/ads/googleads/v13/services/google_ads_service.upbdefs.h"
 #include "google/protobuf/descriptor.pb.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "google/protobuf/dynamic_message.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/parse_context.h"
+#include "google/protobuf/repeated_field.h"
+#include "google/protobuf/util/delimited_message_util.h"
+#include "google/protobuf/util/field_mask_util.h"
+#include "google/protobuf/util/field_projection.h"
 #include "benchmarks/descriptor.pb.h"
 #include "benchmarks/descriptor.upb.h"
 #include "benchmarks/descriptor.upbdefs.h"
@@ -354,6 +366,130 @@ BENCHMARK_TEMPLATE(BM_Parse_Proto2, FileDesc, UseArena, Copy);
 BENCHMARK_TEMPLATE(BM_Parse_Proto2, FileDesc, InitBlock, Copy);
 BENCHMARK_TEMPLATE(BM_Parse_Proto2, FileDescSV, InitBlock, Alias);
 
+enum Projection {
+  NoProjection,
+  FewFields,
+  MostFields,
+};
+
+// FieldProjection filters the input into a buffer and parses that, so it only
+// pays off when the selected fields are a small part of the input.
+template <Projection kProjection>
+static void BM_Parse_Proto2_Projection(benchmark::State& state) {
+  const protobuf::util::FieldProjection* projection = nullptr;
+  if (kProjection != NoProjection) {
+    protobuf::FieldMask mask;
+    protobuf::util::FieldMaskUtil::FromString(
+        kProjection == FewFields ? "name,package" : "message_type", &mask);
+    projection =
+        protobuf::util::FieldProjection::Cached(FileDesc::descriptor(), mask);
+  }
+  FileDesc proto;
+  for (auto _ : state) {
+    bool ok;
+    if (kProjection == NoProjection) {
+      proto.Clear();
+      ok = proto.ParsePartialFromArray(descriptor.data, descriptor.size);
+    } else {
+      ok = projection->ParsePartialFromString(
+          absl::string_view(descriptor.data, descriptor.size), &proto);
+    }
+    if (!ok) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * descriptor.size);
+}
+BENCHMARK_TEMPLATE(BM_Parse_Proto2_Projection, NoProjection);
+BENCHMARK_TEMPLATE(BM_Parse_Proto2_Projection, FewFields);
+BENCHMARK_TEMPLATE(BM_Parse_Proto2_Projection, MostFields);
+
+// A packed int32 field holding values of `bits` bits. With 7 bits all of them
+// are single byte varints.
+static upb_benchmark::SourceCodeInfo::Location PackedVarintLocation(int bits) {
+  const uint32_t mask = (uint32_t{1} << bits) - 1;
+  upb_benchmark::SourceCodeInfo::Location location;
+  uint32_t value = 0x9e3779b9;
+  for (int i = 0; i < 4096; i++) {
+    value = value * 1664525 + 1013904223;
+    location.add_path(static_cast<int32_t>(value & mask));
+  }
+  return location;
+}
+
+static void BM_Parse_Proto2_PackedVarint(benchmark::State& state) {
+  upb_benchmark::SourceCodeInfo::Location location =
+      PackedVarintLocation(state.range(0));
+  const std::string input = location.SerializeAsString();
+  for (auto _ : state) {
+    location.Clear();
+    if (!location.ParseFromString(input)) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Parse_Proto2_PackedVarint)->Arg(7)->Arg(14)->Arg(28);
+
+enum PackedVarintDecoder { Bulk, OneByOne };
+
+// Decodes the payload of PackedVarintLocation() into a RepeatedField.
+// Bulk is what the parser does: count the varints with CountVarintEnds(),
+// which uses SIMD where the library was built for it, then reserve once.
+// OneByOne is the scalar path, which adds the values one at a time.
+template <PackedVarintDecoder kDecoder>
+static void BM_DecodePackedVarint(benchmark::State& state) {
+  std::string input;
+  {
+    protobuf::io::StringOutputStream output(&input);
+    protobuf::io::CodedOutputStream coded(&output);
+    for (int32_t value : PackedVarintLocation(state.range(0)).path()) {
+      coded.WriteVarint32(static_cast<uint32_t>(value));
+    }
+  }
+  const size_t size = input.size();
+  // Like the parser, the decoders may read up to 16 bytes past the end.
+  input.append(16, '\0');
+  const char* const begin = input.data();
+  const char* const end = begin + size;
+  protobuf::RepeatedField<int32_t> field;
+  for (auto _ : state) {
+    field.Clear();
+    const char* ptr;
+    if (kDecoder == Bulk) {
+      ptr = protobuf::internal::ReadPackedVarintArray(
+          begin, end, protobuf::internal::PackedVarintSink<int32_t, false>{
+                          &field});
+    } else {
+      ptr = protobuf::internal::ReadPackedVarintArray(
+          begin, end, [&field](uint64_t varint) {
+            field.Add(static_cast<int32_t>(varint));
+          });
+    }
+    if (ptr != end) {
+      printf("Failed to decode.\n");
+      exit(1);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK_TEMPLATE(BM_DecodePackedVarint, Bulk)->Arg(7)->Arg(14)->Arg(28);
+BENCHMARK_TEMPLATE(BM_DecodePackedVarint, OneByOne)->Arg(7)->Arg(14)->Arg(28);
+
+static void BM_Serialize_Proto2_PackedVarint(benchmark::State& state) {
+  const upb_benchmark::SourceCodeInfo::Location location =
+      PackedVarintLocation(state.range(0));
+  size_t size = 0;
+  for (auto _ : state) {
+    size = location.ByteSizeLong();
+    location.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf));
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_Serialize_Proto2_PackedVarint)->Arg(7)->Arg(14)->Arg(28);
+
 static void BM_SerializeDescriptor_Proto2(benchmark::State& state) {
   upb_benchmark::FileDescriptorProto proto;
   proto.ParseFromArray(descriptor.data, descriptor.size);
@@ -388,3 +524,97 @@ static void BM_SerializeDescriptor_Upb(benchmark::State& state) {
   state.SetBytesProcessed(total);
 }
 BENCHMARK(BM_SerializeDescriptor_Upb);
+
+static void BM_GzipOutputStream(benchmark::State& state) {
+  // Words picked at random compress roughly like text protos and logs.
+  static const char* const kWords[] = {"message", "field", "optional",
+                                       "repeated", "int32", "string",
+                                       "enum", "1234", " ", "\n"};
+  std::string data;
+  uint32_t random = 1;
+  while (data.size() < (16 << 20)) {
+    random = random * 1103515245 + 12345;
+    data += kWords[(random >> 16) % 10];
+  }
+  protobuf::io::GzipOutputStream::Options options;
+  options.num_threads = state.range(0);
+  std::string compressed;
+  for (auto _ : state) {
+    compressed.clear();
+    protobuf::io::StringOutputStream output(&compressed);
+    protobuf::io::GzipOutputStream gzip_output(&output, options);
+    size_t written = 0;
+    while (written < data.size()) {
+      void* buffer;
+      int size;
+      gzip_output.Next(&buffer, &size);
+      const int n = static_cast<int>(
+          std::min(static_cast<size_t>(size), data.size() - written));
+      memcpy(buffer, data.data() + written, n);
+      gzip_output.BackUp(size - n);
+      written += n;
+    }
+    gzip_output.Close();
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_GzipOutputStream)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+enum DelimitedParse { PerMessage, Reader, OneBuffer };
+
+// Parses many small length-delimited messages. OneBuffer parses the same
+// bytes, each preceded by a tag, as the repeated field of one message, which
+// is as fast as framing can get.
+template <DelimitedParse kParse>
+static void BM_ParseDelimited(benchmark::State& state) {
+  upb_benchmark::DescriptorProto all;
+  for (int i = 0; i < 100000; i++) {
+    upb_benchmark::FieldDescriptorProto* field = all.add_field();
+    field->set_name(absl::StrCat("field_", i));
+    field->set_number(i + 1);
+    field->set_type(upb_benchmark::FieldDescriptorProto::TYPE_INT32);
+  }
+  std::string data;
+  if (kParse == OneBuffer) {
+    all.SerializeToString(&data);
+  } else {
+    protobuf::io::StringOutputStream output(&data);
+    for (const auto& field : all.field()) {
+      protobuf::util::SerializeDelimitedToZeroCopyStream(field, &output);
+    }
+  }
+  for (auto _ : state) {
+    protobuf::Arena arena;
+    protobuf::io::ArrayInputStream input(data.data(),
+                                         static_cast<int>(data.size()));
+    bool ok = true;
+    if (kParse == PerMessage) {
+      for (int i = 0; i < all.field_size(); i++) {
+        auto* field = protobuf::Arena::CreateMessage<
+            upb_benchmark::FieldDescriptorProto>(&arena);
+        ok &= protobuf::util::ParseDelimitedFromZeroCopyStream(field, &input,
+                                                               nullptr);
+      }
+    } else if (kParse == Reader) {
+      protobuf::util::DelimitedMessageReader reader(&input);
+      std::vector<protobuf::MessageLite*> messages;
+      messages.reserve(all.field_size());
+      ok = reader.ReadMessages(upb_benchmark::FieldDescriptorProto(), &arena,
+                               all.field_size(),
+                               &messages) == all.field_size();
+    } else {
+      auto* proto =
+          protobuf::Arena::CreateMessage<upb_benchmark::DescriptorProto>(
+              &arena);
+      ok = proto->ParseFromZeroCopyStream(&input);
+    }
+    if (!ok) {
+      printf("Failed to parse.\n");
+      exit(1);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK_TEMPLATE(BM_ParseDelimited, PerMessage);
+BENCHMARK_TEMPLATE(BM_ParseDelimited, Reader);
+BENCHMARK_TEMPLATE(BM_ParseDelimited, OneBuffer);
@@ -41,6 +41,12 @@ function(protobuf_configure_target target)
       target_compile_definitions("${target}" PRIVATE -DGOOGLE_PROTOBUF_NO_RTTI=1)
     endif()
 
+    # This changes the layout of google::protobuf::Map, so the code using the
+    # libraries must be built with it too.
+    if (protobuf_MAP_FLAT_TABLE)
+      target_compile_definitions("${target}" PUBLIC -DGOOGLE_PROTOBUF_MAP_FLAT_TABLE=1)
+    endif()
+
     # The Intel compiler isn't able to deal with noinline member functions of
     # template classes defined in headers.  As such it spams the output with
     #   warning #2196: routine is both "inline" and "noinline"
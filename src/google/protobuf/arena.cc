@@ -20,6 +20,7 @@
 #include "absl/container/internal/layout.h"
 #include "absl/synchronization/mutex.h"
 #include "google/protobuf/arena_allocation_policy.h"
+#include "google/protobuf/arena_block_pool.h"
 #include "google/protobuf/arenaz_sampler.h"
 #include "google/protobuf/port.h"
 #include "google/protobuf/serial_arena.h"
@@ -79,6 +80,7 @@ static SizedPtr AllocateMemory(const AllocationPolicy* policy_ptr,
   size = std::max(size, SerialArena::kBlockHeaderSize + min_bytes);
 
   if (policy.block_alloc == nullptr) {
+    if (policy.use_block_pool) return ArenaBlockPool::Global().Allocate(size);
     return AllocateAtLeast(size);
   }
   return {policy.block_alloc(size), size};
@@ -88,6 +90,8 @@ class GetDeallocator {
  public:
   GetDeallocator(const AllocationPolicy* policy, size_t* space_allocated)
       : dealloc_(policy ? policy->block_dealloc : nullptr),
+        use_block_pool_(policy != nullptr && policy->use_block_pool &&
+                        policy->block_alloc == nullptr),
         space_allocated_(space_allocated) {}
 
   void operator()(SizedPtr mem) const {
@@ -96,7 +100,9 @@ class GetDeallocator {
     // so return it in an unpoisoned state.
     ASAN_UNPOISON_MEMORY_REGION(mem.p, mem.n);
 #endif  // ADDRESS_SANITIZER
-    if (dealloc_) {
+    if (use_block_pool_) {
+      ArenaBlockPool::Global().Deallocate(mem);
+    } else if (dealloc_) {
       dealloc_(mem.p, mem.n);
     } else {
       internal::SizedDelete(mem.p, mem.n);
@@ -106,6 +112,7 @@ class GetDeallocator {
 
  private:
   void (*dealloc_)(void*, size_t);
+  bool use_block_pool_;
   size_t* space_allocated_;
 };
 
@@ -259,7 +266,7 @@ void SerialArena::AllocateNewBlock(size_t n) {
   // but with a CPU regression. The regression might have been an artifact of
   // the microbenchmark.
 
-  auto mem = AllocateMemory(parent_.AllocPolicy(), old_head->size, n);
+  auto mem = parent_.AllocateBlock(old_head->size, n);
   // We don't want to emit an expensive RMW instruction that requires
   // exclusive access to a cacheline. Hence we write it in terms of a
   // regular add.
@@ -679,6 +686,11 @@ ThreadSafeArena::~ThreadSafeArena() {
   CleanupList();
 
   size_t space_allocated = 0;
+  // The policy may live in the first block, so read it before any block is
+  // freed. Retained blocks never include the first block and are released
+  // first, while the policy is still alive.
+  const GetDeallocator deallocator(alloc_policy_.get(), &space_allocated);
+  FreeRetainedBlocks(deallocator);
   auto mem = Free(&space_allocated);
   if (alloc_policy_.is_user_owned_initial_block()) {
 #ifdef ADDRESS_SANITIZER
@@ -687,12 +699,90 @@ ThreadSafeArena::~ThreadSafeArena() {
 #endif  // ADDRESS_SANITIZER
     space_allocated += mem.n;
   } else if (mem.n > 0) {
-    GetDeallocator(alloc_policy_.get(), &space_allocated)(mem);
+    deallocator(mem);
+  }
+}
+
+SizedPtr ThreadSafeArena::AllocateBlock(size_t last_size, size_t min_bytes) {
+  if (PROTOBUF_PREDICT_FALSE(space_retained_.load(std::memory_order_relaxed) !=
+                             0)) {
+    SizedPtr mem = TakeRetainedBlock(min_bytes);
+    if (mem.p != nullptr) return mem;
   }
+  return AllocateMemory(alloc_policy_.get(), last_size, min_bytes);
+}
+
+bool ThreadSafeArena::RetainBlock(SizedPtr mem) {
+  const AllocationPolicy* policy = alloc_policy_.get();
+  if (policy == nullptr) return false;
+  ABSL_DCHECK_GE(mem.n, sizeof(RetainedBlock));
+
+  absl::MutexLock lock(&mutex_);
+  size_t retained = space_retained_.load(std::memory_order_relaxed);
+  ABSL_DCHECK_LE(retained, policy->max_retained_bytes);
+  if (mem.n > policy->max_retained_bytes - retained) return false;
+
+#ifdef ADDRESS_SANITIZER
+  ASAN_UNPOISON_MEMORY_REGION(mem.p, sizeof(RetainedBlock));
+#endif  // ADDRESS_SANITIZER
+  retained_blocks_ = new (mem.p) RetainedBlock{retained_blocks_, mem.n};
+  space_retained_.store(retained + mem.n, std::memory_order_relaxed);
+#ifdef ADDRESS_SANITIZER
+  // Nothing may touch the payload until the block is handed out again.
+  ASAN_POISON_MEMORY_REGION(static_cast<char*>(mem.p) + sizeof(RetainedBlock),
+                            mem.n - sizeof(RetainedBlock));
+#endif  // ADDRESS_SANITIZER
+  return true;
 }
 
-SizedPtr ThreadSafeArena::Free(size_t* space_allocated) {
-  auto deallocator = GetDeallocator(alloc_policy_.get(), space_allocated);
+SizedPtr ThreadSafeArena::TakeRetainedBlock(size_t min_bytes) {
+  // Same overflow guard as AllocateMemory().
+  if (min_bytes > std::numeric_limits<size_t>::max() - kBlockHeaderSize) {
+    return {nullptr, 0};
+  }
+  const size_t required = kBlockHeaderSize + min_bytes;
+
+  absl::MutexLock lock(&mutex_);
+  // Reset() releases the newest (largest) blocks of each arena first, so the
+  // list starts with the smallest blocks and the first fit tends to be tight.
+  for (RetainedBlock** link = &retained_blocks_; *link != nullptr;
+       link = &(*link)->next) {
+    RetainedBlock* b = *link;
+    if (b->size < required) continue;
+    *link = b->next;
+    SizedPtr mem = {b, b->size};
+    space_retained_.store(
+        space_retained_.load(std::memory_order_relaxed) - mem.n,
+        std::memory_order_relaxed);
+#ifdef ADDRESS_SANITIZER
+    ASAN_UNPOISON_MEMORY_REGION(mem.p, mem.n);
+#endif  // ADDRESS_SANITIZER
+    return mem;
+  }
+  return {nullptr, 0};
+}
+
+template <typename Deallocator>
+void ThreadSafeArena::FreeRetainedBlocks(Deallocator deallocator) {
+  RetainedBlock* b = retained_blocks_;
+  while (b != nullptr) {
+    RetainedBlock* next = b->next;
+    deallocator(SizedPtr{b, b->size});
+    b = next;
+  }
+  retained_blocks_ = nullptr;
+  space_retained_.store(0, std::memory_order_relaxed);
+}
+
+SizedPtr ThreadSafeArena::Free(size_t* space_allocated, bool retain_blocks) {
+  auto dealloc = GetDeallocator(alloc_policy_.get(), space_allocated);
+  auto deallocator = [&](SizedPtr mem) {
+    if (retain_blocks && RetainBlock(mem)) {
+      *space_allocated += mem.n;
+    } else {
+      dealloc(mem);
+    }
+  };
 
   WalkSerialArenaChunk([&](SerialArenaChunk* chunk) {
     absl::Span<std::atomic<SerialArena*>> span = chunk->arenas();
@@ -726,9 +816,12 @@ uint64_t ThreadSafeArena::Reset() {
   CleanupList();
 
   // Discard all blocks except the first one. Whether it is user-provided or
-  // allocated, always reuse the first block for the first arena.
+  // allocated, always reuse the first block for the first arena. Discarded
+  // blocks are kept for reuse up to AllocationPolicy::max_retained_bytes.
   size_t space_allocated = 0;
-  auto mem = Free(&space_allocated);
+  const AllocationPolicy* policy = alloc_policy_.get();
+  auto mem = Free(&space_allocated,
+                  policy != nullptr && policy->max_retained_bytes != 0);
   space_allocated += mem.n;
 
   // Reset the first arena with the first block. This avoids redundant
@@ -893,8 +986,7 @@ SerialArena* ThreadSafeArena::GetSerialArenaFallback(size_t n) {
     // This thread doesn't have any SerialArena, which also means it doesn't
     // have any blocks yet.  So we'll allocate its first block now. It must be
     // big enough to host SerialArena and the pending request.
-    serial = SerialArena::New(
-        AllocateMemory(alloc_policy_.get(), 0, n + kSerialArenaSize), *this);
+    serial = SerialArena::New(AllocateBlock(0, n + kSerialArenaSize), *this);
 
     AddSerialArena(id, serial);
   }
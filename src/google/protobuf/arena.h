@@ -101,6 +101,22 @@ struct ArenaOptions {
   // here.
   size_t max_block_size = internal::AllocationPolicy::kDefaultMaxBlockSize;
 
+  // The maximum number of bytes of blocks that Reset() keeps around instead of
+  // returning them to the system allocator. Retained blocks are handed out
+  // again before any new block is requested, so an arena that is reset between
+  // requests of similar size stops allocating after the first cycle. The
+  // retained blocks are released when the arena is destroyed. Zero (the
+  // default) frees all blocks except the initial one on Reset().
+  size_t max_retained_bytes = 0;
+
+  // If true, blocks are taken from and returned to the process-wide
+  // ArenaBlockPool (see arena_block_pool.h) instead of being allocated and
+  // freed individually. This helps servers that create many short-lived
+  // arenas. Ignored if block_alloc is set. The pool is shared by all arenas, so
+  // its limits, including the total size of the blocks it keeps, are set with
+  // ArenaBlockPool::Global().SetOptions().
+  bool use_block_pool = false;
+
   // An initial block of memory for the arena to use, or nullptr for none. If
   // provided, the block must live at least as long as the arena itself. The
   // creator of the Arena retains ownership of the block after the Arena is
@@ -126,6 +142,8 @@ struct ArenaOptions {
     internal::AllocationPolicy res;
     res.start_block_size = start_block_size;
     res.max_block_size = max_block_size;
+    res.max_retained_bytes = max_retained_bytes;
+    res.use_block_pool = use_block_pool;
     res.block_alloc = block_alloc;
     res.block_dealloc = block_dealloc;
     return res;
@@ -319,12 +337,18 @@ class PROTOBUF_EXPORT PROTOBUF_ALIGNAS(8) Arena final {
   // can lead to underestimates of the space used, and race conditions can lead
   // to overestimates (up to the current block size).
   uint64_t SpaceUsed() const { return impl_.SpaceUsed(); }
+  // Returns the total size of the blocks kept by Reset() for reuse (see
+  // ArenaOptions::max_retained_bytes) that are not currently in use. These
+  // bytes are not included in SpaceAllocated().
+  uint64_t SpaceRetained() const { return impl_.SpaceRetained(); }
 
   // Frees all storage allocated by this arena after calling destructors
   // registered with OwnDestructor() and freeing objects registered with Own().
   // Any objects allocated on this arena are unusable after this call. It also
   // returns the total space used by the arena which is the sums of the sizes
-  // of the allocated blocks. This method is not thread-safe.
+  // of the allocated blocks. If ArenaOptions::max_retained_bytes is set, blocks
+  // up to that limit are kept for subsequent allocations instead of being
+  // freed. This method is not thread-safe.
   uint64_t Reset() { return impl_.Reset(); }
 
   // Adds |object| to a list of heap-allocated objects to be freed with |delete|
@@ -27,12 +27,22 @@ struct AllocationPolicy {
   size_t start_block_size = kDefaultStartBlockSize;
   size_t max_block_size = kDefaultMaxBlockSize;
 
+  // Upper bound on the bytes of blocks that `ThreadSafeArena::Reset()` keeps
+  // for reuse instead of returning them to `block_dealloc`. Zero disables
+  // retention.
+  size_t max_retained_bytes = 0;
+
+  // If true and `block_alloc` is not set, blocks come from and go back to
+  // `ArenaBlockPool::Global()`.
+  bool use_block_pool = false;
+
   void* (*block_alloc)(size_t) = nullptr;
   void (*block_dealloc)(void*, size_t) = nullptr;
 
   bool IsDefault() const {
     return start_block_size == kDefaultStartBlockSize &&
-           max_block_size == kDefaultMaxBlockSize && block_alloc == nullptr &&
+           max_block_size == kDefaultMaxBlockSize && max_retained_bytes == 0 &&
+           !use_block_pool && block_alloc == nullptr &&
            block_dealloc == nullptr;
   }
 };
@@ -0,0 +1,191 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/arena_block_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "absl/numeric/bits.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/port.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif  // __linux__
+
+#ifdef ADDRESS_SANITIZER
+#include <sanitizer/asan_interface.h>
+#endif  // ADDRESS_SANITIZER
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+
+using internal::SizedPtr;
+
+namespace {
+
+// Picks a shard for platforms where the current CPU is unknown.
+size_t ThreadShardHint() {
+  return std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
+}  // namespace
+
+ArenaBlockPool& ArenaBlockPool::Global() {
+  static ArenaBlockPool* const pool = new ArenaBlockPool();
+  return *pool;
+}
+
+ArenaBlockPool::ArenaBlockPool() : ArenaBlockPool(Options()) {}
+
+ArenaBlockPool::ArenaBlockPool(const Options& options)
+    : max_free_blocks_per_class_(options.max_free_blocks_per_class),
+      max_free_bytes_(options.max_free_bytes) {}
+
+ArenaBlockPool::~ArenaBlockPool() { Trim(); }
+
+void ArenaBlockPool::SetOptions(const Options& options) {
+  max_free_blocks_per_class_.store(options.max_free_blocks_per_class,
+                                   std::memory_order_relaxed);
+  max_free_bytes_.store(options.max_free_bytes, std::memory_order_relaxed);
+  if (free_bytes_.load(std::memory_order_relaxed) > options.max_free_bytes) {
+    Trim();
+  }
+}
+
+int ArenaBlockPool::ClassIndex(size_t size) {
+  if (size <= kMinBlockSize) return 0;
+  return static_cast<int>(absl::bit_width(size - 1)) - kMinSizeLog;
+}
+
+ArenaBlockPool::Shard& ArenaBlockPool::CurrentShard() {
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (PROTOBUF_PREDICT_TRUE(cpu >= 0)) {
+    return shards_[static_cast<size_t>(cpu) % kNumShards];
+  }
+#endif  // __linux__
+  return shards_[ThreadShardHint() % kNumShards];
+}
+
+SizedPtr ArenaBlockPool::Allocate(size_t size) {
+  if (size > kMaxBlockSize) return internal::AllocateAtLeast(size);
+
+  const int index = ClassIndex(size);
+  Shard& shard = CurrentShard();
+  {
+    absl::MutexLock lock(&shard.mutex);
+    FreeBlock* block = shard.free_blocks[index];
+    if (block != nullptr) {
+#ifdef ADDRESS_SANITIZER
+      ASAN_UNPOISON_MEMORY_REGION(block, ClassSize(index));
+#endif  // ADDRESS_SANITIZER
+      shard.free_blocks[index] = block->next;
+      --shard.num_free[index];
+      ++shard.hits;
+      free_bytes_.fetch_sub(ClassSize(index), std::memory_order_relaxed);
+      return {block, ClassSize(index)};
+    }
+    ++shard.misses;
+  }
+  // Don't use AllocateAtLeast() here: the block must stay in its size class.
+  return {::operator new(ClassSize(index)), ClassSize(index)};
+}
+
+void ArenaBlockPool::Deallocate(SizedPtr mem) {
+  // Only exact size classes can be cached. Anything else came from a request
+  // larger than kMaxBlockSize.
+  if (mem.n < kMinBlockSize || mem.n > kMaxBlockSize ||
+      !absl::has_single_bit(mem.n)) {
+    internal::SizedDelete(mem.p, mem.n);
+    return;
+  }
+
+  const int index = ClassIndex(mem.n);
+  Shard& shard = CurrentShard();
+  // Claim room in the global budget before taking the lock, so that returns to
+  // different shards can't overshoot it together.
+  const size_t free_bytes =
+      free_bytes_.fetch_add(mem.n, std::memory_order_relaxed) + mem.n;
+  const bool fits =
+      free_bytes <= max_free_bytes_.load(std::memory_order_relaxed);
+  const size_t max_free_blocks =
+      max_free_blocks_per_class_.load(std::memory_order_relaxed);
+  {
+    absl::MutexLock lock(&shard.mutex);
+    if (fits && shard.num_free[index] < max_free_blocks) {
+      shard.free_blocks[index] =
+          new (mem.p) FreeBlock{shard.free_blocks[index]};
+      ++shard.num_free[index];
+      ++shard.blocks_kept;
+#ifdef ADDRESS_SANITIZER
+      ASAN_POISON_MEMORY_REGION(static_cast<char*>(mem.p) + sizeof(FreeBlock),
+                                mem.n - sizeof(FreeBlock));
+#endif  // ADDRESS_SANITIZER
+      return;
+    }
+    ++shard.blocks_released;
+  }
+  free_bytes_.fetch_sub(mem.n, std::memory_order_relaxed);
+  internal::SizedDelete(mem.p, mem.n);
+}
+
+void ArenaBlockPool::Trim() {
+  for (Shard& shard : shards_) {
+    FreeBlock* lists[kNumClasses];
+    {
+      absl::MutexLock lock(&shard.mutex);
+      for (int i = 0; i < kNumClasses; ++i) {
+        lists[i] = shard.free_blocks[i];
+        shard.free_blocks[i] = nullptr;
+        free_bytes_.fetch_sub(shard.num_free[i] * ClassSize(i),
+                              std::memory_order_relaxed);
+        shard.num_free[i] = 0;
+      }
+    }
+    // Free outside of the lock.
+    for (int i = 0; i < kNumClasses; ++i) {
+      FreeBlock* block = lists[i];
+      while (block != nullptr) {
+        FreeBlock* next = block->next;
+#ifdef ADDRESS_SANITIZER
+        ASAN_UNPOISON_MEMORY_REGION(block, ClassSize(i));
+#endif  // ADDRESS_SANITIZER
+        internal::SizedDelete(block, ClassSize(i));
+        block = next;
+      }
+    }
+  }
+}
+
+ArenaBlockPool::Stats ArenaBlockPool::GetStats() const {
+  Stats stats;
+  for (const Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.mutex);
+    stats.hits += shard.hits;
+    stats.misses += shard.misses;
+    stats.blocks_kept += shard.blocks_kept;
+    stats.blocks_released += shard.blocks_released;
+    for (int i = 0; i < kNumClasses; ++i) {
+      stats.free_bytes += shard.num_free[i] * ClassSize(i);
+    }
+  }
+  return stats;
+}
+
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
@@ -0,0 +1,148 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// This file defines ArenaBlockPool, a process-wide cache of arena blocks.
+
+#ifndef GOOGLE_PROTOBUF_ARENA_BLOCK_POOL_H__
+#define GOOGLE_PROTOBUF_ARENA_BLOCK_POOL_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/port.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+
+// ArenaBlockPool is a process-wide cache of the memory blocks backing arenas.
+// Arenas created with `ArenaOptions::use_block_pool` take their blocks from the
+// pool and give them back when they are reset or destroyed, so short-lived
+// arenas mostly avoid the system allocator.
+//
+// Blocks are kept in power-of-two size classes between kMinBlockSize and
+// kMaxBlockSize. Larger requests bypass the pool. The pool is sharded by CPU
+// (or by thread where the CPU is not available) to keep lock contention low.
+// Each shard keeps at most `Options::max_free_blocks_per_class` free blocks of
+// each size class, and all shards together keep at most
+// `Options::max_free_bytes`; blocks returned beyond either limit are freed.
+//
+// All methods are thread-safe.
+class PROTOBUF_EXPORT ArenaBlockPool {
+ public:
+  static constexpr size_t kMinBlockSize = 256;
+  static constexpr size_t kMaxBlockSize = size_t{1} << 20;
+
+  struct Options {
+    // Maximum number of free blocks kept per shard and size class. Zero makes
+    // the pool release every returned block.
+    size_t max_free_blocks_per_class = 16;
+    // Maximum total size of the free blocks kept over all shards.
+    size_t max_free_bytes = size_t{64} << 20;
+  };
+
+  struct Stats {
+    // Allocations served from a free block.
+    uint64_t hits = 0;
+    // Allocations that had to go to the system allocator.
+    uint64_t misses = 0;
+    // Returned blocks that were kept for reuse.
+    uint64_t blocks_kept = 0;
+    // Returned blocks that were freed because their shard or the pool was
+    // full.
+    uint64_t blocks_released = 0;
+    // Total size of the free blocks currently held.
+    uint64_t free_bytes = 0;
+
+    double HitRate() const {
+      uint64_t total = hits + misses;
+      return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+  };
+
+  // Returns the process-wide pool. It is never destroyed.
+  static ArenaBlockPool& Global();
+
+  ArenaBlockPool();
+  explicit ArenaBlockPool(const Options& options);
+  ArenaBlockPool(const ArenaBlockPool&) = delete;
+  ArenaBlockPool& operator=(const ArenaBlockPool&) = delete;
+  ~ArenaBlockPool();
+
+  // Changes the limits of the pool. If the pool holds more than the new
+  // `max_free_bytes`, all free blocks are released. Blocks cached above a
+  // lowered `max_free_blocks_per_class` are kept until they are handed out
+  // again or Trim() is called.
+  void SetOptions(const Options& options);
+
+  // Returns a block of at least `size` bytes. The returned size is the size of
+  // the size class, which the caller must pass back to Deallocate(). Requests
+  // above kMaxBlockSize go straight to the system allocator and are not
+  // counted in the stats.
+  internal::SizedPtr Allocate(size_t size);
+
+  // Gives `mem` back to the pool. `mem` must have been returned by Allocate()
+  // on this pool, or be a block the pool doesn't cache (which is freed).
+  void Deallocate(internal::SizedPtr mem);
+
+  // Frees all cached blocks.
+  void Trim();
+
+  // Returns a snapshot of the counters summed over all shards.
+  Stats GetStats() const;
+
+ private:
+  static constexpr int kMinSizeLog = 8;
+  static constexpr int kMaxSizeLog = 20;
+  static constexpr int kNumClasses = kMaxSizeLog - kMinSizeLog + 1;
+  static constexpr size_t kNumShards = 16;
+
+  static_assert(kMinBlockSize == size_t{1} << kMinSizeLog, "");
+  static_assert(kMaxBlockSize == size_t{1} << kMaxSizeLog, "");
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct alignas(ABSL_CACHELINE_SIZE) Shard {
+    mutable absl::Mutex mutex;
+    FreeBlock* free_blocks[kNumClasses] ABSL_GUARDED_BY(mutex) = {};
+    size_t num_free[kNumClasses] ABSL_GUARDED_BY(mutex) = {};
+    uint64_t hits ABSL_GUARDED_BY(mutex) = 0;
+    uint64_t misses ABSL_GUARDED_BY(mutex) = 0;
+    uint64_t blocks_kept ABSL_GUARDED_BY(mutex) = 0;
+    uint64_t blocks_released ABSL_GUARDED_BY(mutex) = 0;
+  };
+
+  // Returns the size class index for a block of `size` bytes, rounding up.
+  static int ClassIndex(size_t size);
+  static size_t ClassSize(int index) {
+    return size_t{1} << (index + kMinSizeLog);
+  }
+
+  Shard& CurrentShard();
+
+  std::atomic<size_t> max_free_blocks_per_class_;
+  std::atomic<size_t> max_free_bytes_;
+  // Total size of the free blocks in all shards, including blocks that are
+  // about to be added. Never above max_free_bytes_ once SetOptions() returns.
+  std::atomic<size_t> free_bytes_{0};
+  Shard shards_[kNumShards];
+};
+
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_ARENA_BLOCK_POOL_H__
@@ -0,0 +1,124 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/arena_block_pool.h"
+
+#include <cstddef>
+#include <cstring>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "google/protobuf/arena.h"
+#include "google/protobuf/port.h"
+
+namespace google {
+namespace protobuf {
+namespace {
+
+using internal::SizedPtr;
+
+TEST(ArenaBlockPoolTest, RoundsUpToSizeClass) {
+  ArenaBlockPool pool;
+  SizedPtr small = pool.Allocate(1);
+  EXPECT_EQ(small.n, ArenaBlockPool::kMinBlockSize);
+  SizedPtr mid = pool.Allocate(300);
+  EXPECT_EQ(mid.n, 512);
+  SizedPtr exact = pool.Allocate(4096);
+  EXPECT_EQ(exact.n, 4096);
+  SizedPtr large = pool.Allocate(ArenaBlockPool::kMaxBlockSize + 1);
+  EXPECT_GE(large.n, ArenaBlockPool::kMaxBlockSize + 1);
+
+  for (SizedPtr mem : {small, mid, exact, large}) {
+    memset(mem.p, 0xa5, mem.n);
+    pool.Deallocate(mem);
+  }
+}
+
+TEST(ArenaBlockPoolTest, CountsAllocationsAndReturns) {
+  ArenaBlockPool pool;
+  std::vector<SizedPtr> blocks;
+  for (int i = 0; i < 10; ++i) blocks.push_back(pool.Allocate(1024));
+  for (SizedPtr mem : blocks) pool.Deallocate(mem);
+
+  ArenaBlockPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.hits + stats.misses, 10);
+  EXPECT_EQ(stats.blocks_kept + stats.blocks_released, 10);
+  EXPECT_EQ(stats.free_bytes, stats.blocks_kept * 1024);
+
+  blocks.clear();
+  for (int i = 0; i < 10; ++i) blocks.push_back(pool.Allocate(1024));
+  for (SizedPtr mem : blocks) pool.Deallocate(mem);
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.hits + stats.misses, 20);
+  EXPECT_GT(stats.HitRate(), 0.0);
+
+  pool.Trim();
+  EXPECT_EQ(pool.GetStats().free_bytes, 0);
+}
+
+TEST(ArenaBlockPoolTest, RespectsLimit) {
+  ArenaBlockPool::Options options;
+  options.max_free_blocks_per_class = 0;
+  ArenaBlockPool pool(options);
+  pool.Deallocate(pool.Allocate(2048));
+  ArenaBlockPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.blocks_kept, 0);
+  EXPECT_EQ(stats.blocks_released, 1);
+  EXPECT_EQ(stats.free_bytes, 0);
+}
+
+TEST(ArenaBlockPoolTest, RespectsByteBudget) {
+  ArenaBlockPool::Options options;
+  options.max_free_bytes = 4 * ArenaBlockPool::kMaxBlockSize;
+  ArenaBlockPool pool(options);
+  // Each thread returns more than the budget, to shards that differ as the
+  // threads run on different CPUs.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&pool] {
+      std::vector<SizedPtr> blocks;
+      for (int i = 0; i < 16; ++i) {
+        blocks.push_back(pool.Allocate(ArenaBlockPool::kMaxBlockSize));
+      }
+      for (SizedPtr mem : blocks) pool.Deallocate(mem);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  ArenaBlockPool::Stats stats = pool.GetStats();
+  EXPECT_LE(stats.free_bytes, options.max_free_bytes);
+  EXPECT_GT(stats.blocks_released, 0);
+  EXPECT_EQ(stats.blocks_kept + stats.blocks_released, 8 * 16);
+
+  // Lowering the budget below what the pool holds releases the blocks.
+  options.max_free_bytes = ArenaBlockPool::kMaxBlockSize / 2;
+  pool.SetOptions(options);
+  EXPECT_EQ(pool.GetStats().free_bytes, 0);
+  pool.Deallocate(pool.Allocate(ArenaBlockPool::kMaxBlockSize));
+  EXPECT_EQ(pool.GetStats().free_bytes, 0);
+  pool.Deallocate(pool.Allocate(1024));
+  EXPECT_EQ(pool.GetStats().free_bytes, 1024);
+}
+
+TEST(ArenaBlockPoolTest, ArenaUsesGlobalPool) {
+  const ArenaBlockPool::Stats before = ArenaBlockPool::Global().GetStats();
+  {
+    ArenaOptions options;
+    options.use_block_pool = true;
+    Arena arena(options);
+    for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&arena, 256);
+  }
+  const ArenaBlockPool::Stats after = ArenaBlockPool::Global().GetStats();
+  EXPECT_GT(after.hits + after.misses, before.hits + before.misses);
+  EXPECT_EQ(after.hits + after.misses - before.hits - before.misses,
+            after.blocks_kept + after.blocks_released - before.blocks_kept -
+                before.blocks_released);
+}
+
+}  // namespace
+}  // namespace protobuf
+}  // namespace google
@@ -1419,6 +1419,99 @@ TEST(ArenaTest, Alignment) {
   }
 }
 
+namespace {
+
+int retained_block_allocs = 0;
+int retained_block_deallocs = 0;
+
+void* CountingBlockAlloc(size_t size) {
+  ++retained_block_allocs;
+  return ::operator new(size);
+}
+
+void CountingBlockDealloc(void* p, size_t size) {
+  ++retained_block_deallocs;
+  internal::SizedDelete(p, size);
+}
+
+}  // namespace
+
+TEST(ArenaTest, ResetRetainsBlocks) {
+  ArenaOptions options;
+  options.max_retained_bytes = 64 * 1024;
+  options.block_alloc = &CountingBlockAlloc;
+  options.block_dealloc = &CountingBlockDealloc;
+  Arena arena(options);
+
+  const auto fill = [&arena] {
+    for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&arena, 256);
+  };
+
+  fill();
+  EXPECT_EQ(0, arena.SpaceRetained());
+  const uint64_t space_allocated = arena.SpaceAllocated();
+  EXPECT_EQ(space_allocated, arena.Reset());
+  EXPECT_GT(arena.SpaceRetained(), 0);
+  EXPECT_LE(arena.SpaceRetained(), options.max_retained_bytes);
+
+  // The same workload runs entirely out of the retained blocks.
+  retained_block_allocs = 0;
+  fill();
+  EXPECT_EQ(0, retained_block_allocs);
+  EXPECT_EQ(space_allocated, arena.SpaceAllocated());
+  EXPECT_EQ(0, arena.SpaceRetained());
+  EXPECT_EQ(space_allocated, arena.Reset());
+}
+
+TEST(ArenaTest, ResetRetainsBlocksUpToLimit) {
+  ArenaOptions options;
+  options.max_retained_bytes = 1024;
+  Arena arena(options);
+
+  for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&arena, 256);
+  arena.Reset();
+  EXPECT_LE(arena.SpaceRetained(), 1024);
+
+  Arena no_retain;
+  for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&no_retain, 256);
+  no_retain.Reset();
+  EXPECT_EQ(0, no_retain.SpaceRetained());
+}
+
+// The first block holds the AllocationPolicy, so the destructor must not read
+// the policy after freeing it. Run under ASan to catch a use-after-free.
+TEST(ArenaTest, DestroyWithNonDefaultOptions) {
+  {
+    ArenaOptions options;
+    options.start_block_size = 1024;
+    Arena arena(options);
+    for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&arena, 256);
+  }
+  {
+    ArenaOptions options;
+    options.max_retained_bytes = 1 << 20;
+    Arena arena(options);
+    for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&arena, 256);
+    arena.Reset();
+    EXPECT_GT(arena.SpaceRetained(), 0);
+  }
+  retained_block_allocs = 0;
+  retained_block_deallocs = 0;
+  {
+    ArenaOptions options;
+    options.max_retained_bytes = 1 << 20;
+    options.block_alloc = &CountingBlockAlloc;
+    options.block_dealloc = &CountingBlockDealloc;
+    Arena arena(options);
+    for (int i = 0; i < 100; ++i) Arena::CreateArray<char>(&arena, 256);
+    arena.Reset();
+    for (int i = 0; i < 10; ++i) Arena::CreateArray<char>(&arena, 256);
+  }
+  // Every block, retained or not, went back through the user's deallocator.
+  EXPECT_GT(retained_block_allocs, 0);
+  EXPECT_EQ(retained_block_allocs, retained_block_deallocs);
+}
+
 TEST(ArenaTest, BlockSizeSmallerThanAllocation) {
   for (size_t i = 0; i <= 8; ++i) {
     ArenaOptions opt;
@@ -830,10 +830,13 @@ TEST(ExtensionSetTest, SpaceUsedExcludingSelf) {
     const size_t old_capacity =                                                \
         message->GetRepeatedExtension(unittest::repeated_##type##_extension)   \
             .Capacity();                                                       \
+    /* The first element may be stored inline, below the minimum array. */   \
     EXPECT_GE(                                                                 \
         old_capacity,                                                          \
-        (RepeatedFieldLowerClampLimit<cpptype, std::max(sizeof(cpptype),       \
-                                                        sizeof(void*))>()));   \
+        std::min(RepeatedField<cpptype>().Capacity(),                          \
+                 RepeatedFieldLowerClampLimit<cpptype,                         \
+                                              std::max(sizeof(cpptype),        \
+                                                       sizeof(void*))>()));    \
     for (int i = 0; i < 16; ++i) {                                             \
       message->AddExtension(unittest::repeated_##type##_extension, value);     \
     }                                                                          \
@@ -843,6 +843,9 @@ class PROTOBUF_EXPORT TcParser final {
   PROTOBUF_NOINLINE
   static void DestroyMapNode(NodeBase* node, MapAuxInfo map_info,
                              UntypedMapBase& map);
+  static int CountMapEntries(const char* ptr, uint32_t tag, ParseContext* ctx);
+  static void ReserveMap(UntypedMapBase& map, MapAuxInfo map_info,
+                         size_t size);
   static const char* ParseOneMapEntry(NodeBase* node, const char* ptr,
                                       ParseContext* ctx,
                                       const TcParseTableBase::FieldAux* aux,
@@ -23,6 +23,7 @@
 #include "google/protobuf/generated_message_tctable_impl.h"
 #include "google/protobuf/inlined_string_field.h"
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/lazy_field.h"
 #include "google/protobuf/map.h"
 #include "google/protobuf/message_lite.h"
 #include "google/protobuf/parse_context.h"
@@ -445,8 +446,20 @@ PROTOBUF_NOINLINE const char* TcParser::FastGtS2(PROTOBUF_TC_PARAM_DECL) {
 
 template <typename TagType>
 const char* TcParser::LazyMessage(PROTOBUF_TC_PARAM_DECL) {
-  ABSL_LOG(FATAL) << "Unimplemented";
-  return nullptr;
+  if (PROTOBUF_PREDICT_FALSE(data.coded_tag<TagType>() != 0)) {
+    PROTOBUF_MUSTTAIL return MiniParse(PROTOBUF_TC_PARAM_NO_DATA_PASS);
+  }
+  ptr += sizeof(TagType);
+  hasbits |= (uint64_t{1} << data.hasbit_idx());
+  SyncHasbits(msg, hasbits, table);
+  // The fast path is only used for eagerly verified fields. The aux entry that
+  // follows the default instance holds the generated verify function, which is
+  // not needed as LazyField checks the wire structure itself.
+  const MessageLite* default_instance =
+      table->field_aux(data.aux_idx())->message_default();
+  return RefAt<LazyField>(msg, data.offset())
+      ._InternalParse(*default_instance, msg->GetArena(),
+                      LazyField::Verification::kEager, ptr, ctx);
 }
 
 PROTOBUF_NOINLINE const char* TcParser::FastMlS1(PROTOBUF_TC_PARAM_DECL) {
@@ -985,19 +998,7 @@ PROTOBUF_ALWAYS_INLINE const char* TcParser::PackedVarint(
   // pending hasbits now:
   SyncHasbits(msg, hasbits, table);
   auto* field = &RefAt<RepeatedField<FieldType>>(msg, data.offset());
-  return ctx->ReadPackedVarint(ptr, [field](uint64_t varint) {
-    FieldType val;
-    if (zigzag) {
-      if (sizeof(FieldType) == 8) {
-        val = WireFormatLite::ZigZagDecode64(varint);
-      } else {
-        val = WireFormatLite::ZigZagDecode32(varint);
-      }
-    } else {
-      val = varint;
-    }
-    field->Add(val);
-  });
+  return ctx->ReadPackedVarint(ptr, PackedVarintSink<FieldType, zigzag>{field});
 }
 
 PROTOBUF_NOINLINE const char* TcParser::FastV8P1(PROTOBUF_TC_PARAM_DECL) {
@@ -2049,14 +2050,12 @@ const char* TcParser::MpPackedVarintT(PROTOBUF_TC_PARAM_DECL) {
         field->Add(value);
       }
     });
+  } else if (is_zigzag) {
+    return ctx->ReadPackedVarint(ptr,
+                                 PackedVarintSink<FieldType, true>{field});
   } else {
-    return ctx->ReadPackedVarint(ptr, [=](uint64_t value) {
-      field->Add(is_zigzag ? (sizeof(FieldType) == 8
-                                  ? WireFormatLite::ZigZagDecode64(value)
-                                  : WireFormatLite::ZigZagDecode32(
-                                        static_cast<uint32_t>(value)))
-                           : value);
-    });
+    return ctx->ReadPackedVarint(ptr,
+                                 PackedVarintSink<FieldType, false>{field});
   }
 }
 
@@ -2334,6 +2333,14 @@ PROTOBUF_NOINLINE const char* TcParser::MpMessage(PROTOBUF_TC_PARAM_DECL) {
   const uint16_t rep = type_card & field_layout::kRepMask;
   const bool is_group = rep == field_layout::kRepGroup;
 
+  if (rep == field_layout::kRepLazy) {
+    // Lazy fields are never split.
+    if (is_split) {
+      PROTOBUF_MUSTTAIL return table->fallback(PROTOBUF_TC_PARAM_PASS);
+    }
+    PROTOBUF_MUSTTAIL return MpLazyMessage(PROTOBUF_TC_PARAM_PASS);
+  }
+
   // Validate wiretype:
   switch (rep) {
     case field_layout::kRepMessage:
@@ -2391,6 +2398,35 @@ PROTOBUF_NOINLINE const char* TcParser::MpMessage(PROTOBUF_TC_PARAM_DECL) {
   }
 }
 
+PROTOBUF_NOINLINE const char* TcParser::MpLazyMessage(PROTOBUF_TC_PARAM_DECL) {
+  const auto& entry = RefAt<FieldEntry>(table, data.entry_offset());
+  const uint16_t type_card = entry.type_card;
+  const uint16_t card = type_card & field_layout::kFcMask;
+
+  // Oneof members and tables built without codegen (no default instance in
+  // aux) are handled by the reflection fallback.
+  if ((data.tag() & 7) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED ||
+      card == field_layout::kFcOneof ||
+      entry.aux_idx == TcParseTableBase::FieldEntry::kNoAuxIdx) {
+    PROTOBUF_MUSTTAIL return table->fallback(PROTOBUF_TC_PARAM_PASS);
+  }
+
+  if (card == field_layout::kFcOptional) {
+    SetHas(entry, msg);
+  }
+  SyncHasbits(msg, hasbits, table);
+
+  const LazyField::Verification verification =
+      (type_card & field_layout::kTvMask) == field_layout::kTvLazy
+          ? LazyField::Verification::kLazy
+          : LazyField::Verification::kEager;
+  const MessageLite* default_instance =
+      table->field_aux(&entry)->message_default();
+  return RefAt<LazyField>(msg, entry.offset)
+      ._InternalParse(*default_instance, msg->GetArena(), verification, ptr,
+                      ctx);
+}
+
 template <bool is_split, bool is_group>
 const char* TcParser::MpRepeatedMessageOrGroup(PROTOBUF_TC_PARAM_DECL) {
   const auto& entry = RefAt<FieldEntry>(table, data.entry_offset());
@@ -2597,6 +2633,44 @@ const char* ReadFixed(void* obj, const char* ptr) {
   return ptr;
 }
 
+// Counts the entries of a map field that are all in the buffer, starting with
+// the one whose tag was just read.
+int TcParser::CountMapEntries(const char* ptr, uint32_t tag,
+                              ParseContext* ctx) {
+  int count = 0;
+  while (true) {
+    const int size = ReadSize(&ptr);
+    if (ptr == nullptr || size > ctx->BytesAvailable(ptr)) break;
+    ptr += size;
+    ++count;
+    if (!ctx->DataAvailable(ptr)) break;
+    uint32_t next_tag;
+    ptr = ReadTagInlined(ptr, &next_tag);
+    if (ptr == nullptr || next_tag != tag) break;
+  }
+  return count;
+}
+
+void TcParser::ReserveMap(UntypedMapBase& map, MapAuxInfo map_info,
+                          size_t size) {
+  switch (map_info.key_type_card.cpp_type()) {
+    case MapTypeCard::kBool:
+      // There are at most two elements.
+      break;
+    case MapTypeCard::k32:
+      static_cast<KeyMapBase<uint32_t>&>(map).ReserveHint(size);
+      break;
+    case MapTypeCard::k64:
+      static_cast<KeyMapBase<uint64_t>&>(map).ReserveHint(size);
+      break;
+    case MapTypeCard::kString:
+      static_cast<KeyMapBase<std::string>&>(map).ReserveHint(size);
+      break;
+    default:
+      PROTOBUF_ASSUME(false);
+  }
+}
+
 const char* TcParser::ParseOneMapEntry(
     NodeBase* node, const char* ptr, ParseContext* ctx,
     const TcParseTableBase::FieldAux* aux, const TcParseTableBase* table,
@@ -2733,8 +2807,31 @@ PROTOBUF_NOINLINE const char* TcParser::MpMap(PROTOBUF_TC_PARAM_DECL) {
 
   const uint32_t saved_tag = data.tag();
 
+  // The entries that are all in the buffer are counted first, so that the
+  // table grows at most once for them and, on an arena, their nodes are
+  // allocated together.  Keys may repeat, so the count only serves as a hint
+  // for the table size.
+  NodeBase* slab = nullptr;
+  int slab_nodes = 0;
+  const int count = CountMapEntries(ptr, saved_tag, ctx);
+  if (count > 1) {
+    ReserveMap(map, map_info, map.size() + count);
+    if (map.arena() != nullptr) {
+      slab = map.AllocNodesOnArena(count, map_info.node_size_info);
+      slab_nodes = count;
+    }
+  }
+
   while (true) {
-    NodeBase* node = map.AllocNode(map_info.node_size_info);
+    NodeBase* node;
+    if (slab_nodes > 0) {
+      node = slab;
+      slab = reinterpret_cast<NodeBase*>(reinterpret_cast<char*>(slab) +
+                                         SizeFromInfo(map_info.node_size_info));
+      --slab_nodes;
+    } else {
+      node = map.AllocNode(map_info.node_size_info);
+    }
 
     InitializeMapNodeEntry(node->GetVoidKey(), map_info.key_type_card, map, aux,
                            true);
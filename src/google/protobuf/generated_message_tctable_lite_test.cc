@@ -6,11 +6,14 @@
 // https://developers.google.com/open-source/licenses/bsd
 
 #include <cstddef>
+#include <cstdint>
+#include <string>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/types/optional.h"
 #include "google/protobuf/generated_message_tctable_impl.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/unittest.pb.h"
 #include "google/protobuf/wire_format_lite.h"
 
@@ -899,6 +902,54 @@ TEST(GeneratedMessageTctableLiteTest,
   EXPECT_LE(proto.vals().Capacity(), 2048);
 }
 
+// Packed varints are decoded in bulk, with a fast path for runs of single
+// byte values. Mix runs with long varints so that every path is taken, and
+// feed the input in small blocks so that varints straddle buffer boundaries.
+TEST(GeneratedMessageTctableLiteTest, PackedVarintsMixedSizes) {
+  protobuf_unittest::TestPackedTypes proto;
+  uint64_t value = 0x9e3779b97f4a7c15;
+  for (int i = 0; i < 1000; i++) {
+    value = value * 6364136223846793005 + 1442695040888963407;
+    // Every fourth stretch of 16 values uses the full 64 bits.
+    const uint64_t v = (i / 16) % 4 == 0 ? value : (value >> 57);
+    proto.add_packed_int32(static_cast<int32_t>(v));
+    proto.add_packed_int64(static_cast<int64_t>(v));
+    proto.add_packed_uint32(static_cast<uint32_t>(v));
+    proto.add_packed_uint64(v);
+    proto.add_packed_sint32(static_cast<int32_t>(v) - 64);
+    proto.add_packed_sint64(static_cast<int64_t>(v) - 64);
+    proto.add_packed_bool(v & 1);
+  }
+  const std::string serialized = proto.SerializeAsString();
+
+  for (int block_size : {1, 7, 64, -1}) {
+    SCOPED_TRACE(block_size);
+    io::ArrayInputStream input(serialized.data(),
+                               static_cast<int>(serialized.size()),
+                               block_size);
+    protobuf_unittest::TestPackedTypes parsed;
+    ASSERT_TRUE(parsed.ParseFromZeroCopyStream(&input));
+    EXPECT_EQ(parsed.SerializeAsString(), serialized);
+  }
+
+  // Merging appends to the existing elements.
+  protobuf_unittest::TestPackedTypes merged = proto;
+  ASSERT_TRUE(merged.MergeFromString(serialized));
+  ASSERT_EQ(merged.packed_uint64_size(), 2000);
+  EXPECT_EQ(merged.packed_uint64(1000), proto.packed_uint64(0));
+  EXPECT_EQ(merged.packed_sint32(1999), proto.packed_sint32(999));
+}
+
+TEST(GeneratedMessageTctableLiteTest, PackedVarintsMalformed) {
+  // Field 92 (packed_uint32), length 12: one single byte varint followed by
+  // an 11 byte varint.
+  std::string serialized("\xe2\x05\x0c\x01", 4);
+  serialized.append(10, '\xff');
+  serialized.push_back('\x01');
+  protobuf_unittest::TestPackedTypes proto;
+  EXPECT_FALSE(proto.ParseFromString(serialized));
+}
+
 }  // namespace internal
 }  // namespace protobuf
 }  // namespace google
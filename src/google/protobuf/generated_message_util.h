@@ -21,6 +21,7 @@
 #include <atomic>
 #include <climits>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -210,9 +211,51 @@ struct MapSorterLessThan {
   }
 };
 
+// Below this many entries, comparison sorting beats MapSorterRadixSort().
+constexpr size_t kMapSorterMinRadixSortSize = 2048;
+
+// Sorts the pairs of integer keys and map entries by key in linear time, one
+// byte of the keys at a time, skipping the bytes that all keys share.
+// `scratch` has room for `n` pairs.  Returns the array with the result, which
+// is either `items` or `scratch`.
+template <typename KeyT>
+std::pair<KeyT, const void*>* MapSorterRadixSort(
+    std::pair<KeyT, const void*>* items, std::pair<KeyT, const void*>* scratch,
+    size_t n) {
+  using UnsignedKey = typename std::make_unsigned<KeyT>::type;
+  constexpr int kBytes = sizeof(KeyT);
+  // Flipping the sign bit orders signed keys like unsigned ones.
+  constexpr UnsignedKey kFlip =
+      std::is_signed<KeyT>::value ? UnsignedKey{1} << (kBytes * 8 - 1) : 0;
+  const auto byte = [](KeyT key, int i) {
+    return static_cast<uint8_t>((static_cast<UnsignedKey>(key) ^ kFlip) >>
+                                (i * 8));
+  };
+  // Maps have fewer than 2^32 elements.
+  uint32_t counts[kBytes][256] = {};
+  for (size_t j = 0; j < n; ++j) {
+    for (int i = 0; i < kBytes; ++i) ++counts[i][byte(items[j].first, i)];
+  }
+  for (int i = 0; i < kBytes; ++i) {
+    uint32_t* const offsets = counts[i];
+    if (offsets[byte(items[0].first, i)] == n) continue;
+    uint32_t offset = 0;
+    for (int b = 0; b < 256; ++b) {
+      const uint32_t count = offsets[b];
+      offsets[b] = offset;
+      offset += count;
+    }
+    for (size_t j = 0; j < n; ++j) {
+      scratch[offsets[byte(items[j].first, i)]++] = items[j];
+    }
+    std::swap(items, scratch);
+  }
+  return items;
+}
+
 // MapSorterFlat stores keys inline with pointers to map entries, so that
 // keys can be compared without indirection. This type is used for maps with
-// keys that are not strings.
+// keys that are not strings.  Large maps with integer keys are radix sorted.
 template <typename MapT>
 class MapSorterFlat {
  public:
@@ -245,14 +288,28 @@ class MapSorterFlat {
     for (const auto& entry : m) {
       *it++ = {entry.first, &entry};
     }
-    std::sort(&items_[0], &items_[size_],
-              MapSorterLessThan<typename MapT::key_type>{});
+    using KeyT = typename MapT::key_type;
+    Sort(std::integral_constant<bool, std::is_integral<KeyT>::value &&
+                                          !std::is_same<KeyT, bool>::value>{});
   }
   size_t size() const { return size_; }
   const_iterator begin() const { return {items_.get()}; }
   const_iterator end() const { return {items_.get() + size_}; }
 
  private:
+  void Sort(std::true_type /* integer keys */) {
+    if (size_ < kMapSorterMinRadixSortSize) return Sort(std::false_type{});
+    std::unique_ptr<storage_type[]> scratch(new storage_type[size_]);
+    if (MapSorterRadixSort(items_.get(), scratch.get(), size_) !=
+        items_.get()) {
+      items_ = std::move(scratch);
+    }
+  }
+  void Sort(std::false_type) {
+    std::sort(&items_[0], &items_[size_],
+              MapSorterLessThan<typename MapT::key_type>{});
+  }
+
   size_t size_;
   std::unique_ptr<storage_type[]> items_;
 };
@@ -0,0 +1,692 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/async_file_stream.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/log/absl_check.h"
+#include "absl/log/absl_log.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define GOOGLE_PROTOBUF_HAS_IO_URING 1
+#endif
+#endif
+#endif
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+namespace {
+
+// See FailIoUringSubmitsForTesting().
+std::atomic<int> submits_to_skip{0};
+std::atomic<int> submits_to_fail{0};
+std::atomic<int> submit_error{0};
+
+// Returns the error to fail the current io_uring submission with, or zero.
+int InjectedSubmitError() {
+  if (submits_to_fail.load(std::memory_order_relaxed) == 0) return 0;
+  if (submits_to_skip.load(std::memory_order_relaxed) > 0) {
+    submits_to_skip.fetch_sub(1, std::memory_order_relaxed);
+    return 0;
+  }
+  submits_to_fail.fetch_sub(1, std::memory_order_relaxed);
+  return submit_error.load(std::memory_order_relaxed);
+}
+
+// EINTR sucks.
+int close_no_eintr(int fd) {
+  int result;
+  do {
+    result = close(fd);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+// Reads or writes a file descriptor at explicit offsets, asynchronously.
+class IoBackend {
+ public:
+  virtual ~IoBackend() = default;
+
+  virtual bool IsIoUring() const = 0;
+
+  // Starts reading or writing `size` bytes at `data`.  `id` is handed back
+  // by Reap() once the operation has completed.  Returns zero, or an errno
+  // value if the operation could not be started.
+  virtual int Submit(bool write, int id, char* data, int size,
+                     int64_t offset) = 0;
+
+  // Waits for an operation to complete.  `result` is the number of bytes
+  // transferred, or minus the errno value.
+  virtual void Reap(int* id, int64_t* result) = 0;
+};
+
+#ifdef GOOGLE_PROTOBUF_HAS_IO_URING
+
+// Talks to the kernel directly, so that there is no dependency on liburing.
+// Only this thread submits and reaps, so ordering the ring indices against
+// the kernel is enough.
+class IoUringBackend final : public IoBackend {
+ public:
+  // Returns null if io_uring is unavailable, e.g. on old kernels or when it
+  // is disabled by a seccomp filter or by kernel.io_uring_disabled.
+  static std::unique_ptr<IoBackend> Create(int fd, int depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const int ring =
+        static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+    if (ring < 0) return nullptr;
+    auto backend = absl::WrapUnique(new IoUringBackend(fd, ring, depth));
+    if (!backend->Map(params)) return nullptr;
+    return backend;
+  }
+
+  ~IoUringBackend() override {
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+    close_no_eintr(ring_);
+  }
+
+  bool IsIoUring() const override { return true; }
+
+  int Submit(bool write, int id, char* data, int size,
+             int64_t offset) override {
+    // The kernel may only look at the iovec once the operation runs, so it
+    // lives as long as the operation.
+    iovecs_[id].iov_base = data;
+    iovecs_[id].iov_len = size;
+
+    const unsigned tail = *sq_tail_;
+    const unsigned index = tail & *sq_mask_;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    // The vectored operations are the oldest ones, available since 5.1.
+    sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = fd_;
+    sqe->addr = reinterpret_cast<uintptr_t>(&iovecs_[id]);
+    sqe->len = 1;
+    sqe->off = static_cast<uint64_t>(offset);
+    sqe->user_data = static_cast<uint64_t>(id);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    int result;
+    if (const int error = InjectedSubmitError()) {
+      result = -1;
+      errno = error;
+    } else {
+      do {
+        result = Enter(1, 0, 0);
+      } while (result < 0 && errno == EINTR);
+    }
+    if (result == 1) return 0;
+    const int error = result < 0 ? errno : EAGAIN;
+    // Without SQPOLL the kernel only takes entries inside io_uring_enter().
+    // If it didn't take this one, withdraw it: otherwise the next call would
+    // submit it, after the caller has given up on the operation and reused
+    // its buffer.
+    if (__atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == tail) {
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      return error;
+    }
+    // The kernel took it after all, so it will complete.
+    return 0;
+  }
+
+  void Reap(int* id, int64_t* result) override {
+    while (true) {
+      const unsigned head = *cq_head_;
+      if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+        *id = static_cast<int>(cqe.user_data);
+        *result = cqe.res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return;
+      }
+      if (Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+        // The buffers of the pending operations can't be released safely.
+        ABSL_LOG(FATAL) << "io_uring_enter() failed: " << strerror(errno);
+      }
+    }
+  }
+
+ private:
+  IoUringBackend(int fd, int ring, int depth)
+      : fd_(fd), ring_(ring), iovecs_(depth) {}
+
+  bool Map(const io_uring_params& params) {
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) return false;
+    cq_ring_ = single_mmap
+                   ? sq_ring_
+                   : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) return false;
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) return false;
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  int Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_, to_submit,
+                                    min_complete, flags, nullptr, 0));
+  }
+
+  const int fd_;
+  const int ring_;
+  std::vector<iovec> iovecs_;
+
+  void* sq_ring_ = MAP_FAILED;
+  void* cq_ring_ = MAP_FAILED;
+  void* sqes_ = MAP_FAILED;
+  size_t sq_ring_size_ = 0;
+  size_t cq_ring_size_ = 0;
+  size_t sqes_size_ = 0;
+
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif  // GOOGLE_PROTOBUF_HAS_IO_URING
+
+// Issues the operations one after the other on a helper thread, which still
+// overlaps them with the work of the caller.
+class ThreadBackend final : public IoBackend {
+ public:
+  explicit ThreadBackend(int fd) : fd_(fd), thread_([this] { Run(); }) {}
+
+  ~ThreadBackend() override {
+    {
+      absl::MutexLock lock(&mu_);
+      done_ = true;
+    }
+    thread_.join();
+  }
+
+  bool IsIoUring() const override { return false; }
+
+  int Submit(bool write, int id, char* data, int size,
+             int64_t offset) override {
+    absl::MutexLock lock(&mu_);
+    requests_.push_back({write, id, data, size, offset});
+    return 0;
+  }
+
+  void Reap(int* id, int64_t* result) override {
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(this, &ThreadBackend::HasCompletions));
+    *id = completions_.front().id;
+    *result = completions_.front().result;
+    completions_.pop_front();
+  }
+
+ private:
+  struct Request {
+    bool write;
+    int id;
+    char* data;
+    int size;
+    int64_t offset;
+  };
+
+  struct Completion {
+    int id;
+    int64_t result;
+  };
+
+  bool HasWork() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return done_ || !requests_.empty();
+  }
+  bool HasCompletions() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return !completions_.empty();
+  }
+
+  void Run() {
+    while (true) {
+      Request request;
+      {
+        absl::MutexLock lock(&mu_);
+        mu_.Await(absl::Condition(this, &ThreadBackend::HasWork));
+        if (requests_.empty()) return;
+        request = requests_.front();
+        requests_.pop_front();
+      }
+      int64_t result =
+          request.write
+              ? pwrite(fd_, request.data, request.size, request.offset)
+              : pread(fd_, request.data, request.size, request.offset);
+      if (result < 0) result = -errno;
+      absl::MutexLock lock(&mu_);
+      completions_.push_back({request.id, result});
+    }
+  }
+
+  const int fd_;
+  absl::Mutex mu_;
+  bool done_ ABSL_GUARDED_BY(mu_) = false;
+  std::deque<Request> requests_ ABSL_GUARDED_BY(mu_);
+  std::deque<Completion> completions_ ABSL_GUARDED_BY(mu_);
+  std::thread thread_;
+};
+
+}  // namespace
+
+// A fixed set of buffers, each with at most one read or write in flight.
+class AsyncFileQueue {
+ public:
+  AsyncFileQueue(int fd, const AsyncFileOptions& options)
+      : buffer_size_(options.buffer_size), slots_(options.queue_depth) {
+    ABSL_CHECK_GT(options.buffer_size, 0);
+    ABSL_CHECK_GT(options.queue_depth, 0);
+#ifdef GOOGLE_PROTOBUF_HAS_IO_URING
+    if (options.use_io_uring) {
+      backend_ = IoUringBackend::Create(fd, options.queue_depth);
+    }
+#endif
+    if (backend_ == nullptr) backend_ = std::make_unique<ThreadBackend>(fd);
+    for (Slot& slot : slots_) {
+      slot.buffer = std::make_unique<char[]>(buffer_size_);
+    }
+  }
+
+  // The buffers must outlive the operations.
+  ~AsyncFileQueue() { WaitAll(); }
+
+  bool uses_io_uring() const { return backend_->IsIoUring(); }
+  int depth() const { return static_cast<int>(slots_.size()); }
+  int buffer_size() const { return buffer_size_; }
+  char* buffer(int slot) { return slots_[slot].buffer.get(); }
+
+  // Starts reading or writing the first `size` bytes of the buffer of `slot`
+  // at `offset` in the file.  The slot must not have an operation in flight.
+  void Start(int slot, bool write, int64_t offset, int size) {
+    Slot& s = slots_[slot];
+    ABSL_DCHECK(!s.pending);
+    s.write = write;
+    s.offset = offset;
+    s.size = size;
+    s.done = 0;
+    s.pending = true;
+    Submit(slot);
+  }
+
+  // Waits for the operation of `slot` and returns the number of bytes read or
+  // written, or minus the errno value.  Writes are complete unless they
+  // fail, whereas reads are short at the end of the file.  Returns zero if
+  // nothing was started.
+  int64_t Wait(int slot) {
+    while (slots_[slot].pending) ReapOne();
+    return slots_[slot].result;
+  }
+
+  void WaitAll() {
+    for (int i = 0; i < depth(); ++i) Wait(i);
+  }
+
+ private:
+  struct Slot {
+    std::unique_ptr<char[]> buffer;
+    bool write = false;
+    bool pending = false;
+    int64_t offset = 0;
+    int size = 0;
+    // Bytes already written by previous, short, writes.
+    int done = 0;
+    int64_t result = 0;
+  };
+
+  // Submits the part of the operation of `slot` that is not done yet.
+  void Submit(int slot) {
+    Slot& s = slots_[slot];
+    while (true) {
+      const int error =
+          backend_->Submit(s.write, slot, s.buffer.get() + s.done,
+                           s.size - s.done, s.offset + s.done);
+      if (error == 0) return;
+      // The kernel is short of memory or of room for completions.  Retry
+      // once another operation has completed.
+      if ((error == EAGAIN || error == EBUSY) && ReapOther(slot)) continue;
+      s.pending = false;
+      s.result = -error;
+      return;
+    }
+  }
+
+  // Waits for the completion of an operation other than the one of `slot`.
+  // Returns false if no other operation is in flight.
+  bool ReapOther(int slot) {
+    for (int i = 0; i < depth(); ++i) {
+      if (i != slot && slots_[i].pending) {
+        ReapOne();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void ReapOne() {
+    int slot;
+    int64_t result;
+    backend_->Reap(&slot, &result);
+    Slot& s = slots_[slot];
+    if (result == -EINTR || result == -EAGAIN) {
+      Submit(slot);
+      return;
+    }
+    if (s.write && result >= 0 && s.done + result < s.size) {
+      if (result == 0) {
+        // No progress; avoid looping forever.
+        s.pending = false;
+        s.result = -EIO;
+        return;
+      }
+      s.done += static_cast<int>(result);
+      Submit(slot);
+      return;
+    }
+    s.pending = false;
+    s.result = result < 0 ? result : s.done + result;
+  }
+
+  const int buffer_size_;
+  std::vector<Slot> slots_;
+  std::unique_ptr<IoBackend> backend_;
+};
+
+// ===================================================================
+
+AsyncFileInputStream::AsyncFileInputStream(int file_descriptor,
+                                           const AsyncFileOptions& options)
+    : file_(file_descriptor),
+      queue_(std::make_unique<AsyncFileQueue>(file_descriptor, options)) {
+  start_offset_ = lseek(file_, 0, SEEK_CUR);
+  if (start_offset_ < 0) {
+    // Not seekable, so not readable by offset either.
+    errno_ = errno;
+    start_offset_ = 0;
+  }
+  next_offset_ = current_offset_ = start_offset_;
+}
+
+AsyncFileInputStream::~AsyncFileInputStream() {
+  if (is_closed_) return;
+  queue_.reset();
+  if (close_on_delete_) {
+    if (!Close()) {
+      ABSL_LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  } else if (started_) {
+    lseek(file_, start_offset_ + ByteCount(), SEEK_SET);
+  }
+}
+
+bool AsyncFileInputStream::Close() {
+  ABSL_CHECK(!is_closed_);
+
+  is_closed_ = true;
+  queue_.reset();
+  if (close_no_eintr(file_) != 0) {
+    // The docs on close() do not specify whether a file descriptor is still
+    // open after close() fails with EIO.  However, the glibc source code
+    // seems to indicate that it is not.
+    errno_ = errno;
+    return false;
+  }
+
+  return true;
+}
+
+bool AsyncFileInputStream::UsesIoUring() const {
+  return queue_ != nullptr && queue_->uses_io_uring();
+}
+
+void AsyncFileInputStream::StartRead(int slot) {
+  queue_->Start(slot, /*write=*/false, next_offset_, queue_->buffer_size());
+  next_offset_ += queue_->buffer_size();
+}
+
+bool AsyncFileInputStream::Refill() {
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0 || eof_) return false;
+
+  if (!started_) {
+    started_ = true;
+    for (int i = 0; i < queue_->depth(); ++i) StartRead(i);
+    current_size_ = queue_->buffer_size();
+  } else if (limit_ < current_size_) {
+    // A short read, normally at the end of the file.  Read the rest of the
+    // range again: either the file has grown, or this read returns zero.
+    current_offset_ += limit_;
+    current_size_ -= limit_;
+    queue_->Start(current_, /*write=*/false, current_offset_, current_size_);
+  } else {
+    // Read further ahead into the buffer that was just consumed.
+    StartRead(current_);
+    current_ = (current_ + 1) % queue_->depth();
+    current_offset_ += current_size_;
+    current_size_ = queue_->buffer_size();
+  }
+  position_ = limit_ = 0;
+
+  const int64_t result = queue_->Wait(current_);
+  if (result < 0) {
+    errno_ = static_cast<int>(-result);
+    return false;
+  }
+  if (result == 0) {
+    eof_ = true;
+    return false;
+  }
+  limit_ = static_cast<int>(result);
+  return true;
+}
+
+bool AsyncFileInputStream::Next(const void** data, int* size) {
+  if (position_ == limit_ && !Refill()) return false;
+  *data = queue_->buffer(current_) + position_;
+  *size = limit_ - position_;
+  position_ = limit_;
+  return true;
+}
+
+void AsyncFileInputStream::BackUp(int count) {
+  ABSL_CHECK_GE(count, 0);
+  ABSL_CHECK_LE(count, position_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  position_ -= count;
+}
+
+bool AsyncFileInputStream::Skip(int count) {
+  ABSL_CHECK_GE(count, 0);
+  const void* data;
+  int size;
+  while (count > 0) {
+    if (!Next(&data, &size)) return false;
+    if (size > count) {
+      BackUp(size - count);
+      return true;
+    }
+    count -= size;
+  }
+  return true;
+}
+
+int64_t AsyncFileInputStream::ByteCount() const {
+  return current_offset_ + position_ - start_offset_;
+}
+
+// ===================================================================
+
+AsyncFileOutputStream::AsyncFileOutputStream(int file_descriptor,
+                                             const AsyncFileOptions& options)
+    : file_(file_descriptor),
+      queue_(std::make_unique<AsyncFileQueue>(file_descriptor, options)) {
+  start_offset_ = lseek(file_, 0, SEEK_CUR);
+  if (start_offset_ < 0) {
+    // Not seekable, so not writable by offset either.
+    errno_ = errno;
+    start_offset_ = 0;
+  }
+  current_offset_ = start_offset_;
+}
+
+AsyncFileOutputStream::~AsyncFileOutputStream() {
+  if (is_closed_) return;
+  if (close_on_delete_) {
+    if (!Close()) {
+      ABSL_LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  } else if (Flush()) {
+    lseek(file_, current_offset_, SEEK_SET);
+  }
+}
+
+bool AsyncFileOutputStream::UsesIoUring() const {
+  return queue_ != nullptr && queue_->uses_io_uring();
+}
+
+bool AsyncFileOutputStream::WriteBuffer() {
+  if (position_ > 0) {
+    queue_->Start(current_, /*write=*/true, current_offset_, position_);
+    current_offset_ += position_;
+    position_ = 0;
+    current_ = (current_ + 1) % queue_->depth();
+  }
+  const int64_t result = queue_->Wait(current_);
+  if (result < 0) {
+    errno_ = static_cast<int>(-result);
+    return false;
+  }
+  return true;
+}
+
+bool AsyncFileOutputStream::Next(void** data, int* size) {
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0) return false;
+  if (position_ == queue_->buffer_size() && !WriteBuffer()) return false;
+  *data = queue_->buffer(current_) + position_;
+  *size = queue_->buffer_size() - position_;
+  position_ = queue_->buffer_size();
+  return true;
+}
+
+void AsyncFileOutputStream::BackUp(int count) {
+  ABSL_CHECK_GE(count, 0);
+  ABSL_CHECK_LE(count, position_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  position_ -= count;
+}
+
+int64_t AsyncFileOutputStream::ByteCount() const {
+  return current_offset_ + position_ - start_offset_;
+}
+
+bool AsyncFileOutputStream::Flush() {
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0 || !WriteBuffer()) return false;
+  for (int i = 0; i < queue_->depth(); ++i) {
+    const int64_t result = queue_->Wait(i);
+    if (result < 0) {
+      errno_ = static_cast<int>(-result);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AsyncFileOutputStream::Close() {
+  bool flush_succeeded = Flush();
+  is_closed_ = true;
+  queue_.reset();
+  if (close_no_eintr(file_) != 0) {
+    // The docs on close() do not specify whether a file descriptor is still
+    // open after close() fails with EIO.  However, the glibc source code
+    // seems to indicate that it is not.
+    errno_ = errno;
+    return false;
+  }
+  return flush_succeeded;
+}
+
+namespace internal {
+
+void FailIoUringSubmitsForTesting(int skip, int count, int error) {
+  submits_to_skip.store(skip, std::memory_order_relaxed);
+  submit_error.store(error, std::memory_order_relaxed);
+  submits_to_fail.store(count, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // !_WIN32
@@ -0,0 +1,220 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// File streams that keep several reads or writes in flight while the caller
+// works on the data of the previous ones.  On Linux, the I/O is issued
+// through io_uring when the kernel allows it; otherwise, and on other POSIX
+// systems, a helper thread issues it with pread() and pwrite().
+//
+// The streams address the file by offset, starting at the current position of
+// the file descriptor, so they only work with files that support pread() and
+// pwrite(), such as regular files and block devices.  Use FileInputStream and
+// FileOutputStream for pipes and sockets.
+
+#ifndef GOOGLE_PROTOBUF_IO_ASYNC_FILE_STREAM_H__
+#define GOOGLE_PROTOBUF_IO_ASYNC_FILE_STREAM_H__
+
+#ifndef _WIN32
+
+#include <cstdint>
+#include <memory>
+
+#include "google/protobuf/io/zero_copy_stream.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+class AsyncFileQueue;
+
+struct PROTOBUF_EXPORT AsyncFileOptions {
+  // Size of each buffer, which is also the most Next() returns at once.
+  int buffer_size = 256 << 10;
+
+  // Number of buffers, i.e. the most reads or writes that are in flight at
+  // the same time.
+  int queue_depth = 4;
+
+  // Whether to use io_uring when the kernel supports it.  If false, or if
+  // io_uring is unavailable, a helper thread issues the reads and writes.
+  bool use_io_uring = true;
+};
+
+// ===================================================================
+
+// A ZeroCopyInputStream which reads a file ahead of the caller.  The first
+// call to Next() starts reading the first queue_depth buffers; every buffer
+// that the caller is done with is immediately reused to read further ahead.
+// Next() then only waits if the data has not arrived yet.
+class PROTOBUF_EXPORT AsyncFileInputStream final : public ZeroCopyInputStream {
+ public:
+  // Creates a stream that reads from the given file descriptor, starting at
+  // its current position.  Once the stream is destroyed, the position of the
+  // file descriptor is right after the last byte consumed.
+  explicit AsyncFileInputStream(int file_descriptor,
+                                const AsyncFileOptions& options =
+                                    AsyncFileOptions());
+  AsyncFileInputStream(const AsyncFileInputStream&) = delete;
+  AsyncFileInputStream& operator=(const AsyncFileInputStream&) = delete;
+  ~AsyncFileInputStream() override;
+
+  // Waits for the pending reads and closes the underlying file.  Returns false
+  // if an error occurs during the process; use GetErrno() to examine the
+  // error.  Even if an error occurs, the file descriptor is closed when this
+  // returns.
+  bool Close();
+
+  // By default, the file descriptor is not closed when the stream is
+  // destroyed.  Call SetCloseOnDelete(true) to change that.
+  void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
+
+  // If an I/O error has occurred on this file descriptor, this is the
+  // errno from that error.  Otherwise, this is zero.  Once an error
+  // occurs, the stream is broken and all subsequent operations will
+  // fail.
+  int GetErrno() const { return errno_; }
+
+  // Whether the reads are issued through io_uring.
+  bool UsesIoUring() const;
+
+  // implements ZeroCopyInputStream ----------------------------------
+  bool Next(const void** data, int* size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64_t ByteCount() const override;
+
+ private:
+  // Moves on to the next data of the file.  Returns false at the end of the
+  // file or on error.
+  bool Refill();
+
+  // Starts reading the next buffer_size bytes that are not being read yet
+  // into the buffer of `slot`.
+  void StartRead(int slot);
+
+  const int file_;
+  std::unique_ptr<AsyncFileQueue> queue_;
+  bool close_on_delete_ = false;
+  bool is_closed_ = false;
+
+  // The errno of the I/O error, if one has occurred.  Otherwise, zero.
+  int errno_ = 0;
+
+  bool started_ = false;
+  bool eof_ = false;
+
+  // Position of the file descriptor when the stream was created.
+  int64_t start_offset_ = 0;
+  // File offset of the first byte that no read has been started for.
+  int64_t next_offset_ = 0;
+
+  // The buffer being consumed, the file offset of its first byte and the
+  // number of bytes that were requested for it.
+  int current_ = 0;
+  int64_t current_offset_ = 0;
+  int current_size_ = 0;
+  // Bytes of the current buffer returned by Next() and not backed up, and
+  // bytes that were actually read into it.
+  int position_ = 0;
+  int limit_ = 0;
+};
+
+// ===================================================================
+
+// A ZeroCopyOutputStream which writes a file in the background.  Every buffer
+// filled by the caller is written while Next() hands out the next buffer, so
+// up to queue_depth writes are in flight.  Next() only waits when it reuses a
+// buffer that is still being written.
+//
+// The file must not be opened with O_APPEND, since pwrite() ignores the
+// offset of such files on Linux.
+class PROTOBUF_EXPORT AsyncFileOutputStream final
+    : public ZeroCopyOutputStream {
+ public:
+  // Creates a stream that writes to the given file descriptor, starting at
+  // its current position.  Once the stream is destroyed, the position of the
+  // file descriptor is right after the last byte written.
+  explicit AsyncFileOutputStream(int file_descriptor,
+                                 const AsyncFileOptions& options =
+                                     AsyncFileOptions());
+  AsyncFileOutputStream(const AsyncFileOutputStream&) = delete;
+  AsyncFileOutputStream& operator=(const AsyncFileOutputStream&) = delete;
+  ~AsyncFileOutputStream() override;
+
+  // Writes all pending data and waits for the writes to complete.  Returns
+  // false if an error occurs; use GetErrno() to examine the error.
+  bool Flush();
+
+  // Flushes any buffers and closes the underlying file.  Returns false if
+  // an error occurs during the process; use GetErrno() to examine the error.
+  // Even if an error occurs, the file descriptor is closed when this returns.
+  bool Close();
+
+  // By default, the file descriptor is not closed when the stream is
+  // destroyed.  Call SetCloseOnDelete(true) to change that.  WARNING:
+  // This leaves no way for the caller to detect if close() fails.  If
+  // detecting close() errors is important to you, you should arrange
+  // to close the descriptor yourself.
+  void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
+
+  // If an I/O error has occurred on this file descriptor, this is the
+  // errno from that error.  Otherwise, this is zero.  Once an error
+  // occurs, the stream is broken and all subsequent operations will
+  // fail.
+  int GetErrno() const { return errno_; }
+
+  // Whether the writes are issued through io_uring.
+  bool UsesIoUring() const;
+
+  // implements ZeroCopyOutputStream ---------------------------------
+  bool Next(void** data, int* size) override;
+  void BackUp(int count) override;
+  int64_t ByteCount() const override;
+
+ private:
+  // Starts writing the current buffer and moves on to the next one, waiting
+  // for its previous write.  Returns false on error.
+  bool WriteBuffer();
+
+  const int file_;
+  std::unique_ptr<AsyncFileQueue> queue_;
+  bool close_on_delete_ = false;
+  bool is_closed_ = false;
+
+  // The errno of the I/O error, if one has occurred.  Otherwise, zero.
+  int errno_ = 0;
+
+  // Position of the file descriptor when the stream was created.
+  int64_t start_offset_ = 0;
+  // The buffer being filled, and the file offset it will be written at.
+  int current_ = 0;
+  int64_t current_offset_ = 0;
+  // Bytes of the current buffer returned by Next() and not backed up.
+  int position_ = 0;
+};
+
+namespace internal {
+
+// Makes io_uring submissions fail as if io_uring_enter() had failed with
+// `error`: the `count` submissions that follow the next `skip` ones.  For
+// tests only; not thread-safe with respect to streams in use.
+PROTOBUF_EXPORT void FailIoUringSubmitsForTesting(int skip, int count,
+                                                  int error);
+
+}  // namespace internal
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // !_WIN32
+
+#endif  // GOOGLE_PROTOBUF_IO_ASYNC_FILE_STREAM_H__
@@ -0,0 +1,248 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/async_file_stream.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+
+#include "google/protobuf/testing/googletest.h"
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace {
+
+std::string TestData() {
+  std::string data;
+  for (int i = 0; i < 100000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26 + i / 1000 % 3));
+  }
+  return data;
+}
+
+// Writes `data` in pieces of varying size, backing up now and then.
+void WriteData(const std::string& data, ZeroCopyOutputStream* output) {
+  const int64_t start = output->ByteCount();
+  size_t written = 0;
+  while (written < data.size()) {
+    void* buffer;
+    int size;
+    ASSERT_TRUE(output->Next(&buffer, &size));
+    size_t count = std::min<size_t>(size, data.size() - written);
+    if (count > 3 && written % 2 == 1) count -= 2;
+    memcpy(buffer, data.data() + written, count);
+    written += count;
+    output->BackUp(size - static_cast<int>(count));
+    EXPECT_EQ(output->ByteCount(), start + static_cast<int64_t>(written));
+  }
+}
+
+std::string ReadAll(ZeroCopyInputStream* input) {
+  std::string result;
+  const void* data;
+  int size;
+  while (input->Next(&data, &size)) {
+    result.append(static_cast<const char*>(data), size);
+  }
+  return result;
+}
+
+class AsyncFileStreamTest
+    : public testing::TestWithParam<std::tuple<bool, int, int>> {
+ protected:
+  void SetUp() override {
+    options_.use_io_uring = std::get<0>(GetParam());
+    options_.buffer_size = std::get<1>(GetParam());
+    options_.queue_depth = std::get<2>(GetParam());
+    const std::string filename =
+        absl::StrCat(TestTempDir(), "/async_file_stream_test");
+    file_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+    ASSERT_GE(file_, 0);
+  }
+  void TearDown() override { close(file_); }
+
+  AsyncFileOptions options_;
+  int file_ = -1;
+};
+
+TEST_P(AsyncFileStreamTest, RoundTrip) {
+  const std::string data = TestData();
+  // The streams start at the current position.
+  ASSERT_EQ(write(file_, "xx", 2), 2);
+  {
+    AsyncFileOutputStream output(file_, options_);
+    WriteData(data, &output);
+    // Flushing in the middle does not disturb the output.
+    EXPECT_TRUE(output.Flush());
+    WriteData(data, &output);
+    EXPECT_EQ(output.GetErrno(), 0);
+  }
+  EXPECT_EQ(lseek(file_, 0, SEEK_CUR),
+            static_cast<off_t>(2 + 2 * data.size()));
+
+  ASSERT_EQ(lseek(file_, 2, SEEK_SET), 2);
+  {
+    AsyncFileInputStream input(file_, options_);
+    EXPECT_EQ(ReadAll(&input), absl::StrCat(data, data));
+    EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(2 * data.size()));
+    EXPECT_EQ(input.GetErrno(), 0);
+  }
+}
+
+TEST_P(AsyncFileStreamTest, BackUpAndSkip) {
+  const std::string data = TestData();
+  ASSERT_EQ(write(file_, data.data(), data.size()),
+            static_cast<ssize_t>(data.size()));
+  ASSERT_EQ(lseek(file_, 0, SEEK_SET), 0);
+
+  std::string result;
+  {
+    AsyncFileInputStream input(file_, options_);
+    const void* buffer;
+    int size;
+    for (int i = 1; result.size() < data.size() / 2; i++) {
+      ASSERT_TRUE(input.Next(&buffer, &size));
+      result.append(static_cast<const char*>(buffer), size);
+      if (i % 3 == 0) {
+        input.BackUp(size / 2);
+        result.resize(result.size() - size / 2);
+      }
+      if (i % 7 == 0) {
+        ASSERT_TRUE(input.Skip(5));
+        result.append(data, result.size(), 5);
+      }
+      EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(result.size()));
+    }
+  }
+  // The file position is right after the consumed bytes.
+  EXPECT_EQ(lseek(file_, 0, SEEK_CUR), static_cast<off_t>(result.size()));
+  {
+    AsyncFileInputStream input(file_, options_);
+    result += ReadAll(&input);
+    EXPECT_FALSE(input.Skip(1));
+  }
+  EXPECT_EQ(result, data);
+}
+
+INSTANTIATE_TEST_SUITE_P(AsyncFileStreamTest, AsyncFileStreamTest,
+                         testing::Combine(testing::Bool(),
+                                          testing::Values(7, 4096, 1 << 20),
+                                          testing::Values(1, 3)));
+
+TEST(AsyncFileStreamErrorTest, NotSeekable) {
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  {
+    AsyncFileInputStream input(pipe_fds[0]);
+    const void* data;
+    int size;
+    EXPECT_FALSE(input.Next(&data, &size));
+    EXPECT_EQ(input.GetErrno(), ESPIPE);
+  }
+  {
+    AsyncFileOutputStream output(pipe_fds[1]);
+    void* data;
+    int size;
+    EXPECT_FALSE(output.Next(&data, &size));
+    EXPECT_EQ(output.GetErrno(), ESPIPE);
+  }
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+TEST(AsyncFileStreamErrorTest, CloseOnDelete) {
+  const std::string filename =
+      absl::StrCat(TestTempDir(), "/async_file_stream_close_test");
+  int file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+  ASSERT_GE(file, 0);
+  {
+    AsyncFileOutputStream output(file);
+    output.SetCloseOnDelete(true);
+    WriteData("hello", &output);
+  }
+  EXPECT_NE(close(file), 0);
+
+  file = open(filename.c_str(), O_RDONLY);
+  ASSERT_GE(file, 0);
+  AsyncFileInputStream input(file);
+  EXPECT_EQ(ReadAll(&input), "hello");
+  EXPECT_TRUE(input.Close());
+}
+
+class AsyncFileStreamSubmitErrorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    options_.buffer_size = 4096;
+    options_.queue_depth = 3;
+    filename_ = absl::StrCat(TestTempDir(), "/async_file_stream_submit_test");
+    file_ = open(filename_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+    ASSERT_GE(file_, 0);
+  }
+  void TearDown() override {
+    internal::FailIoUringSubmitsForTesting(0, 0, 0);
+    if (file_ >= 0) close(file_);
+  }
+
+  std::string ReadBack() {
+    int file = open(filename_.c_str(), O_RDONLY);
+    AsyncFileInputStream input(file);
+    input.SetCloseOnDelete(true);
+    return ReadAll(&input);
+  }
+
+  AsyncFileOptions options_;
+  std::string filename_;
+  int file_ = -1;
+};
+
+TEST_F(AsyncFileStreamSubmitErrorTest, RetriesTransientFailures) {
+  const std::string data = TestData();
+  AsyncFileOutputStream output(file_, options_);
+  if (!output.UsesIoUring()) GTEST_SKIP() << "io_uring is not available";
+  internal::FailIoUringSubmitsForTesting(2, 2, EBUSY);
+  WriteData(data, &output);
+  EXPECT_TRUE(output.Close());
+  file_ = -1;
+  // A submission that failed must not be picked up again by a later one:
+  // it would write a buffer that was refilled in the meantime.
+  EXPECT_EQ(ReadBack(), data);
+}
+
+TEST_F(AsyncFileStreamSubmitErrorTest, ReportsHardFailures) {
+  AsyncFileOutputStream output(file_, options_);
+  if (!output.UsesIoUring()) GTEST_SKIP() << "io_uring is not available";
+  internal::FailIoUringSubmitsForTesting(1, 1, EIO);
+  WriteData(std::string(4096, 'a'), &output);
+  WriteData(std::string(4096, 'b'), &output);
+  WriteData("c", &output);
+  EXPECT_FALSE(output.Close());
+  file_ = -1;
+  EXPECT_EQ(output.GetErrno(), EIO);
+  // The failed write of the 'b's never reaches the file, not even when the
+  // write of the 'c' is submitted after it.
+  const std::string written = ReadBack();
+  EXPECT_EQ(written.find('b'), std::string::npos);
+  EXPECT_EQ(written.substr(0, 4096), std::string(4096, 'a'));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // !_WIN32
@@ -88,6 +88,7 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <atomic>
 #include <climits>
 #include <cstddef>
@@ -870,13 +871,48 @@ class PROTOBUF_EXPORT EpsCopyOutputStream {
     ptr = WriteLengthDelim(num, size, ptr);
     auto it = r.data();
     auto end = it + r.size();
+    constexpr std::ptrdiff_t kMaxVarintSize =
+        sizeof(decltype(encode(*it))) == 4 ? 5 : 10;
     do {
       ptr = EnsureSpace(ptr);
-      ptr = UnsafeVarint(encode(*it++), ptr);
+      // Write as many elements as are guaranteed to fit before checking for
+      // space again.
+      auto batch_end =
+          it + (std::min)(end - it, GetSize(ptr) / kMaxVarintSize);
+      ptr = UnsafeVarints(it, batch_end, ptr, encode);
+      it = batch_end;
     } while (it < end);
     return ptr;
   }
 
+  // Writes the varints for [it, end) without bounds checks. Runs of single
+  // byte values are common in packed fields, so the values are encoded
+  // eight at a time and, if all of them are small, stored as plain bytes.
+  // Both loops are free of data dependent branches and get vectorized.
+  template <typename It, typename E>
+  PROTOBUF_ALWAYS_INLINE static uint8_t* UnsafeVarints(It it, It end,
+                                                       uint8_t* ptr,
+                                                       const E& encode) {
+    using Encoded = decltype(encode(*it));
+    while (end - it >= 8) {
+      Encoded values[8];
+      Encoded combined = 0;
+      for (int i = 0; i < 8; ++i) {
+        values[i] = encode(it[i]);
+        combined |= values[i];
+      }
+      if (PROTOBUF_PREDICT_TRUE(combined < 0x80)) {
+        for (int i = 0; i < 8; ++i) ptr[i] = static_cast<uint8_t>(values[i]);
+        ptr += 8;
+      } else {
+        for (int i = 0; i < 8; ++i) ptr = UnsafeVarint(values[i], ptr);
+      }
+      it += 8;
+    }
+    while (it < end) ptr = UnsafeVarint(encode(*it++), ptr);
+    return ptr;
+  }
+
   static uint32_t Encode32(uint32_t v) { return v; }
   static uint64_t Encode64(uint64_t v) { return v; }
   static uint32_t ZigZagEncode32(int32_t v) {
@@ -0,0 +1,309 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#if HAVE_ZLIB
+#include "google/protobuf/io/gzip_index.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/strings/string_view.h"
+#include "zlib.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+namespace {
+
+// The largest window of deflate, which access points have to keep.
+constexpr int kWindowSize = 32 * 1024;
+constexpr int kOutputBufferSize = 64 * 1024;
+// avail_in is 32-bit, so large inputs are passed to zlib in pieces.
+constexpr size_t kMaxInputChunk = size_t{1} << 30;
+
+// Hands the next piece of `compressed` to zlib once it consumed the previous
+// one.
+void RefillInput(absl::string_view compressed, size_t* position,
+                 z_stream* zcontext) {
+  if (zcontext->avail_in != 0 || *position == compressed.size()) return;
+  const size_t size = std::min(compressed.size() - *position, kMaxInputChunk);
+  zcontext->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data())) +
+      *position;
+  zcontext->avail_in = static_cast<uInt>(size);
+  *position += size;
+}
+
+// Finds where the length-delimited records start, as written by
+// util::SerializeDelimitedToZeroCopyStream(): each one is a varint32 size
+// followed by that many bytes.
+class RecordScanner {
+ public:
+  explicit RecordScanner(std::vector<int64_t>* offsets) : offsets_(offsets) {}
+
+  // Scans the next `size` bytes of data, which start at `offset`.  Returns
+  // false if a size is invalid.
+  bool Scan(const Bytef* data, size_t size, int64_t offset) {
+    size_t position = 0;
+    while (position < size) {
+      if (remaining_ > 0) {
+        const size_t skipped = static_cast<size_t>(
+            std::min<uint64_t>(remaining_, size - position));
+        position += skipped;
+        remaining_ -= skipped;
+        continue;
+      }
+      if (size_bytes_ == 0) {
+        offsets_->push_back(offset + static_cast<int64_t>(position));
+      }
+      const uint8_t byte = data[position++];
+      size_ |= static_cast<uint64_t>(byte & 0x7f) << (7 * size_bytes_++);
+      if (byte & 0x80) {
+        if (size_bytes_ == 5) return false;
+      } else {
+        if (size_ > static_cast<uint64_t>(INT_MAX)) return false;
+        remaining_ = size_;
+        size_ = 0;
+        size_bytes_ = 0;
+      }
+    }
+    return true;
+  }
+
+  // Whether the data scanned so far ends with a complete record.
+  bool AtRecordBoundary() const { return remaining_ == 0 && size_bytes_ == 0; }
+
+ private:
+  std::vector<int64_t>* offsets_;
+  // The size being parsed, and how many of its bytes were seen.
+  uint64_t size_ = 0;
+  int size_bytes_ = 0;
+  // Bytes left in the current record.
+  uint64_t remaining_ = 0;
+};
+
+// Decompresses the raw deflate data that starts at an access point.
+class AccessPointInputStream final : public ZeroCopyInputStream {
+ public:
+  AccessPointInputStream(absl::string_view compressed,
+                         int64_t compressed_offset, int bits,
+                         absl::string_view window)
+      : compressed_(compressed),
+        input_position_(static_cast<size_t>(compressed_offset)),
+        output_buffer_(new Bytef[kOutputBufferSize]) {
+    memset(&zcontext_, 0, sizeof(zcontext_));
+    zcontext_.zalloc = Z_NULL;
+    zcontext_.zfree = Z_NULL;
+    zcontext_.opaque = Z_NULL;
+    // Negative windowBits read raw deflate data, without header.
+    zerror_ = inflateInit2(&zcontext_, -15);
+    if (zerror_ == Z_OK && bits > 0) {
+      const int byte = static_cast<uint8_t>(compressed[compressed_offset - 1]);
+      zerror_ = inflatePrime(&zcontext_, bits, byte >> (8 - bits));
+    }
+    if (zerror_ == Z_OK && !window.empty()) {
+      zerror_ = inflateSetDictionary(
+          &zcontext_, reinterpret_cast<const Bytef*>(window.data()),
+          static_cast<uInt>(window.size()));
+    }
+  }
+  AccessPointInputStream(const AccessPointInputStream&) = delete;
+  AccessPointInputStream& operator=(const AccessPointInputStream&) = delete;
+  ~AccessPointInputStream() override { inflateEnd(&zcontext_); }
+
+  // implements ZeroCopyInputStream ----------------------------------
+  bool Next(const void** data, int* size) override {
+    if (position_ == available_ && !Inflate()) return false;
+    *data = output_buffer_.get() + position_;
+    *size = available_ - position_;
+    byte_count_ += *size;
+    position_ = available_;
+    return true;
+  }
+
+  void BackUp(int count) override {
+    ABSL_CHECK_GE(position_, count)
+        << " Can't back up over more bytes than were returned by the last call"
+           " to Next().";
+    position_ -= count;
+    byte_count_ -= count;
+  }
+
+  bool Skip(int count) override {
+    ABSL_CHECK_GE(count, 0);
+    const void* data;
+    int size;
+    while (count > 0) {
+      if (!Next(&data, &size)) return false;
+      if (size > count) {
+        BackUp(size - count);
+        return true;
+      }
+      count -= size;
+    }
+    return true;
+  }
+
+  int64_t ByteCount() const override { return byte_count_; }
+
+  // Makes ByteCount() count from the current position.
+  void ResetByteCount() { byte_count_ = 0; }
+
+ private:
+  // Decompresses into output_buffer_.  Returns false at the end of the data
+  // or on errors.
+  bool Inflate() {
+    position_ = available_ = 0;
+    while (zerror_ == Z_OK && available_ == 0) {
+      RefillInput(compressed_, &input_position_, &zcontext_);
+      zcontext_.next_out = output_buffer_.get();
+      zcontext_.avail_out = kOutputBufferSize;
+      zerror_ = inflate(&zcontext_, Z_NO_FLUSH);
+      available_ = kOutputBufferSize - static_cast<int>(zcontext_.avail_out);
+    }
+    return available_ > 0;
+  }
+
+  absl::string_view compressed_;
+  size_t input_position_;
+  z_stream zcontext_;
+  int zerror_;
+
+  std::unique_ptr<Bytef[]> output_buffer_;
+  int position_ = 0;
+  int available_ = 0;
+  int64_t byte_count_ = 0;
+};
+
+}  // namespace
+
+GzipIndex::Options::Options()
+    : span(1 << 20), index_delimited_records(false) {}
+
+bool GzipIndex::Build(absl::string_view compressed, const Options& options) {
+  ABSL_CHECK_GT(options.span, 0);
+  points_.clear();
+  record_offsets_.clear();
+  uncompressed_size_ = 0;
+
+  z_stream zcontext;
+  memset(&zcontext, 0, sizeof(zcontext));
+  zcontext.zalloc = Z_NULL;
+  zcontext.zfree = Z_NULL;
+  zcontext.opaque = Z_NULL;
+  // Detects gzip and zlib headers.
+  if (inflateInit2(&zcontext, 15 + 32) != Z_OK) return false;
+
+  // The output goes round a window-sized buffer, so that the last 32kB are
+  // at hand at each access point.
+  std::unique_ptr<Bytef[]> window(new Bytef[kWindowSize]);
+  RecordScanner scanner(&record_offsets_);
+  size_t input_position = 0;
+  int64_t total_in = 0;
+  int64_t total_out = 0;
+  int64_t last_point = 0;
+  int error;
+  do {
+    RefillInput(compressed, &input_position, &zcontext);
+    if (zcontext.avail_out == 0) {
+      zcontext.next_out = window.get();
+      zcontext.avail_out = kWindowSize;
+    }
+    Bytef* output = zcontext.next_out;
+    total_in += zcontext.avail_in;
+    total_out += zcontext.avail_out;
+    // Z_BLOCK stops after the header and at the end of each deflate block.
+    error = inflate(&zcontext, Z_BLOCK);
+    total_in -= zcontext.avail_in;
+    total_out -= zcontext.avail_out;
+    if (error != Z_OK && error != Z_STREAM_END) break;
+    if (options.index_delimited_records &&
+        !scanner.Scan(output, zcontext.next_out - output,
+                      total_out - (zcontext.next_out - output))) {
+      error = Z_DATA_ERROR;
+      break;
+    }
+
+    // Bit 7 of data_type is set at the end of a block, and bit 6 if it was
+    // the last one.
+    if ((zcontext.data_type & 128) && !(zcontext.data_type & 64) &&
+        (total_out == 0 || total_out - last_point >= options.span)) {
+      AccessPoint point;
+      point.uncompressed_offset = total_out;
+      point.compressed_offset = total_in;
+      point.bits = zcontext.data_type & 7;
+      const int end = kWindowSize - static_cast<int>(zcontext.avail_out);
+      if (total_out >= kWindowSize) {
+        point.window.reserve(kWindowSize);
+        point.window.append(reinterpret_cast<char*>(window.get()) + end,
+                            kWindowSize - end);
+      }
+      point.window.append(reinterpret_cast<char*>(window.get()), end);
+      points_.push_back(std::move(point));
+      last_point = total_out;
+    }
+  } while (error != Z_STREAM_END);
+  inflateEnd(&zcontext);
+
+  if (error != Z_STREAM_END ||
+      (options.index_delimited_records && !scanner.AtRecordBoundary())) {
+    points_.clear();
+    record_offsets_.clear();
+    return false;
+  }
+  uncompressed_size_ = total_out;
+  return true;
+}
+
+std::unique_ptr<ZeroCopyInputStream> GzipIndex::NewStream(
+    absl::string_view compressed, int64_t offset) const {
+  ABSL_CHECK(!points_.empty());
+  ABSL_CHECK_GE(offset, 0);
+  ABSL_CHECK_LE(offset, uncompressed_size_);
+  // The last access point at or before offset.  The first one is at zero.
+  auto point = std::upper_bound(points_.begin(), points_.end(), offset,
+                                [](int64_t offset, const AccessPoint& point) {
+                                  return offset < point.uncompressed_offset;
+                                }) -
+               1;
+  auto stream = std::make_unique<AccessPointInputStream>(
+      compressed, point->compressed_offset, point->bits, point->window);
+  int64_t skip = offset - point->uncompressed_offset;
+  while (skip > 0) {
+    const int count = static_cast<int>(std::min<int64_t>(skip, INT_MAX));
+    if (!stream->Skip(count)) break;
+    skip -= count;
+  }
+  stream->ResetByteCount();
+  return stream;
+}
+
+std::unique_ptr<ZeroCopyInputStream> GzipIndex::NewStreamAtRecord(
+    absl::string_view compressed, int index) const {
+  ABSL_CHECK_GE(index, 0);
+  ABSL_CHECK_LT(index, record_count());
+  return NewStream(compressed, record_offsets_[index]);
+}
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // HAVE_ZLIB
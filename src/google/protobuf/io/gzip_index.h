@@ -0,0 +1,128 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// This file contains GzipIndex, which makes a gzip or zlib stream readable
+// from the middle, for example to jump to a message in a compressed file of
+// length-delimited messages written by
+// util::SerializeDelimitedToZeroCopyStream() through a GzipOutputStream.
+
+#ifndef GOOGLE_PROTOBUF_IO_GZIP_INDEX_H__
+#define GOOGLE_PROTOBUF_IO_GZIP_INDEX_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+// An index of access points into a gzip or zlib stream, like the one of
+// zran.c in the zlib examples.
+//
+// Deflate data can only be decompressed from the start, since each block
+// refers to the 32kB of data before it.  Build() decompresses the stream once
+// and remembers, every `span` bytes of uncompressed data, where a deflate
+// block starts and the 32kB of data before it.  NewStream() then restarts
+// decompression at the access point before the requested offset, so it
+// decompresses less than `span` bytes before it gets there.
+//
+// If the data is a sequence of length-delimited messages, the index can also
+// record the offset of each message.  Readers can then jump to any message,
+// or split the messages of a single file among several threads:
+//
+//   GzipIndex index;
+//   GzipIndex::Options options;
+//   options.index_delimited_records = true;
+//   if (!index.Build(compressed, options)) { ... }
+//   // On each thread, for its share [begin, end) of the records:
+//   auto input = index.NewStreamAtRecord(compressed, begin);
+//   for (int i = begin; i < end; i++) {
+//     util::ParseDelimitedFromZeroCopyStream(&message, input.get(), nullptr);
+//   }
+//
+// The compressed data is accessed through a string_view, which can be a file
+// mapped by MmapInputStream (see MmapInputStream::GetContents()).  Only the
+// first gzip member of concatenated streams is indexed.
+class PROTOBUF_EXPORT GzipIndex {
+ public:
+  struct PROTOBUF_EXPORT Options {
+    // Uncompressed bytes between access points.  Each one holds a copy of the
+    // 32kB before it, and NewStream() decompresses up to this many bytes
+    // before returning any.  Defaults to 1MB.
+    int64_t span;
+
+    // Whether to record where each length-delimited message starts.  Build()
+    // then fails if the data is not a sequence of such messages.  Defaults to
+    // false.
+    bool index_delimited_records;
+
+    Options();  // Initializes with default values.
+  };
+
+  GzipIndex() = default;
+  GzipIndex(GzipIndex&&) = default;
+  GzipIndex& operator=(GzipIndex&&) = default;
+
+  // Builds the index of `compressed`, a gzip or zlib stream, replacing the
+  // previous one.  Returns false if the stream is invalid or truncated, in
+  // which case the index is empty.
+  bool Build(absl::string_view compressed, const Options& options);
+
+  // Size of the uncompressed data.
+  int64_t uncompressed_size() const { return uncompressed_size_; }
+
+  // Number of access points, about uncompressed_size() / span.
+  int access_point_count() const { return static_cast<int>(points_.size()); }
+
+  // Number of length-delimited records, and the uncompressed offset of the
+  // size that precedes each of them.  Only set if index_delimited_records was.
+  int record_count() const { return static_cast<int>(record_offsets_.size()); }
+  int64_t record_offset(int index) const { return record_offsets_[index]; }
+
+  // Returns a stream of the uncompressed data from `offset` on, which must
+  // not be past uncompressed_size().  `compressed` must be the data the index
+  // was built from, and must outlive the stream.  ByteCount() of the stream
+  // starts at zero.  The index must have been built successfully.
+  std::unique_ptr<ZeroCopyInputStream> NewStream(absl::string_view compressed,
+                                                 int64_t offset) const;
+
+  // Returns a stream that starts with the record at `index`.
+  std::unique_ptr<ZeroCopyInputStream> NewStreamAtRecord(
+      absl::string_view compressed, int index) const;
+
+ private:
+  struct AccessPoint {
+    // Where decompression can restart.
+    int64_t uncompressed_offset;
+    int64_t compressed_offset;
+    // Number of bits of the byte before compressed_offset that belong to the
+    // block starting here.
+    int bits;
+    // The data before uncompressed_offset, up to 32kB.
+    std::string window;
+  };
+
+  std::vector<AccessPoint> points_;
+  std::vector<int64_t> record_offsets_;
+  int64_t uncompressed_size_ = 0;
+};
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_IO_GZIP_INDEX_H__
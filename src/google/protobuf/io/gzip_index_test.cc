@@ -0,0 +1,178 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/gzip_index.h"
+
+#if HAVE_ZLIB
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "google/protobuf/io/gzip_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/unittest.pb.h"
+#include "google/protobuf/util/delimited_message_util.h"
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace {
+
+constexpr int kRecordCount = 20000;
+
+class GzipIndexTest : public testing::TestWithParam<GzipOutputStream::Format> {
+ protected:
+  void SetUp() override {
+    {
+      StringOutputStream output(&data_);
+      protobuf_unittest::TestAllTypes message;
+      for (int i = 0; i < kRecordCount; i++) {
+        message.set_optional_int32(i);
+        message.set_optional_string(std::string(i % 100, 'a' + i % 26));
+        ASSERT_TRUE(util::SerializeDelimitedToZeroCopyStream(message, &output));
+      }
+    }
+    compressed_ = Compress(data_);
+  }
+
+  std::string Compress(const std::string& data) {
+    std::string result;
+    StringOutputStream output(&result);
+    GzipOutputStream::Options options;
+    options.format = GetParam();
+    GzipOutputStream gzip_output(&output, options);
+    size_t written = 0;
+    while (written < data.size()) {
+      void* buffer;
+      int size;
+      EXPECT_TRUE(gzip_output.Next(&buffer, &size));
+      const size_t n =
+          std::min(static_cast<size_t>(size), data.size() - written);
+      memcpy(buffer, data.data() + written, n);
+      gzip_output.BackUp(size - static_cast<int>(n));
+      written += n;
+    }
+    EXPECT_TRUE(gzip_output.Close());
+    return result;
+  }
+
+  static std::string ReadAll(ZeroCopyInputStream* input) {
+    std::string result;
+    const void* data;
+    int size;
+    while (input->Next(&data, &size)) {
+      result.append(static_cast<const char*>(data), size);
+    }
+    return result;
+  }
+
+  std::string data_;
+  std::string compressed_;
+};
+
+TEST_P(GzipIndexTest, NewStream) {
+  GzipIndex::Options options;
+  options.span = 10000;
+  GzipIndex index;
+  ASSERT_TRUE(index.Build(compressed_, options));
+  EXPECT_EQ(index.uncompressed_size(), static_cast<int64_t>(data_.size()));
+  EXPECT_GT(index.access_point_count(), 1);
+  EXPECT_EQ(index.record_count(), 0);
+
+  for (size_t offset : {size_t{0}, size_t{1}, size_t{9999}, data_.size() / 3,
+                        data_.size() - 1, data_.size()}) {
+    SCOPED_TRACE(offset);
+    std::unique_ptr<ZeroCopyInputStream> input =
+        index.NewStream(compressed_, offset);
+    EXPECT_EQ(ReadAll(input.get()), data_.substr(offset));
+    EXPECT_EQ(input->ByteCount(), static_cast<int64_t>(data_.size() - offset));
+  }
+}
+
+TEST_P(GzipIndexTest, Records) {
+  GzipIndex::Options options;
+  options.span = 50000;
+  options.index_delimited_records = true;
+  GzipIndex index;
+  ASSERT_TRUE(index.Build(compressed_, options));
+  ASSERT_EQ(index.record_count(), kRecordCount);
+
+  protobuf_unittest::TestAllTypes message;
+  for (int i : {0, 1, 777, kRecordCount - 1}) {
+    std::unique_ptr<ZeroCopyInputStream> input =
+        index.NewStreamAtRecord(compressed_, i);
+    ASSERT_TRUE(
+        util::ParseDelimitedFromZeroCopyStream(&message, input.get(), nullptr));
+    EXPECT_EQ(message.optional_int32(), i);
+    if (i == kRecordCount - 1) {
+      bool clean_eof;
+      EXPECT_FALSE(util::ParseDelimitedFromZeroCopyStream(&message, input.get(),
+                                                          &clean_eof));
+      EXPECT_TRUE(clean_eof);
+    }
+  }
+}
+
+TEST_P(GzipIndexTest, ParallelReaders) {
+  GzipIndex::Options options;
+  options.index_delimited_records = true;
+  GzipIndex index;
+  ASSERT_TRUE(index.Build(compressed_, options));
+
+  const int kThreads = 4;
+  std::vector<int> mismatches(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      const int begin = kRecordCount * t / kThreads;
+      const int end = kRecordCount * (t + 1) / kThreads;
+      std::unique_ptr<ZeroCopyInputStream> input =
+          index.NewStreamAtRecord(compressed_, begin);
+      protobuf_unittest::TestAllTypes message;
+      for (int i = begin; i < end; i++) {
+        if (!util::ParseDelimitedFromZeroCopyStream(&message, input.get(),
+                                                    nullptr) ||
+            message.optional_int32() != i) {
+          mismatches[t]++;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(mismatches, std::vector<int>(kThreads));
+}
+
+TEST_P(GzipIndexTest, InvalidData) {
+  GzipIndex::Options options;
+  GzipIndex index;
+  EXPECT_FALSE(
+      index.Build(compressed_.substr(0, compressed_.size() / 2), options));
+  EXPECT_EQ(index.access_point_count(), 0);
+  EXPECT_FALSE(index.Build("not compressed at all", options));
+
+  // Valid compressed data, but the last record is cut short.
+  const std::string compressed = Compress(data_.substr(0, data_.size() - 1));
+  EXPECT_TRUE(index.Build(compressed, options));
+  options.index_delimited_records = true;
+  EXPECT_FALSE(index.Build(compressed, options));
+}
+
+INSTANTIATE_TEST_SUITE_P(GzipIndexTest, GzipIndexTest,
+                         testing::Values(GzipOutputStream::GZIP,
+                                         GzipOutputStream::ZLIB));
+
+}  // namespace
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // HAVE_ZLIB
@@ -14,9 +14,20 @@
 #if HAVE_ZLIB
 #include "google/protobuf/io/gzip_stream.h"
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
 #include "google/protobuf/stubs/common.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/synchronization/mutex.h"
 #include "google/protobuf/port.h"
 
 namespace google {
@@ -24,6 +35,7 @@ namespace protobuf {
 namespace io {
 
 static const int kDefaultBufferSize = 65536;
+static const int kDefaultBlockSize = 128 * 1024;
 
 GzipInputStream::GzipInputStream(ZeroCopyInputStream* sub_stream, Format format,
                                  int buffer_size)
@@ -175,11 +187,360 @@ int64_t GzipInputStream::ByteCount() const {
 
 // =========================================================================
 
+// Compresses blocks of the input on worker threads.  Each block is a raw
+// deflate stream primed with the last 32kB of input before it, which ends
+// with a sync flush, or with the final block if it is the last one.  Since
+// these are byte aligned, the caller's thread can simply write them out one
+// after another, between a header and a trailer whose check value combines
+// those of the blocks.
+class GzipOutputStream::ParallelDeflater {
+ public:
+  ParallelDeflater(ZeroCopyOutputStream* sub_stream, const Options& options);
+  ParallelDeflater(const ParallelDeflater&) = delete;
+  ParallelDeflater& operator=(const ParallelDeflater&) = delete;
+  ~ParallelDeflater();
+
+  // Like the methods of GzipOutputStream, but returning zlib error codes.
+  int Next(void** data, int* size);
+  void BackUp(int count);
+  int64_t ByteCount() const { return byte_count_ + used_; }
+  int Flush();
+  int Close();
+
+ private:
+  struct Block {
+    std::string input;
+    std::string dictionary;
+    bool last = false;
+
+    // Set by the worker thread.
+    std::string output;
+    uLong check = 0;
+    int error = Z_OK;
+    bool done = false;
+  };
+
+  // The maximum window size of deflate, which is the most a dictionary can
+  // hold.
+  static constexpr size_t kWindowSize = 32 * 1024;
+  // Blocks that may be in flight per thread, to keep them all busy.
+  static constexpr size_t kBlocksPerThread = 2;
+
+  // The loop of the worker threads.
+  void Run();
+  void Compress(z_stream* stream, Block* block) const;
+
+  // Hands the current block to the workers, and writes out the oldest blocks
+  // while too many are in flight.
+  int Submit(bool last);
+  // Waits for the oldest block and writes it out.
+  int WriteFirst();
+  // Copies data to the underlying stream.
+  int Write(const void* data, size_t size);
+  int WriteHeader();
+  int WriteTrailer();
+  // Returns what is left of the underlying stream's buffer.
+  void BackUpSubStream();
+
+  bool HasWork() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return stop_ || !queue_.empty();
+  }
+
+  ZeroCopyOutputStream* const sub_stream_;
+  const Options options_;
+
+  absl::Mutex mu_;
+  // Blocks that no worker has started on yet.
+  std::deque<Block*> queue_ ABSL_GUARDED_BY(mu_);
+  bool stop_ ABSL_GUARDED_BY(mu_) = false;
+  std::vector<std::thread> threads_;
+
+  // Only used by the caller's thread.
+  // The blocks in flight, oldest first.
+  std::deque<std::unique_ptr<Block>> blocks_;
+  // Written blocks, kept to reuse their buffers.
+  std::vector<std::unique_ptr<Block>> free_blocks_;
+  // The block Next() returns, of which used_ bytes were written.
+  std::unique_ptr<Block> current_;
+  int used_ = 0;
+  // The last kWindowSize bytes of the input submitted so far.
+  std::string window_;
+  int64_t byte_count_ = 0;
+
+  bool header_written_ = false;
+  // Combined check value and size of the blocks written.
+  uLong check_;
+  uLong written_size_ = 0;
+  // Result from calling Next() on sub_stream_
+  char* sub_data_ = nullptr;
+  int sub_data_size_ = 0;
+};
+
+GzipOutputStream::ParallelDeflater::ParallelDeflater(
+    ZeroCopyOutputStream* sub_stream, const Options& options)
+    : sub_stream_(sub_stream), options_(options) {
+  ABSL_CHECK_GT(options.block_size, 0);
+  check_ = options.format == ZLIB ? adler32(0L, Z_NULL, 0)
+                                  : crc32(0L, Z_NULL, 0);
+  threads_.reserve(options.num_threads);
+  for (int i = 0; i < options.num_threads; i++) {
+    threads_.emplace_back([this] { Run(); });
+  }
+}
+
+GzipOutputStream::ParallelDeflater::~ParallelDeflater() {
+  {
+    absl::MutexLock lock(&mu_);
+    stop_ = true;
+  }
+  for (std::thread& thread : threads_) thread.join();
+}
+
+void GzipOutputStream::ParallelDeflater::Run() {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+  // Negative windowBits make a raw deflate stream, without header and
+  // trailer.
+  const int init_error =
+      deflateInit2(&stream, options_.compression_level, Z_DEFLATED,
+                   /* windowBits */ -15,
+                   /* memLevel (default) */ 8, options_.compression_strategy);
+  while (true) {
+    Block* block;
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &ParallelDeflater::HasWork));
+      if (stop_) break;
+      block = queue_.front();
+      queue_.pop_front();
+    }
+    if (init_error == Z_OK) {
+      Compress(&stream, block);
+    } else {
+      block->error = init_error;
+    }
+    absl::MutexLock lock(&mu_);
+    block->done = true;
+  }
+  if (init_error == Z_OK) deflateEnd(&stream);
+}
+
+void GzipOutputStream::ParallelDeflater::Compress(z_stream* stream,
+                                                  Block* block) const {
+  block->error = deflateReset(stream);
+  if (block->error == Z_OK && !block->dictionary.empty()) {
+    block->error = deflateSetDictionary(
+        stream, reinterpret_cast<const Bytef*>(block->dictionary.data()),
+        block->dictionary.size());
+  }
+  if (block->error != Z_OK) return;
+
+  Bytef* input = reinterpret_cast<Bytef*>(&block->input[0]);
+  stream->next_in = input;
+  stream->avail_in = block->input.size();
+  // A sync flush leaves avail_out != 0 once it is done, and Z_FINISH returns
+  // Z_STREAM_END.
+  const int flush = block->last ? Z_FINISH : Z_SYNC_FLUSH;
+  size_t produced = 0;
+  block->output.resize(deflateBound(stream, block->input.size()) + 16);
+  int error;
+  do {
+    if (produced == block->output.size()) {
+      block->output.resize(2 * block->output.size());
+    }
+    stream->next_out = reinterpret_cast<Bytef*>(&block->output[produced]);
+    stream->avail_out = block->output.size() - produced;
+    error = deflate(stream, flush);
+    produced = block->output.size() - stream->avail_out;
+  } while (error == Z_OK && stream->avail_out == 0);
+  block->output.resize(produced);
+  block->error = error == Z_STREAM_END ? Z_OK : error;
+
+  block->check = options_.format == ZLIB
+                     ? adler32(adler32(0L, Z_NULL, 0), input,
+                               block->input.size())
+                     : crc32(crc32(0L, Z_NULL, 0), input, block->input.size());
+}
+
+int GzipOutputStream::ParallelDeflater::Next(void** data, int* size) {
+  if (current_ != nullptr && used_ == options_.block_size) {
+    int error = Submit(/* last */ false);
+    if (error != Z_OK) return error;
+  }
+  if (current_ == nullptr) {
+    if (free_blocks_.empty()) {
+      current_ = std::make_unique<Block>();
+    } else {
+      current_ = std::move(free_blocks_.back());
+      free_blocks_.pop_back();
+    }
+    current_->input.resize(options_.block_size);
+    used_ = 0;
+  }
+  *data = &current_->input[used_];
+  *size = options_.block_size - used_;
+  used_ = options_.block_size;
+  return Z_OK;
+}
+
+void GzipOutputStream::ParallelDeflater::BackUp(int count) {
+  ABSL_CHECK_GE(used_, count);
+  used_ -= count;
+}
+
+int GzipOutputStream::ParallelDeflater::Submit(bool last) {
+  if (current_ == nullptr) current_ = std::make_unique<Block>();
+  Block* block = current_.get();
+  block->input.resize(used_);
+  block->dictionary = window_;
+  block->last = last;
+  block->done = false;
+  byte_count_ += used_;
+  if (block->input.size() >= kWindowSize) {
+    window_.assign(block->input, block->input.size() - kWindowSize,
+                   kWindowSize);
+  } else {
+    window_.append(block->input);
+    if (window_.size() > kWindowSize) {
+      window_.erase(0, window_.size() - kWindowSize);
+    }
+  }
+  blocks_.push_back(std::move(current_));
+  used_ = 0;
+  {
+    absl::MutexLock lock(&mu_);
+    queue_.push_back(block);
+  }
+
+  while (blocks_.size() > kBlocksPerThread * threads_.size()) {
+    int error = WriteFirst();
+    if (error != Z_OK) return error;
+  }
+  return Z_OK;
+}
+
+int GzipOutputStream::ParallelDeflater::WriteFirst() {
+  Block* block = blocks_.front().get();
+  {
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(&block->done));
+  }
+  int error = block->error;
+  if (error == Z_OK && !header_written_) error = WriteHeader();
+  if (error == Z_OK) {
+    error = Write(block->output.data(), block->output.size());
+  }
+  if (options_.format == ZLIB) {
+    check_ = adler32_combine(check_, block->check, block->input.size());
+  } else {
+    check_ = crc32_combine(check_, block->check, block->input.size());
+  }
+  written_size_ += block->input.size();
+  free_blocks_.push_back(std::move(blocks_.front()));
+  blocks_.pop_front();
+  return error;
+}
+
+int GzipOutputStream::ParallelDeflater::Write(const void* data, size_t size) {
+  const char* input = static_cast<const char*>(data);
+  while (size > 0) {
+    if (sub_data_size_ == 0) {
+      void* sub_data;
+      if (!sub_stream_->Next(&sub_data, &sub_data_size_)) {
+        sub_data_ = nullptr;
+        sub_data_size_ = 0;
+        return Z_BUF_ERROR;
+      }
+      sub_data_ = static_cast<char*>(sub_data);
+    }
+    const size_t n = std::min(size, static_cast<size_t>(sub_data_size_));
+    memcpy(sub_data_, input, n);
+    sub_data_ += n;
+    sub_data_size_ -= static_cast<int>(n);
+    input += n;
+    size -= n;
+  }
+  return Z_OK;
+}
+
+int GzipOutputStream::ParallelDeflater::WriteHeader() {
+  header_written_ = true;
+  // The headers deflate writes for the same options.
+  const int level = options_.compression_level == Z_DEFAULT_COMPRESSION
+                        ? 6
+                        : options_.compression_level;
+  const bool fastest =
+      options_.compression_strategy >= Z_HUFFMAN_ONLY || level < 2;
+  if (options_.format == ZLIB) {
+    const int level_flags = fastest       ? 0
+                            : level < 6   ? 1
+                            : level == 6  ? 2
+                                          : 3;
+    // Deflate with a 32kB window.
+    int header = (Z_DEFLATED + ((15 - 8) << 4)) << 8;
+    header |= level_flags << 6;
+    header += 31 - (header % 31);
+    const unsigned char bytes[2] = {static_cast<unsigned char>(header >> 8),
+                                    static_cast<unsigned char>(header)};
+    return Write(bytes, sizeof(bytes));
+  } else {
+    // No file name or modification time, and the OS is Unix.
+    const unsigned char bytes[10] = {
+        0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0,
+        static_cast<unsigned char>(level == 9 ? 2 : fastest ? 4 : 0), 3};
+    return Write(bytes, sizeof(bytes));
+  }
+}
+
+int GzipOutputStream::ParallelDeflater::WriteTrailer() {
+  unsigned char bytes[8];
+  if (options_.format == ZLIB) {
+    // Adler-32, big endian.
+    for (int i = 0; i < 4; i++) bytes[i] = (check_ >> (24 - 8 * i)) & 0xff;
+    return Write(bytes, 4);
+  } else {
+    // CRC-32 and the size modulo 2^32, little endian.
+    for (int i = 0; i < 4; i++) {
+      bytes[i] = (check_ >> (8 * i)) & 0xff;
+      bytes[4 + i] = (written_size_ >> (8 * i)) & 0xff;
+    }
+    return Write(bytes, 8);
+  }
+}
+
+void GzipOutputStream::ParallelDeflater::BackUpSubStream() {
+  if (sub_data_size_ > 0) sub_stream_->BackUp(sub_data_size_);
+  sub_data_ = nullptr;
+  sub_data_size_ = 0;
+}
+
+int GzipOutputStream::ParallelDeflater::Flush() {
+  int error = used_ > 0 ? Submit(/* last */ false) : Z_OK;
+  while (error == Z_OK && !blocks_.empty()) error = WriteFirst();
+  BackUpSubStream();
+  return error;
+}
+
+int GzipOutputStream::ParallelDeflater::Close() {
+  int error = Submit(/* last */ true);
+  while (error == Z_OK && !blocks_.empty()) error = WriteFirst();
+  if (error == Z_OK) error = WriteTrailer();
+  BackUpSubStream();
+  return error;
+}
+
+// =========================================================================
+
 GzipOutputStream::Options::Options()
     : format(GZIP),
       buffer_size(kDefaultBufferSize),
       compression_level(Z_DEFAULT_COMPRESSION),
-      compression_strategy(Z_DEFAULT_STRATEGY) {}
+      compression_strategy(Z_DEFAULT_STRATEGY),
+      num_threads(1),
+      block_size(kDefaultBlockSize) {}
 
 GzipOutputStream::GzipOutputStream(ZeroCopyOutputStream* sub_stream) {
   Init(sub_stream, Options());
@@ -195,6 +556,15 @@ void GzipOutputStream::Init(ZeroCopyOutputStream* sub_stream,
   sub_stream_ = sub_stream;
   sub_data_ = NULL;
   sub_data_size_ = 0;
+  zcontext_.msg = NULL;
+
+  if (options.num_threads > 1) {
+    input_buffer_length_ = 0;
+    input_buffer_ = NULL;
+    parallel_ = std::make_unique<ParallelDeflater>(sub_stream, options);
+    zerror_ = Z_OK;
+    return;
+  }
 
   input_buffer_length_ = options.buffer_size;
   input_buffer_ = operator new(input_buffer_length_);
@@ -258,6 +628,10 @@ bool GzipOutputStream::Next(void** data, int* size) {
   if ((zerror_ != Z_OK) && (zerror_ != Z_BUF_ERROR)) {
     return false;
   }
+  if (parallel_ != nullptr) {
+    zerror_ = parallel_->Next(data, size);
+    return zerror_ == Z_OK;
+  }
   if (zcontext_.avail_in != 0) {
     zerror_ = Deflate(Z_NO_FLUSH);
     if (zerror_ != Z_OK) {
@@ -277,14 +651,26 @@ bool GzipOutputStream::Next(void** data, int* size) {
   return true;
 }
 void GzipOutputStream::BackUp(int count) {
+  if (parallel_ != nullptr) {
+    parallel_->BackUp(count);
+    return;
+  }
   ABSL_CHECK_GE(zcontext_.avail_in, static_cast<uInt>(count));
   zcontext_.avail_in -= count;
 }
 int64_t GzipOutputStream::ByteCount() const {
+  if (parallel_ != nullptr) return parallel_->ByteCount();
   return zcontext_.total_in + zcontext_.avail_in;
 }
 
 bool GzipOutputStream::Flush() {
+  if (parallel_ != nullptr) {
+    if ((zerror_ != Z_OK) && (zerror_ != Z_BUF_ERROR)) {
+      return false;
+    }
+    zerror_ = parallel_->Flush();
+    return zerror_ == Z_OK;
+  }
   zerror_ = Deflate(Z_FULL_FLUSH);
   // Return true if the flush succeeded or if it was a no-op.
   return (zerror_ == Z_OK) ||
@@ -296,6 +682,11 @@ bool GzipOutputStream::Close() {
   if ((zerror_ != Z_OK) && (zerror_ != Z_BUF_ERROR)) {
     return false;
   }
+  if (parallel_ != nullptr) {
+    bool ok = parallel_->Close() == Z_OK;
+    zerror_ = Z_STREAM_END;
+    return ok;
+  }
   do {
     zerror_ = Deflate(Z_FINISH);
   } while (zerror_ == Z_OK);
@@ -20,6 +20,8 @@
 #ifndef GOOGLE_PROTOBUF_IO_GZIP_STREAM_H__
 #define GOOGLE_PROTOBUF_IO_GZIP_STREAM_H__
 
+#include <memory>
+
 #include "google/protobuf/stubs/common.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/port.h"
@@ -108,6 +110,21 @@ class PROTOBUF_EXPORT GzipOutputStream final : public ZeroCopyOutputStream {
     // zlib.h for definitions of these constants.
     int compression_strategy;
 
+    // Number of threads to compress with.  Defaults to 1, which compresses in
+    // the thread calling Next().
+    //
+    // With more threads, the input is cut into blocks of block_size bytes
+    // that worker threads compress independently, each primed with the last
+    // 32kB before it as dictionary, the way pigz does.  The blocks still form
+    // a single gzip or zlib stream that GzipInputStream or any other inflater
+    // reads, and that is only slightly larger than a serial one.  Flush()
+    // then waits until everything written before is compressed and written
+    // to the underlying stream.
+    int num_threads;
+
+    // Size of the blocks compressed in parallel.  Defaults to 128kB.
+    int block_size;
+
     Options();  // Initializes with default values.
   };
 
@@ -151,6 +168,8 @@ class PROTOBUF_EXPORT GzipOutputStream final : public ZeroCopyOutputStream {
   int64_t ByteCount() const override;
 
  private:
+  class ParallelDeflater;
+
   ZeroCopyOutputStream* sub_stream_;
   // Result from calling Next() on sub_stream_
   void* sub_data_;
@@ -161,6 +180,10 @@ class PROTOBUF_EXPORT GzipOutputStream final : public ZeroCopyOutputStream {
   void* input_buffer_;
   size_t input_buffer_length_;
 
+  // Set if Options::num_threads > 1, in which case it does all the work and
+  // zcontext_ and input_buffer_ are unused.
+  std::unique_ptr<ParallelDeflater> parallel_;
+
   // Shared constructor code.
   void Init(ZeroCopyOutputStream* sub_stream, const Options& options);
 
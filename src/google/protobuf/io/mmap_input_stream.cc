@@ -0,0 +1,204 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/mmap_input_stream.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <limits>
+
+#include "absl/log/absl_check.h"
+#include "absl/log/absl_log.h"
+#include "absl/strings/string_view.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+namespace {
+
+// EINTR sucks.
+int close_no_eintr(int fd) {
+  int result;
+  do {
+    result = close(fd);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+}  // namespace
+
+MmapInputStream::Options::Options()
+    : window_size(0),
+      sequential(true),
+      will_need(false),
+      populate(false),
+      huge_pages(false) {}
+
+MmapInputStream::MmapInputStream(int file_descriptor)
+    : MmapInputStream(file_descriptor, Options()) {}
+
+MmapInputStream::MmapInputStream(int file_descriptor, const Options& options)
+    : file_(file_descriptor), options_(options) {
+  ABSL_CHECK_GE(options.window_size, 0);
+  struct stat info;
+  start_ = lseek(file_, 0, SEEK_CUR);
+  if (start_ < 0 || fstat(file_, &info) != 0) {
+    errno_ = errno;
+    start_ = 0;
+    return;
+  }
+  position_ = start_;
+  end_ = std::max<int64_t>(start_, info.st_size);
+}
+
+MmapInputStream::~MmapInputStream() {
+  if (is_closed_) return;
+  Unmap();
+  if (close_on_delete_) {
+    if (!Close()) {
+      ABSL_LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  } else if (errno_ == 0) {
+    lseek(file_, position_, SEEK_SET);
+  }
+}
+
+bool MmapInputStream::Close() {
+  ABSL_CHECK(!is_closed_);
+
+  is_closed_ = true;
+  Unmap();
+  if (close_no_eintr(file_) != 0) {
+    // The docs on close() do not specify whether a file descriptor is still
+    // open after close() fails with EIO.  However, the glibc source code
+    // seems to indicate that it is not.
+    errno_ = errno;
+    return false;
+  }
+
+  return true;
+}
+
+bool MmapInputStream::Map(int64_t offset) {
+  Unmap();
+  const int64_t page_size = sysconf(_SC_PAGESIZE);
+  window_offset_ = offset - offset % page_size;
+  int64_t length = end_ - window_offset_;
+  if (options_.window_size > 0) {
+    // At least one page, so the window always contains `offset`.
+    length = std::min(length, (options_.window_size + page_size - 1) /
+                                  page_size * page_size);
+  }
+  if (static_cast<uint64_t>(length) > std::numeric_limits<size_t>::max()) {
+    // The rest of the file does not fit in the address space.
+    errno_ = ENOMEM;
+    return false;
+  }
+
+  int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+  if (options_.populate) flags |= MAP_POPULATE;
+#endif
+  void* mapping = mmap(nullptr, static_cast<size_t>(length), PROT_READ, flags,
+                       file_, static_cast<off_t>(window_offset_));
+  if (mapping == MAP_FAILED) {
+    errno_ = errno;
+    return false;
+  }
+  window_ = static_cast<char*>(mapping);
+  window_length_ = static_cast<size_t>(length);
+
+  // The hints are best effort, so errors are ignored.
+  if (options_.sequential) madvise(mapping, window_length_, MADV_SEQUENTIAL);
+  if (options_.will_need) madvise(mapping, window_length_, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  if (options_.huge_pages) madvise(mapping, window_length_, MADV_HUGEPAGE);
+#endif
+  return true;
+}
+
+void MmapInputStream::Unmap() {
+  if (window_ == nullptr) return;
+  munmap(window_, window_length_);
+  window_ = nullptr;
+  window_length_ = 0;
+}
+
+bool MmapInputStream::GetContents(absl::string_view* contents) {
+  ABSL_CHECK(!is_closed_);
+  if (options_.window_size != 0 || errno_ != 0) return false;
+  if (position_ == end_) {
+    *contents = absl::string_view();
+    return true;
+  }
+  if (window_ == nullptr && !Map(position_)) return false;
+  *contents = absl::string_view(window_ + (position_ - window_offset_),
+                                static_cast<size_t>(end_ - position_));
+  return true;
+}
+
+bool MmapInputStream::Next(const void** data, int* size) {
+  ABSL_CHECK(!is_closed_);
+  last_returned_size_ = 0;
+  if (errno_ != 0 || position_ >= end_) return false;
+  if (window_ == nullptr ||
+      position_ >= window_offset_ + static_cast<int64_t>(window_length_)) {
+    if (!Map(position_)) return false;
+  }
+  const int64_t available =
+      window_offset_ + static_cast<int64_t>(window_length_) - position_;
+  *data = window_ + (position_ - window_offset_);
+  *size = static_cast<int>(std::min<int64_t>(available, INT_MAX));
+  position_ += *size;
+  last_returned_size_ = *size;
+  return true;
+}
+
+void MmapInputStream::BackUp(int count) {
+  ABSL_CHECK_GE(count, 0);
+  ABSL_CHECK_LE(count, last_returned_size_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  position_ -= count;
+  last_returned_size_ = 0;
+}
+
+bool MmapInputStream::Skip(int count) {
+  ABSL_CHECK_GE(count, 0);
+  last_returned_size_ = 0;
+  if (errno_ != 0) return false;
+  if (count > end_ - position_) {
+    position_ = end_;
+    return false;
+  }
+  position_ += count;
+  return true;
+}
+
+int64_t MmapInputStream::ByteCount() const { return position_ - start_; }
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // !_WIN32
@@ -0,0 +1,136 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// A ZeroCopyInputStream that maps a file into memory instead of copying it
+// into a buffer.  This pays off for large files that are mostly in the page
+// cache already.
+
+#ifndef GOOGLE_PROTOBUF_IO_MMAP_INPUT_STREAM_H__
+#define GOOGLE_PROTOBUF_IO_MMAP_INPUT_STREAM_H__
+
+#ifndef _WIN32
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+// Reads a file through mmap().  Next() returns the mapped memory itself, either
+// the whole rest of the file at once, or one window at a time for files that
+// should not be mapped entirely.
+//
+// The stream reads the file from the current position of the file descriptor
+// up to the size the file had when the stream was created.  Once the stream is
+// destroyed, the position of the file descriptor is right after the last byte
+// consumed.  If the file is truncated while it is mapped, accessing the lost
+// pages raises SIGBUS, as with any mapping.
+class PROTOBUF_EXPORT MmapInputStream final : public ZeroCopyInputStream {
+ public:
+  struct PROTOBUF_EXPORT Options {
+    // Number of bytes mapped at once, rounded up to whole pages.  Zero maps the
+    // whole rest of the file, which Next() then returns as a single span (or
+    // in spans of INT_MAX bytes for huge files).
+    int64_t window_size;
+
+    // Tells the kernel that the mapping is read in order (MADV_SEQUENTIAL), so
+    // that it reads ahead aggressively and drops the pages behind early.
+    bool sequential;
+
+    // Starts reading in the mapping right away (MADV_WILLNEED).
+    bool will_need;
+
+    // Reads in and maps the whole window when it is mapped (MAP_POPULATE,
+    // Linux only), so that Next() does not page fault afterwards.
+    bool populate;
+
+    // Asks for transparent huge pages (MADV_HUGEPAGE).  This only has an
+    // effect where the kernel supports them for file mappings.
+    bool huge_pages;
+
+    Options();  // Initializes with default values.
+  };
+
+  // Creates a stream that reads from the given file descriptor, which must
+  // support mmap(), e.g. a regular file.
+  explicit MmapInputStream(int file_descriptor);
+  MmapInputStream(int file_descriptor, const Options& options);
+  MmapInputStream(const MmapInputStream&) = delete;
+  MmapInputStream& operator=(const MmapInputStream&) = delete;
+  ~MmapInputStream() override;
+
+  // Unmaps the file and closes the underlying file.  Returns false if an error
+  // occurs during the process; use GetErrno() to examine the error.  Even if
+  // an error occurs, the file descriptor is closed when this returns.
+  bool Close();
+
+  // By default, the file descriptor is not closed when the stream is
+  // destroyed.  Call SetCloseOnDelete(true) to change that.
+  void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
+
+  // If an I/O error has occurred on this file descriptor, this is the
+  // errno from that error.  Otherwise, this is zero.  Once an error
+  // occurs, the stream is broken and all subsequent operations will
+  // fail.
+  int GetErrno() const { return errno_; }
+
+  // If the whole rest of the file is mapped at once (window_size is zero),
+  // sets `*contents` to the bytes that were not consumed yet and returns true.
+  // The bytes stay valid as long as the stream.  Passing them to
+  // Message::ParseFromArray() parses the file without copying anything.
+  bool GetContents(absl::string_view* contents);
+
+  // implements ZeroCopyInputStream ----------------------------------
+  bool Next(const void** data, int* size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64_t ByteCount() const override;
+
+ private:
+  // Maps the window that contains `offset`.  Returns false on error.
+  bool Map(int64_t offset);
+  void Unmap();
+
+  const int file_;
+  const Options options_;
+  bool close_on_delete_ = false;
+  bool is_closed_ = false;
+
+  // The errno of the I/O error, if one has occurred.  Otherwise, zero.
+  int errno_ = 0;
+
+  // Offsets in the file of the first byte to read, of the next byte to return
+  // and of the end of the file.
+  int64_t start_ = 0;
+  int64_t position_ = 0;
+  int64_t end_ = 0;
+
+  // The current mapping, which starts at file offset window_offset_.
+  char* window_ = nullptr;
+  int64_t window_offset_ = 0;
+  size_t window_length_ = 0;
+
+  // Size of the last buffer returned by Next(), for checking BackUp().
+  int last_returned_size_ = 0;
+};
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // !_WIN32
+
+#endif  // GOOGLE_PROTOBUF_IO_MMAP_INPUT_STREAM_H__
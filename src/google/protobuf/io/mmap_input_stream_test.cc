@@ -0,0 +1,139 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/mmap_input_stream.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "google/protobuf/testing/googletest.h"
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace {
+
+class MmapInputStreamTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    for (int i = 0; i < 100000; i++) {
+      data_.push_back(static_cast<char>('a' + i % 26 + i / 1000 % 3));
+    }
+    const std::string filename =
+        absl::StrCat(TestTempDir(), "/mmap_input_stream_test");
+    file_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+    ASSERT_GE(file_, 0);
+    ASSERT_EQ(write(file_, data_.data(), data_.size()),
+              static_cast<ssize_t>(data_.size()));
+    ASSERT_EQ(lseek(file_, 0, SEEK_SET), 0);
+  }
+  void TearDown() override { close(file_); }
+
+  std::string data_;
+  int file_ = -1;
+};
+
+TEST_F(MmapInputStreamTest, WholeFile) {
+  // The stream starts at the current position.
+  ASSERT_EQ(lseek(file_, 3, SEEK_SET), 3);
+  {
+    MmapInputStream input(file_);
+    absl::string_view contents;
+    ASSERT_TRUE(input.GetContents(&contents));
+    EXPECT_EQ(contents, absl::string_view(data_).substr(3));
+
+    const void* buffer;
+    int size;
+    ASSERT_TRUE(input.Next(&buffer, &size));
+    // The mapping itself, in one piece.
+    EXPECT_EQ(buffer, contents.data());
+    EXPECT_EQ(size, static_cast<int>(contents.size()));
+    input.BackUp(10);
+    EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(data_.size() - 13));
+    ASSERT_TRUE(input.GetContents(&contents));
+    EXPECT_EQ(contents, absl::string_view(data_).substr(data_.size() - 10));
+    EXPECT_TRUE(input.Skip(4));
+    EXPECT_FALSE(input.Skip(7));
+    EXPECT_FALSE(input.Next(&buffer, &size));
+    EXPECT_EQ(input.GetErrno(), 0);
+  }
+  EXPECT_EQ(lseek(file_, 0, SEEK_CUR), static_cast<off_t>(data_.size()));
+}
+
+TEST_F(MmapInputStreamTest, Windows) {
+  MmapInputStream::Options options;
+  options.window_size = 4097;
+  options.will_need = true;
+  options.populate = true;
+  options.huge_pages = true;
+
+  std::string result;
+  {
+    MmapInputStream input(file_, options);
+    absl::string_view contents;
+    EXPECT_FALSE(input.GetContents(&contents));
+
+    const void* buffer;
+    int size;
+    for (int i = 1; input.Next(&buffer, &size); i++) {
+      result.append(static_cast<const char*>(buffer), size);
+      if (i % 3 == 0) {
+        input.BackUp(size / 2);
+        result.resize(result.size() - size / 2);
+      }
+      if (i % 5 == 0) {
+        // Skipping past the end consumes the rest.
+        EXPECT_EQ(input.Skip(10000), result.size() + 10000 <= data_.size());
+        result.append(data_, result.size(), 10000);
+      }
+      EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(result.size()));
+    }
+    EXPECT_EQ(input.GetErrno(), 0);
+  }
+  EXPECT_EQ(result, data_);
+}
+
+TEST_F(MmapInputStreamTest, EmptyFile) {
+  ASSERT_EQ(ftruncate(file_, 0), 0);
+  MmapInputStream input(file_);
+  absl::string_view contents = "x";
+  ASSERT_TRUE(input.GetContents(&contents));
+  EXPECT_TRUE(contents.empty());
+  const void* buffer;
+  int size;
+  EXPECT_FALSE(input.Next(&buffer, &size));
+  EXPECT_EQ(input.GetErrno(), 0);
+}
+
+TEST(MmapInputStreamErrorTest, NotMappable) {
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  {
+    MmapInputStream input(pipe_fds[0]);
+    const void* buffer;
+    int size;
+    EXPECT_FALSE(input.Next(&buffer, &size));
+    EXPECT_EQ(input.GetErrno(), ESPIPE);
+  }
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // !_WIN32
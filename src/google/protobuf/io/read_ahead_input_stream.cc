@@ -0,0 +1,202 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/read_ahead_input_stream.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/mutex.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+ReadAheadInputStream::Options::Options()
+    : buffer_size(64 << 10), buffer_count(4) {}
+
+ReadAheadInputStream::ReadAheadInputStream(ZeroCopyInputStream* sub_stream)
+    : ReadAheadInputStream(sub_stream, Options()) {}
+
+ReadAheadInputStream::ReadAheadInputStream(ZeroCopyInputStream* sub_stream,
+                                           const Options& options)
+    : sub_stream_(sub_stream),
+      buffer_size_(options.buffer_size),
+      buffers_(options.buffer_count) {
+  ABSL_CHECK_GT(options.buffer_size, 0);
+  ABSL_CHECK_GE(options.buffer_count, 2);
+  for (Buffer& buffer : buffers_) {
+    buffer.data = std::make_unique<char[]>(buffer_size_);
+  }
+  thread_ = std::thread([this] { Run(); });
+}
+
+ReadAheadInputStream::~ReadAheadInputStream() {
+  {
+    absl::MutexLock lock(&mu_);
+    stop_ = true;
+  }
+  thread_.join();
+}
+
+void ReadAheadInputStream::Run() {
+  while (true) {
+    int64_t skip;
+    Buffer* buffer;
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &ReadAheadInputStream::CanRun));
+      if (stop_) return;
+      skip = pending_skip_;
+      buffer = &buffers_[(head_ + filled_) % buffers_.size()];
+    }
+
+    if (skip > 0) {
+      const int count = static_cast<int>(std::min<int64_t>(skip, INT_MAX));
+      const int64_t start = sub_stream_->ByteCount();
+      const bool skipped = sub_stream_->Skip(count);
+      absl::MutexLock lock(&mu_);
+      // At the end of the data, Skip() stops there.
+      pending_skip_ -= skipped ? count : sub_stream_->ByteCount() - start;
+      if (!skipped) {
+        eof_ = true;
+        return;
+      }
+      continue;
+    }
+
+    // Nobody else touches the buffer after the filled ones.
+    const void* data;
+    int size = 0;
+    bool ok;
+    do {
+      ok = sub_stream_->Next(&data, &size);
+    } while (ok && size == 0);
+    if (!ok) {
+      absl::MutexLock lock(&mu_);
+      eof_ = true;
+      return;
+    }
+    const int copied = std::min(size, buffer_size_);
+    memcpy(buffer->data.get(), data, copied);
+    if (copied < size) sub_stream_->BackUp(size - copied);
+
+    absl::MutexLock lock(&mu_);
+    buffer->start = 0;
+    buffer->size = copied;
+    // Skip() may have been called meanwhile, for data that comes after the
+    // buffers filled before.
+    if (pending_skip_ > 0) {
+      const int dropped =
+          static_cast<int>(std::min<int64_t>(pending_skip_, copied));
+      buffer->start += dropped;
+      buffer->size -= dropped;
+      pending_skip_ -= dropped;
+    }
+    if (buffer->size > 0) ++filled_;
+  }
+}
+
+void ReadAheadInputStream::ReleaseCurrent() {
+  if (!has_current_) return;
+  has_current_ = false;
+  head_ = (head_ + 1) % static_cast<int>(buffers_.size());
+  --filled_;
+}
+
+bool ReadAheadInputStream::Next(const void** data, int* size) {
+  if (!has_current_ || position_ == current_size_) {
+    absl::MutexLock lock(&mu_);
+    ReleaseCurrent();
+    mu_.Await(absl::Condition(this, &ReadAheadInputStream::HasData));
+    if (filled_ == 0) {
+      last_returned_size_ = 0;
+      return false;
+    }
+    const Buffer& buffer = buffers_[head_];
+    has_current_ = true;
+    current_data_ = buffer.data.get() + buffer.start;
+    current_size_ = buffer.size;
+    position_ = 0;
+  }
+  *data = current_data_ + position_;
+  *size = current_size_ - position_;
+  last_returned_size_ = *size;
+  byte_count_ += *size;
+  position_ = current_size_;
+  return true;
+}
+
+void ReadAheadInputStream::BackUp(int count) {
+  ABSL_CHECK_GE(count, 0);
+  ABSL_CHECK_LE(count, last_returned_size_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  position_ -= count;
+  byte_count_ -= count;
+  last_returned_size_ = 0;
+}
+
+bool ReadAheadInputStream::Skip(int count) {
+  ABSL_CHECK_GE(count, 0);
+  last_returned_size_ = 0;
+  if (has_current_) {
+    const int available = current_size_ - position_;
+    if (count <= available) {
+      position_ += count;
+      byte_count_ += count;
+      return true;
+    }
+    position_ = current_size_;
+    byte_count_ += available;
+    count -= available;
+  }
+
+  absl::MutexLock lock(&mu_);
+  ReleaseCurrent();
+  // Drop the buffers that are filled already.
+  while (count > 0 && filled_ > 0) {
+    Buffer& buffer = buffers_[head_];
+    if (buffer.size > count) {
+      buffer.start += count;
+      buffer.size -= count;
+      byte_count_ += count;
+      return true;
+    }
+    byte_count_ += buffer.size;
+    count -= buffer.size;
+    head_ = (head_ + 1) % static_cast<int>(buffers_.size());
+    --filled_;
+  }
+  if (count == 0) return true;
+  if (eof_) return false;
+
+  // Let the helper thread skip the rest in the sub-stream.
+  pending_skip_ = count;
+  mu_.Await(absl::Condition(this, &ReadAheadInputStream::SkipDone));
+  byte_count_ += count - pending_skip_;
+  if (pending_skip_ > 0) {
+    pending_skip_ = 0;
+    return false;
+  }
+  return true;
+}
+
+int64_t ReadAheadInputStream::ByteCount() const { return byte_count_; }
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
@@ -0,0 +1,129 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// A ZeroCopyInputStream decorator that reads its sub-stream on a helper
+// thread, so that slow inputs such as decompressors, pipes or network readers
+// overlap with the work of the caller, typically parsing.
+
+#ifndef GOOGLE_PROTOBUF_IO_READ_AHEAD_INPUT_STREAM_H__
+#define GOOGLE_PROTOBUF_IO_READ_AHEAD_INPUT_STREAM_H__
+
+#include <cstdint>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+// Reads a ZeroCopyInputStream ahead of the caller on a helper thread.
+//
+// The helper thread copies the data of the sub-stream into a ring of
+// buffer_count buffers of buffer_size bytes, which bounds the memory used, and
+// waits whenever all of them are full.  Next() returns the buffers in order.
+// A Skip() past the buffered data is passed on to the sub-stream, so it stays
+// cheap for streams that can seek.
+//
+// The sub-stream must not be used by anyone else while the decorator exists.
+// Since it is read ahead, its position afterwards is unspecified.  Errors of
+// the sub-stream end the stream, like the end of the data.
+class PROTOBUF_EXPORT ReadAheadInputStream final : public ZeroCopyInputStream {
+ public:
+  struct PROTOBUF_EXPORT Options {
+    // Size of each buffer, which is also the most Next() returns at once.
+    int buffer_size;
+
+    // Number of buffers, at least two: one is returned by Next() while the
+    // helper thread fills the others.
+    int buffer_count;
+
+    Options();  // Initializes with default values.
+  };
+
+  // Starts reading `sub_stream`, which is not owned.
+  explicit ReadAheadInputStream(ZeroCopyInputStream* sub_stream);
+  ReadAheadInputStream(ZeroCopyInputStream* sub_stream, const Options& options);
+  ReadAheadInputStream(const ReadAheadInputStream&) = delete;
+  ReadAheadInputStream& operator=(const ReadAheadInputStream&) = delete;
+
+  // Stops the helper thread.  If it is waiting in the Next() of the sub-stream,
+  // this waits for that call to return.
+  ~ReadAheadInputStream() override;
+
+  // implements ZeroCopyInputStream ----------------------------------
+  bool Next(const void** data, int* size) override;
+  void BackUp(int count) override;
+  bool Skip(int count) override;
+  int64_t ByteCount() const override;
+
+ private:
+  struct Buffer {
+    std::unique_ptr<char[]> data;
+    int start = 0;
+    int size = 0;
+  };
+
+  // The loop of the helper thread.
+  void Run();
+
+  // Hands the buffer at the head of the ring back to the helper thread.
+  void ReleaseCurrent() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  bool CanRun() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return stop_ || pending_skip_ > 0 ||
+           filled_ < static_cast<int>(buffers_.size());
+  }
+  bool HasData() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return filled_ > 0 || eof_;
+  }
+  bool SkipDone() const ABSL_SHARED_LOCKS_REQUIRED(mu_) {
+    return pending_skip_ == 0 || eof_;
+  }
+
+  ZeroCopyInputStream* const sub_stream_;
+  const int buffer_size_;
+
+  absl::Mutex mu_;
+  // The ring.  The filled_ buffers starting at head_ hold data; the first of
+  // them is the one Next() returned last, if has_current_.  The helper thread
+  // fills the buffer after them without holding the lock.
+  std::vector<Buffer> buffers_;
+  int head_ ABSL_GUARDED_BY(mu_) = 0;
+  int filled_ ABSL_GUARDED_BY(mu_) = 0;
+  // Bytes the helper thread has to skip before filling more buffers.
+  int64_t pending_skip_ ABSL_GUARDED_BY(mu_) = 0;
+  // The sub-stream has ended.
+  bool eof_ ABSL_GUARDED_BY(mu_) = false;
+  bool stop_ ABSL_GUARDED_BY(mu_) = false;
+
+  // Only used by the caller's thread: the data of the buffer at the head of
+  // the ring, and how much of it was consumed.
+  bool has_current_ = false;
+  const char* current_data_ = nullptr;
+  int current_size_ = 0;
+  int position_ = 0;
+  int last_returned_size_ = 0;
+  int64_t byte_count_ = 0;
+
+  std::thread thread_;
+};
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_IO_READ_AHEAD_INPUT_STREAM_H__
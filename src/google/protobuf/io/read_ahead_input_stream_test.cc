@@ -0,0 +1,132 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/read_ahead_input_stream.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace {
+
+std::string TestData() {
+  std::string data;
+  for (int i = 0; i < 100000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26 + i / 1000 % 3));
+  }
+  return data;
+}
+
+// Returns the data a few bytes at a time, like a slow decompressor.
+class TrickleInputStream final : public CopyingInputStream {
+ public:
+  explicit TrickleInputStream(const std::string& data) : data_(data) {}
+
+  int Read(void* buffer, int size) override {
+    const int count = std::min({size, 13, static_cast<int>(data_.size() -
+                                                            position_)});
+    memcpy(buffer, data_.data() + position_, count);
+    position_ += count;
+    return count;
+  }
+
+ private:
+  const std::string& data_;
+  size_t position_ = 0;
+};
+
+TEST(ReadAheadInputStreamTest, ReadsEverything) {
+  const std::string data = TestData();
+  for (int block_size : {1, 100, 1 << 20}) {
+    SCOPED_TRACE(block_size);
+    ArrayInputStream array_input(data.data(), data.size(), block_size);
+    ReadAheadInputStream::Options options;
+    options.buffer_size = 64;
+    options.buffer_count = 3;
+    ReadAheadInputStream input(&array_input, options);
+
+    std::string result;
+    const void* buffer;
+    int size;
+    while (input.Next(&buffer, &size)) {
+      EXPECT_LE(size, 64);
+      result.append(static_cast<const char*>(buffer), size);
+    }
+    EXPECT_EQ(result, data);
+    EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(data.size()));
+    EXPECT_FALSE(input.Next(&buffer, &size));
+  }
+}
+
+TEST(ReadAheadInputStreamTest, BackUpAndSkip) {
+  const std::string data = TestData();
+  for (int skip : {3, 100, 5000}) {
+    SCOPED_TRACE(skip);
+    ArrayInputStream array_input(data.data(), data.size(), 77);
+    ReadAheadInputStream input(&array_input);
+
+    std::string result;
+    const void* buffer;
+    int size;
+    for (int i = 1; input.Next(&buffer, &size); i++) {
+      result.append(static_cast<const char*>(buffer), size);
+      if (i % 2 == 0) {
+        input.BackUp(size / 2);
+        result.resize(result.size() - size / 2);
+      }
+      if (i % 3 == 0) {
+        // Skipping past the end consumes the rest.
+        EXPECT_EQ(input.Skip(skip), result.size() + skip <= data.size());
+        result.append(data, result.size(), skip);
+      }
+      ASSERT_EQ(input.ByteCount(), static_cast<int64_t>(result.size()));
+    }
+    EXPECT_EQ(result, data);
+  }
+}
+
+TEST(ReadAheadInputStreamTest, SlowSubStream) {
+  const std::string data = TestData();
+  TrickleInputStream trickle(data);
+  CopyingInputStreamAdaptor adaptor(&trickle);
+  ReadAheadInputStream input(&adaptor);
+
+  std::string result;
+  const void* buffer;
+  int size;
+  ASSERT_TRUE(input.Skip(1000));
+  while (input.Next(&buffer, &size)) {
+    result.append(static_cast<const char*>(buffer), size);
+  }
+  EXPECT_EQ(result, data.substr(1000));
+  EXPECT_FALSE(input.Skip(1));
+}
+
+TEST(ReadAheadInputStreamTest, StopsEarly) {
+  const std::string data = TestData();
+  ArrayInputStream array_input(data.data(), data.size(), 10);
+  ReadAheadInputStream::Options options;
+  options.buffer_size = 10;
+  options.buffer_count = 2;
+  ReadAheadInputStream input(&array_input, options);
+  const void* buffer;
+  int size;
+  ASSERT_TRUE(input.Next(&buffer, &size));
+  // The destructor stops the helper thread, which waits for a free buffer.
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
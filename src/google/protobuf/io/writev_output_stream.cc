@@ -0,0 +1,234 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/writev_output_stream.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/log/absl_check.h"
+#include "absl/log/absl_log.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+namespace {
+
+// EINTR sucks.
+int close_no_eintr(int fd) {
+  int result;
+  do {
+    result = close(fd);
+  } while (result < 0 && errno == EINTR);
+  return result;
+}
+
+#ifdef IOV_MAX
+constexpr int kMaxIovecs = IOV_MAX;
+#else
+constexpr int kMaxIovecs = 1024;
+#endif
+
+// Smaller Cords are copied, since an iovec per chunk costs more than copying.
+constexpr size_t kMinCordSizeToAlias = 4096;
+
+}  // namespace
+
+WritevOutputStream::Options::Options()
+    : block_size(64 << 10), flush_threshold(1 << 20), use_sendmsg(false) {}
+
+WritevOutputStream::WritevOutputStream(int file_descriptor)
+    : WritevOutputStream(file_descriptor, Options()) {}
+
+WritevOutputStream::WritevOutputStream(int file_descriptor,
+                                       const Options& options)
+    : file_(file_descriptor), options_(options) {
+  ABSL_CHECK_GT(options.block_size, 0);
+}
+
+WritevOutputStream::~WritevOutputStream() {
+  if (is_closed_) return;
+  if (close_on_delete_) {
+    if (!Close()) {
+      ABSL_LOG(ERROR) << "close() failed: " << strerror(errno_);
+    }
+  } else {
+    Flush();
+  }
+}
+
+bool WritevOutputStream::Flush() {
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0) return false;
+  EndSegment();
+  return WritePending();
+}
+
+bool WritevOutputStream::Close() {
+  bool flush_succeeded = Flush();
+  is_closed_ = true;
+  if (close_no_eintr(file_) != 0) {
+    // The docs on close() do not specify whether a file descriptor is still
+    // open after close() fails with EIO.  However, the glibc source code
+    // seems to indicate that it is not.
+    errno_ = errno;
+    return false;
+  }
+  return flush_succeeded;
+}
+
+void WritevOutputStream::EndSegment() {
+  if (position_ == segment_start_) return;
+  AddPending(segment_start_, position_ - segment_start_);
+  segment_start_ = position_;
+}
+
+void WritevOutputStream::AddPending(const void* data, size_t size) {
+  if (size == 0) return;
+  iovec iov;
+  iov.iov_base = const_cast<void*>(data);
+  iov.iov_len = size;
+  pending_.push_back(iov);
+  pending_bytes_ += static_cast<int64_t>(size);
+}
+
+bool WritevOutputStream::MaybeWritePending() {
+  if (pending_bytes_ < options_.flush_threshold &&
+      pending_.size() < static_cast<size_t>(kMaxIovecs)) {
+    return true;
+  }
+  return WritePending();
+}
+
+ssize_t WritevOutputStream::WriteVector(const iovec* iov, int count) {
+  if (!options_.use_sendmsg) return writev(file_, iov, count);
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = const_cast<iovec*>(iov);
+  message.msg_iovlen = count;
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif
+  return sendmsg(file_, &message, flags);
+}
+
+bool WritevOutputStream::WritePending() {
+  iovec* iov = pending_.data();
+  size_t count = pending_.size();
+  while (count > 0) {
+    const int batch = static_cast<int>(
+        std::min(count, static_cast<size_t>(kMaxIovecs)));
+    ssize_t written;
+    do {
+      written = WriteVector(iov, batch);
+    } while (written < 0 && errno == EINTR);
+    if (written < 0) {
+      errno_ = errno;
+      return false;
+    }
+    written_bytes_ += written;
+    pending_bytes_ -= written;
+
+    // Skip what was written, which may end in the middle of an iovec.
+    size_t remaining = static_cast<size_t>(written);
+    while (remaining > 0 && remaining >= iov->iov_len) {
+      remaining -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (remaining > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+      iov->iov_len -= remaining;
+    }
+  }
+
+  pending_.clear();
+  cords_.clear();
+  used_blocks_ = 0;
+  segment_start_ = position_ = block_end_ = nullptr;
+  return true;
+}
+
+bool WritevOutputStream::Next(void** data, int* size) {
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0) return false;
+  if (position_ == block_end_) {
+    EndSegment();
+    if (!MaybeWritePending()) return false;
+    if (used_blocks_ == blocks_.size()) {
+      blocks_.push_back(std::make_unique<char[]>(options_.block_size));
+    }
+    segment_start_ = position_ = blocks_[used_blocks_++].get();
+    block_end_ = position_ + options_.block_size;
+  }
+  *data = position_;
+  *size = static_cast<int>(block_end_ - position_);
+  position_ = block_end_;
+  return true;
+}
+
+void WritevOutputStream::BackUp(int count) {
+  ABSL_CHECK_GE(count, 0);
+  ABSL_CHECK_LE(count, position_ - segment_start_)
+      << " Can't back up over more bytes than were returned by the last call"
+         " to Next().";
+  position_ -= count;
+}
+
+int64_t WritevOutputStream::ByteCount() const {
+  return written_bytes_ + pending_bytes_ + (position_ - segment_start_);
+}
+
+bool WritevOutputStream::WriteAliasedRaw(const void* data, int size) {
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0) return false;
+  EndSegment();
+  AddPending(data, size);
+  return MaybeWritePending();
+}
+
+bool WritevOutputStream::WriteCord(const absl::Cord& cord) {
+  if (cord.size() < kMinCordSizeToAlias) {
+    return ZeroCopyOutputStream::WriteCord(cord);
+  }
+  ABSL_CHECK(!is_closed_);
+  if (errno_ != 0) return false;
+  EndSegment();
+  // The deque keeps the Cords in place, so their chunks stay where they are.
+  cords_.push_back(cord);
+  for (absl::string_view chunk : cords_.back().Chunks()) {
+    AddPending(chunk.data(), chunk.size());
+  }
+  return MaybeWritePending();
+}
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // !_WIN32
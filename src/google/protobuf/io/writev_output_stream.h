@@ -0,0 +1,149 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// A ZeroCopyOutputStream that gathers the output into a list of buffers and
+// writes them with writev(), so that data which already lives in memory is not
+// copied into a stream buffer first.
+
+#ifndef GOOGLE_PROTOBUF_IO_WRITEV_OUTPUT_STREAM_H__
+#define GOOGLE_PROTOBUF_IO_WRITEV_OUTPUT_STREAM_H__
+
+#ifndef _WIN32
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/cord.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+
+// A ZeroCopyOutputStream which writes to a file descriptor with writev(), or
+// with sendmsg() for sockets.
+//
+// Unlike FileOutputStream, the stream does not copy the data passed to
+// WriteAliasedRaw() or WriteCord() (unless it is small): it only records where
+// the data is, and passes it to the kernel along with its own buffers on the
+// next flush.  Use CodedOutputStream::EnableAliasing() to write large string
+// and bytes fields this way.  Aliased data must stay alive and unchanged until
+// the stream is flushed; Cords are referenced by the stream itself, so to hand
+// over a buffer, wrap it in an absl::Cord.
+//
+// The stream flushes by itself once the pending data reaches flush_threshold
+// bytes.
+class PROTOBUF_EXPORT WritevOutputStream final : public ZeroCopyOutputStream {
+ public:
+  struct PROTOBUF_EXPORT Options {
+    // Size of the buffers returned by Next().
+    int block_size;
+
+    // Pending bytes, including aliased data, that trigger a flush.
+    int64_t flush_threshold;
+
+    // Write with sendmsg(MSG_NOSIGNAL) rather than writev(), so that writing
+    // to a closed socket fails with EPIPE instead of raising SIGPIPE.  The file
+    // descriptor must be a socket.
+    bool use_sendmsg;
+
+    Options();  // Initializes with default values.
+  };
+
+  // Creates a stream that writes to the given Unix file descriptor.
+  explicit WritevOutputStream(int file_descriptor);
+  WritevOutputStream(int file_descriptor, const Options& options);
+  WritevOutputStream(const WritevOutputStream&) = delete;
+  WritevOutputStream& operator=(const WritevOutputStream&) = delete;
+  ~WritevOutputStream() override;
+
+  // Writes all pending data to the file descriptor.  Returns false if an
+  // error occurs; use GetErrno() to examine the error.
+  bool Flush();
+
+  // Flushes any buffers and closes the underlying file.  Returns false if
+  // an error occurs during the process; use GetErrno() to examine the error.
+  // Even if an error occurs, the file descriptor is closed when this returns.
+  bool Close();
+
+  // By default, the file descriptor is not closed when the stream is
+  // destroyed.  Call SetCloseOnDelete(true) to change that.  WARNING:
+  // This leaves no way for the caller to detect if close() fails.  If
+  // detecting close() errors is important to you, you should arrange
+  // to close the descriptor yourself.
+  void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
+
+  // If an I/O error has occurred on this file descriptor, this is the
+  // errno from that error.  Otherwise, this is zero.  Once an error
+  // occurs, the stream is broken and all subsequent operations will
+  // fail.
+  int GetErrno() const { return errno_; }
+
+  // implements ZeroCopyOutputStream ---------------------------------
+  bool Next(void** data, int* size) override;
+  void BackUp(int count) override;
+  int64_t ByteCount() const override;
+  bool WriteAliasedRaw(const void* data, int size) override;
+  bool AllowsAliasing() const override { return true; }
+  bool WriteCord(const absl::Cord& cord) override;
+
+ private:
+  // Adds the bytes written to the current block since the last call to the
+  // pending data.
+  void EndSegment();
+  void AddPending(const void* data, size_t size);
+
+  // Writes the pending data if there is enough of it.
+  bool MaybeWritePending();
+  // Writes the pending data and makes all blocks available again.
+  bool WritePending();
+  // Calls writev() or sendmsg() once.
+  ssize_t WriteVector(const iovec* iov, int count);
+
+  const int file_;
+  const Options options_;
+  bool close_on_delete_ = false;
+  bool is_closed_ = false;
+
+  // The errno of the I/O error, if one has occurred.  Otherwise, zero.
+  int errno_ = 0;
+
+  // The blocks handed out by Next(), kept across flushes.  The first
+  // used_blocks_ of them hold pending data or are being filled.
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  size_t used_blocks_ = 0;
+  // The part of the current block filled since the last EndSegment(), and the
+  // end of the block.
+  char* segment_start_ = nullptr;
+  char* position_ = nullptr;
+  char* block_end_ = nullptr;
+
+  // Data waiting to be written, in order, and the Cords some of it points to.
+  std::vector<iovec> pending_;
+  std::deque<absl::Cord> cords_;
+  int64_t pending_bytes_ = 0;
+  int64_t written_bytes_ = 0;
+};
+
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // !_WIN32
+
+#endif  // GOOGLE_PROTOBUF_IO_WRITEV_OUTPUT_STREAM_H__
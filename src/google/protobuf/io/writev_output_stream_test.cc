@@ -0,0 +1,144 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/io/writev_output_stream.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "google/protobuf/testing/googletest.h"
+#include <gtest/gtest.h>
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/coded_stream.h"
+
+namespace google {
+namespace protobuf {
+namespace io {
+namespace {
+
+class WritevOutputStreamTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    const std::string filename =
+        absl::StrCat(TestTempDir(), "/writev_output_stream_test");
+    file_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+    ASSERT_GE(file_, 0);
+  }
+  void TearDown() override { close(file_); }
+
+  std::string ReadFile() {
+    std::string result(lseek(file_, 0, SEEK_END), '\0');
+    EXPECT_EQ(pread(file_, &result[0], result.size(), 0),
+              static_cast<ssize_t>(result.size()));
+    return result;
+  }
+
+  int file_ = -1;
+};
+
+TEST_F(WritevOutputStreamTest, MixedWrites) {
+  WritevOutputStream::Options options;
+  options.block_size = 100;
+  options.flush_threshold = 5000;
+  const std::string big(10000, 'b');
+  absl::Cord cord;
+  for (int i = 0; i < 20; i++) cord.Append(std::string(1000, 'a' + i));
+  std::string expected;
+  {
+    WritevOutputStream output(file_, options);
+    EXPECT_TRUE(output.AllowsAliasing());
+    for (int i = 0; i < 50; i++) {
+      void* data;
+      int size;
+      ASSERT_TRUE(output.Next(&data, &size));
+      memset(data, '0' + i % 10, size);
+      output.BackUp(size - i % size);
+      expected.append(i % size, '0' + i % 10);
+
+      // Small aliased writes end up in the same writev() call, large ones
+      // trigger a flush.
+      const absl::string_view aliased =
+          i % 5 == 0 ? absl::string_view(big) : "xyz";
+      ASSERT_TRUE(output.WriteAliasedRaw(aliased.data(), aliased.size()));
+      expected.append(aliased.data(), aliased.size());
+
+      ASSERT_TRUE(output.WriteCord(i % 7 == 0 ? cord : absl::Cord("cord")));
+      expected += i % 7 == 0 ? std::string(cord) : "cord";
+      EXPECT_EQ(output.ByteCount(), static_cast<int64_t>(expected.size()));
+    }
+    EXPECT_TRUE(output.Flush());
+    EXPECT_EQ(output.GetErrno(), 0);
+  }
+  EXPECT_EQ(ReadFile(), expected);
+}
+
+TEST_F(WritevOutputStreamTest, CodedOutputStreamAliasing) {
+  WritevOutputStream::Options options;
+  // Small blocks, so that every field is aliased rather than copied.
+  options.block_size = 64;
+  options.flush_threshold = int64_t{1} << 30;
+  std::string expected;
+  const std::string field(1000, 'x');
+  {
+    WritevOutputStream output(file_, options);
+    CodedOutputStream coded_output(&output);
+    coded_output.EnableAliasing(true);
+    // More aliased pieces than fit in one writev() call.
+    for (int i = 0; i < 3000; i++) {
+      coded_output.WriteVarint32(field.size());
+      coded_output.WriteRawMaybeAliased(field.data(), field.size());
+      expected += absl::StrCat("\xe8\x07", field);
+    }
+  }
+  EXPECT_EQ(ReadFile(), expected);
+}
+
+TEST(WritevOutputStreamSocketTest, SendMsg) {
+  int sockets[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+  WritevOutputStream::Options options;
+  options.use_sendmsg = true;
+  const std::string data(5000, 'd');
+  {
+    WritevOutputStream output(sockets[0], options);
+    ASSERT_TRUE(output.WriteAliasedRaw(data.data(), data.size()));
+    ASSERT_TRUE(output.Flush());
+  }
+  std::string received(data.size(), '\0');
+  size_t offset = 0;
+  while (offset < received.size()) {
+    const ssize_t n =
+        read(sockets[1], &received[offset], received.size() - offset);
+    ASSERT_GT(n, 0);
+    offset += n;
+  }
+  EXPECT_EQ(received, data);
+
+  // Writing to a closed socket fails instead of raising SIGPIPE.
+  close(sockets[1]);
+  WritevOutputStream output(sockets[0], options);
+  ASSERT_TRUE(output.WriteAliasedRaw(data.data(), data.size()));
+  EXPECT_FALSE(output.Flush());
+  EXPECT_EQ(output.GetErrno(), EPIPE);
+  close(sockets[0]);
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace protobuf
+}  // namespace google
+
+#endif  // !_WIN32
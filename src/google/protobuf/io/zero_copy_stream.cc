@@ -11,6 +11,8 @@
 
 #include "google/protobuf/io/zero_copy_stream.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <utility>
 
@@ -82,6 +84,40 @@ bool ZeroCopyInputStream::ReadCord(absl::Cord* cord, int count) {
   return true;
 }
 
+bool ZeroCopyInputStream::CopyTo(ZeroCopyOutputStream* output,
+                                  int64_t count) {
+  void* out = nullptr;
+  int out_size = 0;
+  while (count > 0) {
+    const void* in;
+    int in_size;
+    if (!Next(&in, &in_size)) break;
+    if (in_size > count) {
+      BackUp(in_size - static_cast<int>(count));
+      in_size = static_cast<int>(count);
+    }
+    count -= in_size;
+    const char* data = static_cast<const char*>(in);
+    while (in_size > 0) {
+      if (out_size == 0 && !output->Next(&out, &out_size)) return false;
+      const int n = std::min(in_size, out_size);
+      memcpy(out, data, n);
+      out = static_cast<char*>(out) + n;
+      out_size -= n;
+      data += n;
+      in_size -= n;
+    }
+  }
+  if (out != nullptr) output->BackUp(out_size);
+  return count == 0;
+}
+
+bool CopyStream(ZeroCopyInputStream* input, ZeroCopyOutputStream* output,
+                int64_t count) {
+  if (count <= 0) return true;
+  return input->CopyTo(output, count);
+}
+
 bool ZeroCopyOutputStream::WriteCord(const absl::Cord& cord) {
   if (cord.empty()) return true;
 
@@ -116,6 +152,11 @@ bool ZeroCopyOutputStream::WriteAliasedRaw(const void* /* data */,
   return false;
 }
 
+int64_t ZeroCopyOutputStream::WriteFromFileDescriptor(int /* file_descriptor */,
+                                                      int64_t /* count */) {
+  return 0;
+}
+
 }  // namespace io
 }  // namespace protobuf
 }  // namespace google
@@ -84,6 +84,8 @@
 #ifndef GOOGLE_PROTOBUF_IO_ZERO_COPY_STREAM_H__
 #define GOOGLE_PROTOBUF_IO_ZERO_COPY_STREAM_H__
 
+#include <cstdint>
+
 #include "google/protobuf/stubs/common.h"
 #include "absl/strings/cord.h"
 #include "google/protobuf/port.h"
@@ -96,6 +98,8 @@ namespace google {
 namespace protobuf {
 namespace io {
 
+class ZeroCopyOutputStream;
+
 // Abstract interface similar to an input stream but designed to minimize
 // copying.
 class PROTOBUF_EXPORT ZeroCopyInputStream {
@@ -169,6 +173,18 @@ class PROTOBUF_EXPORT ZeroCopyInputStream {
   //
   virtual bool ReadCord(absl::Cord* cord, int count);
 
+  // Reads the next `count` bytes and writes them to `output`.
+  //
+  // Returns false if the input ended or an error occurred before `count`
+  // bytes were read, or if writing to `output` failed.  As much data as
+  // possible is copied in that case.  The default implementation copies the
+  // buffers returned by Next() into the buffers of `output`.
+  //
+  // Some streams may implement this in a way that avoids copying, by handing
+  // their data to WriteCord(), WriteAliasedRaw() or
+  // WriteFromFileDescriptor() of `output`.  Use CopyStream() rather than
+  // calling this directly.
+  virtual bool CopyTo(ZeroCopyOutputStream* output, int64_t count);
 };
 
 // Abstract interface similar to an output stream but designed to minimize
@@ -249,8 +265,38 @@ class PROTOBUF_EXPORT ZeroCopyOutputStream {
   // data by copying and managing a copy of the provided cord instead.
   virtual bool WriteCord(const absl::Cord& cord);
 
+  // Writes up to `count` bytes read from the current position of the file
+  // descriptor `file_descriptor` to the output, and returns the number of
+  // bytes written, or 0 if none could be.
+  //
+  // Streams that write to a file descriptor may implement this with system
+  // calls that move the data inside the kernel, such as splice() or
+  // copy_file_range() on Linux.  The default implementation returns 0, and
+  // callers then read the data themselves.  Implementations consume no more
+  // of `file_descriptor` than they write, unless an error occurs.
+  virtual int64_t WriteFromFileDescriptor(int file_descriptor, int64_t count);
+
+  // Tells the stream that about `count` more bytes are going to be written,
+  // for example the serialized size of a message.  Streams that allocate
+  // their buffers may use this to allocate them at once rather than grow them
+  // as data comes in.  It is only a hint: more or less data may be written.
+  // Call it before Next(), or after BackUp().  The default implementation
+  // does nothing.
+  virtual void ExpectBytes(int64_t /* count */) {}
 };
 
+// Copies the next `count` bytes of `input` to `output`.  Returns false if
+// `input` has less data or an error occurred; as much as possible is copied
+// then.
+//
+// Data is shared rather than copied when the streams support it: a Cord read
+// from a CordInputStream is appended to a CordOutputStream by reference, an
+// ArrayInputStream hands its buffer to WriteAliasedRaw() of outputs that
+// allow aliasing (the array must then outlive the output), and on Linux data
+// moves from a FileInputStream to a FileOutputStream within the kernel.
+PROTOBUF_EXPORT bool CopyStream(ZeroCopyInputStream* input,
+                                ZeroCopyOutputStream* output, int64_t count);
+
 }  // namespace io
 }  // namespace protobuf
 }  // namespace google
@@ -18,7 +18,9 @@
 #include <errno.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 
 #include "google/protobuf/stubs/common.h"
 #include "absl/log/absl_check.h"
@@ -72,7 +74,32 @@ void FileInputStream::BackUp(int count) { impl_.BackUp(count); }
 
 bool FileInputStream::Skip(int count) { return impl_.Skip(count); }
 
-int64_t FileInputStream::ByteCount() const { return impl_.ByteCount(); }
+int64_t FileInputStream::ByteCount() const {
+  return impl_.ByteCount() + spliced_bytes_;
+}
+
+bool FileInputStream::CopyTo(ZeroCopyOutputStream* output, int64_t count) {
+  if (count <= 0) return true;
+  // Data that was backed up over is in the buffer, ahead of the file position.
+  const int buffered =
+      static_cast<int>(std::min<int64_t>(count, impl_.backup_bytes_));
+  if (buffered > 0) {
+    if (!impl_.CopyTo(output, buffered)) return false;
+    count -= buffered;
+  }
+  if (!impl_.failed_) {
+    while (count > 0) {
+      const int64_t written = output->WriteFromFileDescriptor(
+          copying_input_.file_descriptor(), count);
+      if (written <= 0) break;
+      spliced_bytes_ += written;
+      count -= written;
+    }
+  }
+  // Copies what is left, if `output` does not read from file descriptors.
+  // This also reports the end of the file and read errors.
+  return impl_.CopyTo(output, count);
+}
 
 FileInputStream::CopyingFileInputStream::CopyingFileInputStream(
     int file_descriptor)
@@ -165,6 +192,19 @@ FileOutputStream::CopyingFileOutputStream::CopyingFileOutputStream(
 
 FileOutputStream::~FileOutputStream() { Flush(); }
 
+int64_t FileOutputStream::ByteCount() const {
+  return CopyingOutputStreamAdaptor::ByteCount() + spliced_bytes_;
+}
+
+int64_t FileOutputStream::WriteFromFileDescriptor(int file_descriptor,
+                                                  int64_t count) {
+  if (count <= 0 || !Flush()) return 0;
+  const int64_t written =
+      copying_output_.WriteFromFileDescriptor(file_descriptor, count);
+  spliced_bytes_ += written;
+  return written;
+}
+
 FileOutputStream::CopyingFileOutputStream::~CopyingFileOutputStream() {
   if (close_on_delete_) {
     if (!Close()) {
@@ -223,6 +263,80 @@ bool FileOutputStream::CopyingFileOutputStream::Write(const void* buffer,
   return true;
 }
 
+int64_t FileOutputStream::CopyingFileOutputStream::WriteFromFileDescriptor(
+    int file_descriptor, int64_t count) {
+  ABSL_CHECK(!is_closed_);
+  int64_t written = 0;
+#if defined(__linux__)
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+  // Works between regular files, and may share their blocks on file systems
+  // that support it.
+  while (written < count) {
+    ssize_t bytes;
+    do {
+      bytes = copy_file_range(file_descriptor, nullptr, file_, nullptr,
+                              static_cast<size_t>(count - written), 0);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes == 0) return written;  // End of the input.
+    if (bytes < 0) break;
+    written += bytes;
+  }
+  if (written > 0) return written;
+#endif  // __GLIBC__
+
+  // splice() needs a pipe on one side, so the data goes through one.
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_CLOEXEC) != 0) return 0;
+  static constexpr int64_t kMaxSpliceSize = 1 << 16;
+  while (written < count) {
+    ssize_t in;
+    do {
+      in = splice(file_descriptor, nullptr, pipe_fds[1], nullptr,
+                  static_cast<size_t>(std::min(count - written,
+                                               kMaxSpliceSize)),
+                  SPLICE_F_MOVE);
+    } while (in < 0 && errno == EINTR);
+    if (in <= 0) break;
+
+    ssize_t out = 0;
+    while (out < in) {
+      ssize_t bytes;
+      do {
+        bytes = splice(pipe_fds[0], nullptr, file_, nullptr,
+                       static_cast<size_t>(in - out), SPLICE_F_MOVE);
+      } while (bytes < 0 && errno == EINTR);
+      if (bytes <= 0) break;
+      out += bytes;
+    }
+    written += out;
+    if (out < in) {
+      // The data cannot be spliced into the file, so it is written the usual
+      // way, including what was already read into the pipe.
+      const int size = static_cast<int>(in - out);
+      std::unique_ptr<char[]> buffer(new char[size]);
+      int read_size = 0;
+      while (read_size < size) {
+        ssize_t bytes;
+        do {
+          bytes = read(pipe_fds[0], buffer.get() + read_size, size - read_size);
+        } while (bytes < 0 && errno == EINTR);
+        if (bytes <= 0) break;
+        read_size += bytes;
+      }
+      if (read_size == size && Write(buffer.get(), size)) written += size;
+      break;
+    }
+  }
+  close_no_eintr(pipe_fds[0]);
+  close_no_eintr(pipe_fds[1]);
+#else
+  (void)file_descriptor;
+  (void)count;
+#endif  // __linux__
+  return written;
+}
+
 // ===================================================================
 
 IstreamInputStream::IstreamInputStream(std::istream* input, int block_size)
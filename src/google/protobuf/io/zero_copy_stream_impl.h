@@ -17,6 +17,7 @@
 #ifndef GOOGLE_PROTOBUF_IO_ZERO_COPY_STREAM_IMPL_H__
 #define GOOGLE_PROTOBUF_IO_ZERO_COPY_STREAM_IMPL_H__
 
+#include <cstdint>
 #include <iosfwd>
 #include <string>
 
@@ -37,8 +38,8 @@ namespace io {
 //
 // FileInputStream is preferred over using an ifstream with IstreamInputStream.
 // The latter will introduce an extra layer of buffering, harming performance.
-// Also, it's conceivable that FileInputStream could someday be enhanced
-// to use zero-copy file descriptors on OSs which support them.
+// On Linux, CopyStream() from a FileInputStream to a FileOutputStream moves
+// the data within the kernel.
 class PROTOBUF_EXPORT FileInputStream final : public ZeroCopyInputStream {
  public:
   // Creates a stream that reads from the given Unix file descriptor.
@@ -72,6 +73,9 @@ class PROTOBUF_EXPORT FileInputStream final : public ZeroCopyInputStream {
   void BackUp(int count) override;
   bool Skip(int count) override;
   int64_t ByteCount() const override;
+  // Lets `output` read from the file descriptor directly, which moves the
+  // data within the kernel when `output` is a FileOutputStream on Linux.
+  bool CopyTo(ZeroCopyOutputStream* output, int64_t count) override;
 
  private:
   class PROTOBUF_EXPORT CopyingFileInputStream final
@@ -85,6 +89,7 @@ class PROTOBUF_EXPORT FileInputStream final : public ZeroCopyInputStream {
     bool Close();
     void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
     int GetErrno() const { return errno_; }
+    int file_descriptor() const { return file_; }
 
     // implements CopyingInputStream ---------------------------------
     int Read(void* buffer, int size) override;
@@ -106,6 +111,8 @@ class PROTOBUF_EXPORT FileInputStream final : public ZeroCopyInputStream {
 
   CopyingFileInputStream copying_input_;
   CopyingInputStreamAdaptor impl_;
+  // Bytes that CopyTo() had written to the output without reading them.
+  int64_t spliced_bytes_ = 0;
 };
 
 // ===================================================================
@@ -114,9 +121,7 @@ class PROTOBUF_EXPORT FileInputStream final : public ZeroCopyInputStream {
 //
 // FileOutputStream is preferred over using an ofstream with
 // OstreamOutputStream.  The latter will introduce an extra layer of buffering,
-// harming performance.  Also, it's conceivable that FileOutputStream could
-// someday be enhanced to use zero-copy file descriptors on OSs which
-// support them.
+// harming performance.
 class PROTOBUF_EXPORT FileOutputStream final
     : public CopyingOutputStreamAdaptor {
  public:
@@ -148,6 +153,12 @@ class PROTOBUF_EXPORT FileOutputStream final
   // fail.
   int GetErrno() const { return copying_output_.GetErrno(); }
 
+  // implements ZeroCopyOutputStream ---------------------------------
+  int64_t ByteCount() const override;
+  // On Linux, flushes the buffer and moves the data with copy_file_range()
+  // or splice(), without copying it to user space.
+  int64_t WriteFromFileDescriptor(int file_descriptor, int64_t count) override;
+
  private:
   class PROTOBUF_EXPORT CopyingFileOutputStream final
       : public CopyingOutputStream {
@@ -161,6 +172,10 @@ class PROTOBUF_EXPORT FileOutputStream final
     void SetCloseOnDelete(bool value) { close_on_delete_ = value; }
     int GetErrno() const { return errno_; }
 
+    // Writes up to `count` bytes of `file_descriptor` without copying them
+    // to user space.  Returns the number of bytes written.
+    int64_t WriteFromFileDescriptor(int file_descriptor, int64_t count);
+
     // implements CopyingOutputStream --------------------------------
     bool Write(const void* buffer, int size) override;
 
@@ -175,6 +190,8 @@ class PROTOBUF_EXPORT FileOutputStream final
   };
 
   CopyingFileOutputStream copying_output_;
+  // Bytes written by WriteFromFileDescriptor().
+  int64_t spliced_bytes_ = 0;
 };
 
 // ===================================================================
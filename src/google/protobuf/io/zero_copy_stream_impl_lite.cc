@@ -81,6 +81,19 @@ bool ArrayInputStream::Skip(int count) {
 
 int64_t ArrayInputStream::ByteCount() const { return position_; }
 
+bool ArrayInputStream::CopyTo(ZeroCopyOutputStream* output, int64_t count) {
+  if (count <= 0) return true;
+  if (!output->AllowsAliasing()) {
+    return ZeroCopyInputStream::CopyTo(output, count);
+  }
+  last_returned_size_ = 0;  // Don't let caller back up.
+  const int n = static_cast<int>(std::min<int64_t>(count, size_ - position_));
+  const uint8_t* data = data_ + position_;
+  position_ += n;
+  if (n > 0 && !output->WriteAliasedRaw(data, n)) return false;
+  return n == count;
+}
+
 
 // ===================================================================
 
@@ -136,10 +149,8 @@ bool StringOutputStream::Next(void** data, int* size) {
   // Avoid integer overflow in returned '*size'.
   new_size = std::min(new_size, old_size + std::numeric_limits<int>::max());
   // Increase the size, also make sure that it is at least kMinimumSize.
-  absl::strings_internal::STLStringResizeUninitialized(
-      target_,
-      std::max(new_size,
-               kMinimumSize + 0));  // "+ 0" works around GCC4 weirdness.
+  Resize(std::max(new_size,
+                  kMinimumSize + 0));  // "+ 0" works around GCC4 weirdness.
 
   *data = mutable_string_data(target_) + old_size;
   *size = target_->size() - old_size;
@@ -153,6 +164,32 @@ void StringOutputStream::BackUp(int count) {
   target_->resize(target_->size() - count);
 }
 
+void StringOutputStream::ExpectBytes(int64_t count) {
+  ABSL_CHECK(target_ != NULL);
+  if (count <= 0) return;
+  const size_t size = target_->size();
+  // Like Next(), never let the string grow by more than INT_MAX at once.
+  const size_t new_size = size + static_cast<size_t>(std::min<int64_t>(
+                                     count, std::numeric_limits<int>::max()));
+  if (new_size <= target_->capacity()) return;
+  const char* old_data = target_->data();
+  target_->reserve(new_size);
+  if (target_->data() != old_data && size > 0) {
+    ++reallocation_count_;
+    reallocated_bytes_ += size;
+  }
+}
+
+void StringOutputStream::Resize(size_t new_size) {
+  const size_t old_size = target_->size();
+  const char* old_data = target_->data();
+  absl::strings_internal::STLStringResizeUninitialized(target_, new_size);
+  if (target_->data() != old_data && old_size > 0) {
+    ++reallocation_count_;
+    reallocated_bytes_ += old_size;
+  }
+}
+
 int64_t StringOutputStream::ByteCount() const {
   ABSL_CHECK(target_ != NULL);
   return target_->size();
@@ -464,6 +501,17 @@ bool LimitingInputStream::ReadCord(absl::Cord* cord, int count) {
   return false;
 }
 
+bool LimitingInputStream::CopyTo(ZeroCopyOutputStream* output,
+                                 int64_t count) {
+  if (count <= 0) return true;
+  if (limit_ <= 0) return false;
+  const int64_t n = std::min(count, limit_);
+  const int64_t start = input_->ByteCount();
+  const bool copied = input_->CopyTo(output, n);
+  limit_ -= input_->ByteCount() - start;
+  return copied && n == count;
+}
+
 
 // ===================================================================
 CordInputStream::CordInputStream(const absl::Cord* cord)
@@ -555,6 +603,18 @@ bool CordInputStream::ReadCord(absl::Cord* cord, int count) {
   return n == static_cast<size_t>(count);
 }
 
+bool CordInputStream::CopyTo(ZeroCopyOutputStream* output, int64_t count) {
+  while (count > 0) {
+    const int n = static_cast<int>(
+        std::min<int64_t>(count, std::numeric_limits<int>::max()));
+    absl::Cord cord;
+    const bool read = ReadCord(&cord, n);
+    if (!output->WriteCord(cord) || !read) return false;
+    count -= n;
+  }
+  return true;
+}
+
 
 CordOutputStream::CordOutputStream(size_t size_hint) : size_hint_(size_hint) {}
 
@@ -620,7 +680,12 @@ bool CordOutputStream::Next(void** data, int* size) {
       ABSL_FALLTHROUGH_INTENDED;
     case State::kEmpty:
       assert(buffer_.length() == 0);
-      buffer_ = absl::CordBuffer::CreateWithDefaultLimit(desired_size);
+      // With a size hint, the buffer can be larger than the default limit
+      // since we know it will be filled.
+      buffer_ = size_hint_ > cord_size
+                    ? absl::CordBuffer::CreateWithCustomLimit(
+                          absl::CordBuffer::kCustomLimit, desired_size)
+                    : absl::CordBuffer::CreateWithDefaultLimit(desired_size);
       break;
   }
 
@@ -666,6 +731,11 @@ int64_t CordOutputStream::ByteCount() const {
   return static_cast<int64_t>(cord_.size() + buffer_.length());
 }
 
+void CordOutputStream::ExpectBytes(int64_t count) {
+  if (count <= 0) return;
+  size_hint_ = std::max(size_hint_, static_cast<size_t>(ByteCount() + count));
+}
+
 bool CordOutputStream::WriteCord(const absl::Cord& cord) {
   cord_.Append(std::move(buffer_));
   cord_.Append(cord);
@@ -66,6 +66,9 @@ class PROTOBUF_EXPORT ArrayInputStream final : public ZeroCopyInputStream {
   void BackUp(int count) override;
   bool Skip(int count) override;
   int64_t ByteCount() const override;
+  // Hands the array to WriteAliasedRaw() if `output` allows aliasing, in
+  // which case the array must outlive `output`.
+  bool CopyTo(ZeroCopyOutputStream* output, int64_t count) override;
 
 
  private:
@@ -137,11 +140,23 @@ class PROTOBUF_EXPORT StringOutputStream final : public ZeroCopyOutputStream {
   bool Next(void** data, int* size) override;
   void BackUp(int count) override;
   int64_t ByteCount() const override;
+  // Reserves room for `count` more bytes in the string.
+  void ExpectBytes(int64_t count) override;
+
+  // Number of times the contents of the string had to be moved to a larger
+  // allocation, and the number of bytes copied by doing so.
+  int reallocation_count() const { return reallocation_count_; }
+  int64_t reallocated_bytes() const { return reallocated_bytes_; }
 
  private:
   static constexpr size_t kMinimumSize = 16;
 
+  // Resizes the string to `new_size`, counting the reallocation if any.
+  void Resize(size_t new_size);
+
   std::string* target_;
+  int reallocation_count_ = 0;
+  int64_t reallocated_bytes_ = 0;
 };
 
 // Note:  There is no StringInputStream.  Instead, just create an
@@ -213,6 +228,10 @@ class PROTOBUF_EXPORT CopyingInputStreamAdaptor : public ZeroCopyInputStream {
   int64_t ByteCount() const override;
 
  private:
+  // Reads the data that was backed up over directly from the underlying
+  // file in CopyTo().
+  friend class FileInputStream;
+
   // Insures that buffer_ is not NULL.
   void AllocateBufferIfNeeded();
   // Frees the buffer and resets buffer_used_.
@@ -353,6 +372,7 @@ class PROTOBUF_EXPORT LimitingInputStream final : public ZeroCopyInputStream {
   bool Skip(int count) override;
   int64_t ByteCount() const override;
   bool ReadCord(absl::Cord* cord, int count) override;
+  bool CopyTo(ZeroCopyOutputStream* output, int64_t count) override;
 
 
  private:
@@ -387,6 +407,9 @@ class PROTOBUF_EXPORT CordInputStream final : public ZeroCopyInputStream {
   bool Skip(int count) override;
   int64_t ByteCount() const override;
   bool ReadCord(absl::Cord* cord, int count) override;
+  // Passes the data to WriteCord() of `output`, so that a CordOutputStream
+  // shares the chunks of the cord rather than copying them.
+  bool CopyTo(ZeroCopyOutputStream* output, int64_t count) override;
 
 
  private:
@@ -416,8 +439,8 @@ class PROTOBUF_EXPORT CordOutputStream final : public ZeroCopyOutputStream {
  public:
   // Creates an OutputStream streaming serialized data into a Cord. `size_hint`,
   // if given, is the expected total size of the resulting Cord. This is a hint
-  // only, used for optimization. Callers can obtain the generated Cord value by
-  // invoking `Consume()`.
+  // only, used for optimization: buffers are sized to fit it, up to 64kB each.
+  // Callers can obtain the generated Cord value by invoking `Consume()`.
   explicit CordOutputStream(size_t size_hint = 0);
 
   // Creates an OutputStream with an initial Cord value. This constructor can be
@@ -463,6 +486,8 @@ class PROTOBUF_EXPORT CordOutputStream final : public ZeroCopyOutputStream {
   void BackUp(int count) final;
   int64_t ByteCount() const final;
   bool WriteCord(const absl::Cord& cord) final;
+  // Raises the size hint to fit `count` more bytes.
+  void ExpectBytes(int64_t count) final;
 
   // Consumes the serialized data as a cord value. `Consume()` internally
   // flushes any pending state 'as if' BackUp(0) was called. While a final call
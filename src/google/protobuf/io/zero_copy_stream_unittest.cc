@@ -590,6 +590,60 @@ TEST_F(IoTest, CompressionOptions) {
   EXPECT_TRUE(Uncompress(zlib_compressed) == golden);
 }
 
+TEST_F(IoTest, ParallelGzipIo) {
+  const int kBufferSize = 2 * 1024;
+  uint8* buffer = new uint8[kBufferSize];
+  for (int i = 0; i < kBlockSizeCount; i++) {
+    for (int j = 0; j < kBlockSizeCount; j++) {
+      int size;
+      {
+        ArrayOutputStream output(buffer, kBufferSize, kBlockSizes[i]);
+        GzipOutputStream::Options options;
+        options.num_threads = 3;
+        // Tiny blocks, so that WriteStuff() spans several of them.
+        options.block_size = 7;
+        GzipOutputStream gzout(&output, options);
+        WriteStuff(&gzout);
+        EXPECT_TRUE(gzout.Flush());
+        EXPECT_TRUE(gzout.Close());
+        size = output.ByteCount();
+      }
+      {
+        ArrayInputStream input(buffer, size, kBlockSizes[j]);
+        GzipInputStream gzin(&input, GzipInputStream::GZIP);
+        ReadStuff(&gzin);
+      }
+    }
+  }
+  delete[] buffer;
+}
+
+TEST_F(IoTest, ParallelCompression) {
+  std::string data;
+  for (int i = 0; i < 1000000; i++) {
+    data.push_back(static_cast<char>('a' + i % 26 + i / 1000 % 7));
+  }
+  for (GzipOutputStream::Format format :
+       {GzipOutputStream::GZIP, GzipOutputStream::ZLIB}) {
+    GzipOutputStream::Options options;
+    options.format = format;
+    std::string serial_compressed = Compress(data, options);
+    for (int num_threads : {2, 5}) {
+      options.num_threads = num_threads;
+      options.block_size = 10000;
+      std::string compressed = Compress(data, options);
+      EXPECT_EQ(Uncompress(compressed), data);
+      // Priming each block with the data before it keeps the result close to
+      // what a single thread produces.
+      EXPECT_LT(compressed.size(), serial_compressed.size() * 11 / 10);
+    }
+  }
+
+  GzipOutputStream::Options options;
+  options.num_threads = 2;
+  EXPECT_EQ(Uncompress(Compress("", options)), "");
+}
+
 TEST_F(IoTest, TwoSessionWriteGzip) {
   // Test that two concatenated gzip streams can be read correctly
 
@@ -706,6 +760,36 @@ TEST_F(IoTest, StringIo) {
   }
 }
 
+TEST(StringOutputStreamTest, ExpectBytesReservesOnce) {
+  std::string str = "header";
+  StringOutputStream output(&str);
+  output.ExpectBytes(100000);
+  int64_t written = 0;
+  void* data;
+  int size;
+  while (written < 100000) {
+    ASSERT_TRUE(output.Next(&data, &size));
+    written += size;
+  }
+  output.BackUp(static_cast<int>(written - 100000));
+  EXPECT_EQ(output.ByteCount(), 100006);
+  EXPECT_EQ(output.reallocation_count(), 1);
+  EXPECT_EQ(output.reallocated_bytes(), 6);
+}
+
+TEST(StringOutputStreamTest, CountsReallocations) {
+  std::string str = "header";
+  StringOutputStream output(&str);
+  int64_t written = 0;
+  void* data;
+  int size;
+  while (written < 100000) {
+    ASSERT_TRUE(output.Next(&data, &size));
+    written += size;
+  }
+  EXPECT_GT(output.reallocation_count(), 5);
+  EXPECT_GT(output.reallocated_bytes(), 100000);
+}
 
 TEST(DefaultReadCordTest, ReadSmallCord) {
   std::string source = "abcdefghijk";
@@ -988,6 +1072,100 @@ TEST_F(IoTest, ReadCordEof) {
   EXPECT_EQ(expected, dest);
 }
 
+TEST(CopyStreamTest, CordToCordSharesChunks) {
+  absl::Cord source(std::string(100000, 'x'));
+  source.Append(std::string(100000, 'y'));
+
+  CordInputStream input(&source);
+  ASSERT_TRUE(input.Skip(10));
+  CordOutputStream output;
+  ASSERT_TRUE(CopyStream(&input, &output, 150000));
+  EXPECT_EQ(input.ByteCount(), 150010);
+  EXPECT_EQ(output.ByteCount(), 150000);
+  const absl::Cord dest = output.Consume();
+  EXPECT_EQ(dest, source.Subcord(10, 150000));
+
+  // The first chunk points into the source rather than to a copy.
+  const absl::string_view source_chunk = *source.Chunks().begin();
+  const absl::string_view dest_chunk = *dest.Chunks().begin();
+  EXPECT_EQ(dest_chunk.data(), source_chunk.data() + 10);
+}
+
+TEST(CopyStreamTest, ArrayToString) {
+  const std::string source = "0123456789abcdef";
+  for (int block_size : {-1, 1, 3}) {
+    ArrayInputStream input(source.data(), source.size(), block_size);
+    std::string dest;
+    {
+      StringOutputStream output(&dest);
+      EXPECT_TRUE(CopyStream(&input, &output, 10));
+      EXPECT_EQ(output.ByteCount(), 10);
+    }
+    EXPECT_EQ(dest, "0123456789");
+    const void* data;
+    int size;
+    ASSERT_TRUE(input.Next(&data, &size));
+    EXPECT_EQ(static_cast<const char*>(data)[0], 'a');
+  }
+}
+
+class StringCopyingOutputStream : public CopyingOutputStream {
+ public:
+  explicit StringCopyingOutputStream(std::string* target) : target_(target) {}
+
+  bool Write(const void* buffer, int size) override {
+    target_->append(static_cast<const char*>(buffer), size);
+    write_count_++;
+    return true;
+  }
+
+  int write_count() const { return write_count_; }
+
+ private:
+  std::string* target_;
+  int write_count_ = 0;
+};
+
+TEST(CopyStreamTest, ArrayToAliasingOutput) {
+  // Larger than the buffer of the adaptor, so the array is written directly.
+  const std::string source(100000, 'y');
+  ArrayInputStream input(source.data(), source.size());
+  std::string dest;
+  StringCopyingOutputStream copying_output(&dest);
+  {
+    CopyingOutputStreamAdaptor output(&copying_output);
+    EXPECT_TRUE(CopyStream(&input, &output, source.size()));
+    EXPECT_FALSE(CopyStream(&input, &output, 1));
+  }
+  EXPECT_EQ(dest, source);
+  EXPECT_EQ(copying_output.write_count(), 1);
+}
+
+TEST(CopyStreamTest, Limiting) {
+  const std::string source = "0123456789";
+  ArrayInputStream array_input(source.data(), source.size(), 3);
+  LimitingInputStream input(&array_input, 6);
+  std::string dest;
+  {
+    StringOutputStream output(&dest);
+    EXPECT_TRUE(CopyStream(&input, &output, 4));
+    EXPECT_FALSE(CopyStream(&input, &output, 4));
+  }
+  EXPECT_EQ(dest, "012345");
+  EXPECT_EQ(input.ByteCount(), 6);
+}
+
+TEST(CopyStreamTest, ShortInput) {
+  absl::Cord source("foo bar");
+  CordInputStream input(&source);
+  std::string dest;
+  {
+    StringOutputStream output(&dest);
+    EXPECT_FALSE(CopyStream(&input, &output, 100));
+  }
+  EXPECT_EQ(dest, "foo bar");
+}
+
 TEST(CordOutputStreamTest, Empty) {
   CordOutputStream output;
   EXPECT_TRUE(output.Consume().empty());
@@ -1325,6 +1503,24 @@ TEST(CordOutputStreamTest, SizeDoublesWithoutHint) {
   }
 }
 
+TEST(CordOutputStreamTest, ExpectBytesUsesLargeBuffers) {
+  CordOutputStream output;
+  output.ExpectBytes(1 << 20);
+  void* data;
+  int size;
+  int64_t written = 0;
+  int buffers = 0;
+  while (written < (1 << 20)) {
+    ASSERT_TRUE(output.Next(&data, &size));
+    memset(data, 'a', static_cast<size_t>(size));
+    written += size;
+    buffers++;
+  }
+  EXPECT_EQ(written, 1 << 20);
+  EXPECT_LE(buffers, 20);
+  EXPECT_EQ(output.Consume(), std::string(1 << 20, 'a'));
+}
+
 TEST_F(IoTest, WriteSmallCord) {
   absl::Cord source;
   source.Append("foo bar");
@@ -1627,6 +1823,84 @@ TEST_F(IoTest, PipeIo) {
   }
 }
 
+// Copies between files, which may happen within the kernel.
+TEST_F(IoTest, CopyStreamFileToFile) {
+  std::string contents;
+  for (int i = 0; i < 50000; i++) absl::StrAppend(&contents, i, ",");
+  const std::string source_name =
+      absl::StrCat(TestTempDir(), "/zero_copy_stream_copy_source");
+  const std::string dest_name =
+      absl::StrCat(TestTempDir(), "/zero_copy_stream_copy_dest");
+  ABSL_CHECK_OK(File::SetContents(source_name, contents, true));
+
+  int source = open(source_name.c_str(), O_RDONLY | O_BINARY);
+  ASSERT_GE(source, 0);
+  int dest = open(dest_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_BINARY,
+                  0777);
+  ASSERT_GE(dest, 0);
+  {
+    FileInputStream input(source);
+    FileOutputStream output(dest);
+    // Leaves some data in the buffer of the input stream.
+    const void* data;
+    int size;
+    ASSERT_TRUE(input.Next(&data, &size));
+    input.BackUp(size - 3);
+    WriteString(&output, "header");
+
+    ASSERT_TRUE(CopyStream(&input, &output, contents.size() - 10));
+    EXPECT_FALSE(CopyStream(&input, &output, 100));
+    EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(contents.size()));
+    EXPECT_EQ(output.ByteCount(),
+              static_cast<int64_t>(6 + contents.size() - 3));
+    EXPECT_TRUE(output.Flush());
+    EXPECT_EQ(0, input.GetErrno());
+    EXPECT_EQ(0, output.GetErrno());
+  }
+  close(source);
+  close(dest);
+
+  std::string result;
+  ABSL_CHECK_OK(File::GetContents(dest_name, &result, true));
+  EXPECT_EQ(result, absl::StrCat("header", contents.substr(3)));
+}
+
+TEST_F(IoTest, CopyStreamPipeToPipe) {
+  int input_files[2];
+  int output_files[2];
+  ASSERT_EQ(pipe(input_files), 0);
+  ASSERT_EQ(pipe(output_files), 0);
+
+  std::thread writer([&] {
+    FileOutputStream output(input_files[1]);
+    for (int i = 0; i < 1000; i++) WriteString(&output, "0123456789");
+    output.Close();
+  });
+  std::string result;
+  std::thread reader([&] {
+    FileInputStream input(output_files[0]);
+    const void* data;
+    int size;
+    while (input.Next(&data, &size)) {
+      result.append(static_cast<const char*>(data), size);
+    }
+    input.Close();
+  });
+  {
+    FileInputStream input(input_files[0]);
+    FileOutputStream output(output_files[1]);
+    EXPECT_TRUE(CopyStream(&input, &output, 10000));
+    EXPECT_FALSE(CopyStream(&input, &output, 1));
+    EXPECT_EQ(output.ByteCount(), 10000);
+    input.Close();
+    output.Close();
+  }
+  writer.join();
+  reader.join();
+  EXPECT_EQ(result.size(), 10000);
+  EXPECT_EQ(result.substr(9990), "0123456789");
+}
+
 // Test using C++ iostreams.
 TEST_F(IoTest, IostreamIo) {
   for (int i = 0; i < kBlockSizeCount; i++) {
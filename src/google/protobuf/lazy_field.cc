@@ -0,0 +1,197 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/lazy_field.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/message_lite.h"
+#include "google/protobuf/parse_context.h"
+#include "google/protobuf/wire_format_lite.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace internal {
+
+void LazyField::Destroy() {
+  delete raw_;
+  delete message_.load(std::memory_order_relaxed);
+  raw_ = nullptr;
+  message_.store(nullptr, std::memory_order_relaxed);
+  parse_failed_.store(false, std::memory_order_relaxed);
+  dirty_ = false;
+}
+
+std::string* LazyField::MutableRaw(Arena* arena) {
+  if (raw_ == nullptr) raw_ = Arena::Create<std::string>(arena);
+  return raw_;
+}
+
+const MessageLite* LazyField::ParseRaw(const MessageLite& prototype,
+                                       Arena* arena) const {
+  MessageLite* parsed = prototype.New(arena);
+  // Verification already happened (kEager) or is deferred to this point
+  // (kLazy). Either way a failed parse leaves a partially filled message, and
+  // the failure is recorded for ParseFailed(). Record it before publishing
+  // the message so that readers who see the message also see the flag. A
+  // racing thread parses the same bytes and reaches the same verdict.
+  if (!parsed->ParsePartialFromString(*raw_)) {
+    parse_failed_.store(true, std::memory_order_relaxed);
+  }
+
+  MessageLite* expected = nullptr;
+  if (message_.compare_exchange_strong(expected, parsed,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+    return parsed;
+  }
+  // Another thread won the race. Its message is equivalent to ours.
+  if (arena == nullptr) delete parsed;
+  return expected;
+}
+
+const MessageLite& LazyField::Get(const MessageLite& prototype,
+                                  Arena* arena) const {
+  const MessageLite* message = message_.load(std::memory_order_acquire);
+  if (message != nullptr) return *message;
+  if (raw_ == nullptr) return prototype;
+  return *ParseRaw(prototype, arena);
+}
+
+MessageLite* LazyField::Mutable(const MessageLite& prototype, Arena* arena) {
+  MessageLite* message = message_.load(std::memory_order_relaxed);
+  if (message == nullptr) {
+    if (raw_ != nullptr) {
+      ParseRaw(prototype, arena);
+      message = message_.load(std::memory_order_relaxed);
+    } else {
+      message = prototype.New(arena);
+      message_.store(message, std::memory_order_release);
+    }
+  }
+  if (!dirty_) {
+    dirty_ = true;
+    // The bytes are stale from now on. Keep the string for reuse by Clear().
+    if (raw_ != nullptr) raw_->clear();
+  }
+  return message;
+}
+
+void LazyField::Clear() {
+  if (raw_ != nullptr) raw_->clear();
+  if (MessageLite* message = message_.load(std::memory_order_relaxed)) {
+    message->Clear();
+  }
+  // An empty message and an empty payload agree.
+  parse_failed_.store(false, std::memory_order_relaxed);
+  dirty_ = false;
+}
+
+void LazyField::MergeFrom(const MessageLite& prototype, const LazyField& other,
+                          Arena* arena) {
+  if (other.IsEmpty()) return;
+  if (!other.dirty_ && other.raw_ != nullptr && !dirty_ && !IsParsed()) {
+    MutableRaw(arena)->append(*other.raw_);
+    return;
+  }
+  MessageLite* message = Mutable(prototype, arena);
+  bool failed = other.ParseFailed();
+  if (const MessageLite* other_message =
+          other.message_.load(std::memory_order_acquire)) {
+    message->CheckTypeAndMergeFrom(*other_message);
+  } else {
+    // Don't materialize `other`: we don't know which arena it lives on.
+    failed |= !MergeFromImpl<false>(*other.raw_, message,
+                                    MessageLite::kMergePartial);
+  }
+  if (failed) parse_failed_.store(true, std::memory_order_relaxed);
+}
+
+void LazyField::InternalSwap(LazyField* other) {
+  std::swap(raw_, other->raw_);
+  MessageLite* message = message_.load(std::memory_order_relaxed);
+  message_.store(other->message_.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  other->message_.store(message, std::memory_order_relaxed);
+  const bool parse_failed = parse_failed_.load(std::memory_order_relaxed);
+  parse_failed_.store(other->parse_failed_.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+  other->parse_failed_.store(parse_failed, std::memory_order_relaxed);
+  std::swap(dirty_, other->dirty_);
+}
+
+size_t LazyField::ByteSizeLong() const {
+  if (!dirty_) return raw_ == nullptr ? 0 : raw_->size();
+  return message_.load(std::memory_order_relaxed)->ByteSizeLong();
+}
+
+uint8_t* LazyField::InternalWrite(int number, uint8_t* target,
+                                  io::EpsCopyOutputStream* stream) const {
+  if (!dirty_) {
+    if (raw_ == nullptr) {
+      return stream->WriteString(number, absl::string_view(), target);
+    }
+    return stream->WriteString(number, *raw_, target);
+  }
+  const MessageLite* message = message_.load(std::memory_order_relaxed);
+  return WireFormatLite::InternalWriteMessage(
+      number, *message, message->GetCachedSize(), target, stream);
+}
+
+bool LazyField::IsInitialized(const MessageLite& prototype,
+                              Arena* arena) const {
+  if (IsEmpty()) return true;
+  const MessageLite& message = Get(prototype, arena);
+  return !ParseFailed() && message.IsInitialized();
+}
+
+const char* LazyField::_InternalParse(const MessageLite& prototype,
+                                      Arena* arena, Verification verification,
+                                      const char* ptr, ParseContext* ctx) {
+  if (IsParsed()) {
+    // The message exists already, so there is nothing to gain from keeping
+    // the new bytes around: merge them right away.
+    return ctx->ParseMessage(Mutable(prototype, arena), ptr);
+  }
+
+  int size = ReadSize(&ptr);
+  if (ptr == nullptr) return nullptr;
+  std::string* raw = MutableRaw(arena);
+  const size_t old_size = raw->size();
+  ptr = ctx->AppendString(ptr, size, raw);
+  if (ptr == nullptr) return nullptr;
+
+  if (verification == Verification::kEager &&
+      !VerifyWireFormat(absl::string_view(*raw).substr(old_size))) {
+    return nullptr;
+  }
+  return ptr;
+}
+
+bool LazyField::VerifyWireFormat(absl::string_view data) {
+  io::CodedInputStream input(reinterpret_cast<const uint8_t*>(data.data()),
+                             static_cast<int>(data.size()));
+  // SkipMessage() stops at end of input or at an unmatched end-group tag. Only
+  // the former is valid for a length-delimited sub-message.
+  return WireFormatLite::SkipMessage(&input) && input.ConsumedEntireMessage();
+}
+
+}  // namespace internal
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
@@ -0,0 +1,154 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+//
+// This file defines LazyField, the storage behind singular message fields
+// with lazy representation (`kRepLazy` in the table-driven parser).
+
+#ifndef GOOGLE_PROTOBUF_LAZY_FIELD_H__
+#define GOOGLE_PROTOBUF_LAZY_FIELD_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/message_lite.h"
+#include "google/protobuf/port.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace io {
+class EpsCopyOutputStream;
+}  // namespace io
+namespace internal {
+
+class ParseContext;
+
+// LazyField holds a sub-message in its serialized form and only parses it when
+// it is first accessed. A field that is parsed and serialized again without
+// being accessed is copied byte for byte, and a field that was only read
+// through Get() keeps serializing from its original bytes.
+//
+// Concatenating serialized messages merges them, so parsing the same field
+// more than once simply appends to the stored bytes.
+//
+// Verification decides when malformed bytes are reported:
+// - kLazy: bytes are stored as-is and only checked on first access. A failed
+//   parse leaves the message with whatever could be parsed, is reported by
+//   ParseFailed(), and makes IsInitialized() return false.
+// - kEager: the wire structure (tags, lengths, groups) is checked while
+//   parsing the enclosing message, without materializing the sub-message, and
+//   a malformed payload fails the enclosing parse.
+//
+// Like ArenaStringPtr, LazyField doesn't remember its arena: callers pass the
+// arena of the owning message, and call Destroy() only if that is nullptr.
+//
+// Const methods may be called concurrently. Non-const methods require
+// exclusive access.
+class PROTOBUF_EXPORT LazyField {
+ public:
+  enum class Verification { kLazy, kEager };
+
+  constexpr LazyField()
+      : raw_(nullptr), message_(nullptr), parse_failed_(false), dirty_(false) {}
+  LazyField(const LazyField&) = delete;
+  LazyField& operator=(const LazyField&) = delete;
+
+  // Frees owned objects. Only call when the owning message is not on an arena.
+  void Destroy();
+
+  // Returns true if no bytes have been stored and no message was created.
+  bool IsEmpty() const {
+    return raw_ == nullptr &&
+           message_.load(std::memory_order_acquire) == nullptr;
+  }
+
+  // Returns true if the message has been materialized.
+  bool IsParsed() const {
+    return message_.load(std::memory_order_acquire) != nullptr;
+  }
+
+  // Returns the message, parsing the stored bytes on first access. Returns
+  // `prototype` if nothing was stored.
+  const MessageLite& Get(const MessageLite& prototype, Arena* arena) const;
+
+  // Returns true if the stored bytes were found to be malformed when they were
+  // materialized. The message then holds whatever could be parsed. Reset by
+  // Clear().
+  bool ParseFailed() const {
+    return parse_failed_.load(std::memory_order_acquire);
+  }
+
+  // Returns a mutable message, parsing the stored bytes if needed. The stored
+  // bytes are discarded; later serialization goes through the message.
+  MessageLite* Mutable(const MessageLite& prototype, Arena* arena);
+
+  // Clears the field without releasing memory.
+  void Clear();
+
+  // Merges `other` into this field. If neither side was mutated, the bytes are
+  // appended without parsing.
+  void MergeFrom(const MessageLite& prototype, const LazyField& other,
+                 Arena* arena);
+
+  // Swaps with `other`. Both fields must belong to the same arena.
+  void InternalSwap(LazyField* other);
+
+  // Returns the size of the payload, excluding tag and length prefix.
+  size_t ByteSizeLong() const;
+
+  // Writes the field with tag `number`, length prefix and payload. If the
+  // message is serialized, ByteSizeLong() must have been called first so that
+  // cached sizes are up to date.
+  uint8_t* InternalWrite(int number, uint8_t* target,
+                         io::EpsCopyOutputStream* stream) const;
+
+  // Checks required fields. This forces a parse, and returns false if it
+  // failed.
+  bool IsInitialized(const MessageLite& prototype, Arena* arena) const;
+
+  // Parses a length-delimited payload at `ptr` (pointing at the length) and
+  // merges it into the field.
+  PROTOBUF_NODISCARD const char* _InternalParse(const MessageLite& prototype,
+                                                Arena* arena,
+                                                Verification verification,
+                                                const char* ptr,
+                                                ParseContext* ctx);
+
+  // Returns true if `data` is structurally valid wire format.
+  static bool VerifyWireFormat(absl::string_view data);
+
+ private:
+  // Returns the raw bytes, creating the string on `arena` if needed.
+  std::string* MutableRaw(Arena* arena);
+
+  // Parses `raw_` into a new message. The result is published with a CAS so
+  // that concurrent readers all see the same message.
+  const MessageLite* ParseRaw(const MessageLite& prototype, Arena* arena) const;
+
+  // Serialized payload. Stale if `dirty_`.
+  std::string* raw_;
+  // Materialized message, or nullptr.
+  mutable std::atomic<MessageLite*> message_;
+  // Set when materializing `raw_` (or merging unparsed bytes) failed.
+  mutable std::atomic<bool> parse_failed_;
+  // True if `message_` was handed out mutably and `raw_` may be stale.
+  bool dirty_;
+};
+
+}  // namespace internal
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_LAZY_FIELD_H__
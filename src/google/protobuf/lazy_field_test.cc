@@ -0,0 +1,351 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/lazy_field.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/generated_message_tctable_decl.h"
+#include "google/protobuf/generated_message_tctable_impl.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/parse_context.h"
+#include "google/protobuf/unittest.pb.h"
+
+namespace google {
+namespace protobuf {
+namespace internal {
+namespace {
+
+using ::protobuf_unittest::TestAllTypes;
+using NestedMessage = TestAllTypes::NestedMessage;
+
+std::string LengthDelimited(const std::string& payload) {
+  std::string out;
+  {
+    io::StringOutputStream output(&out);
+    io::CodedOutputStream coded(&output);
+    coded.WriteVarint32(static_cast<uint32_t>(payload.size()));
+    coded.WriteString(payload);
+  }
+  return out;
+}
+
+std::string Nested(int32_t bb) {
+  NestedMessage nested;
+  nested.set_bb(bb);
+  return nested.SerializeAsString();
+}
+
+// Parses one length-delimited payload into `field`. Returns false on error.
+bool ParseInto(LazyField& field, const std::string& payload,
+               LazyField::Verification verification, Arena* arena = nullptr) {
+  const std::string input = LengthDelimited(payload);
+  const char* ptr;
+  ParseContext ctx(io::CodedInputStream::GetDefaultRecursionLimit(),
+                   /* aliasing= */ false, &ptr, input);
+  ptr = field._InternalParse(NestedMessage::default_instance(), arena,
+                             verification, ptr, &ctx);
+  return ptr != nullptr && ctx.Done(&ptr);
+}
+
+std::string Write(const LazyField& field, int number) {
+  field.ByteSizeLong();
+  std::string out;
+  {
+    io::StringOutputStream output(&out);
+    uint8_t* ptr;
+    io::EpsCopyOutputStream stream(&output, /* deterministic= */ false, &ptr);
+    ptr = field.InternalWrite(number, ptr, &stream);
+    stream.Trim(ptr);
+  }
+  return out;
+}
+
+TEST(LazyFieldTest, ParsesOnFirstAccess) {
+  LazyField field;
+  ASSERT_TRUE(ParseInto(field, Nested(42), LazyField::Verification::kLazy));
+  EXPECT_FALSE(field.IsParsed());
+  EXPECT_EQ(field.ByteSizeLong(), Nested(42).size());
+
+  const auto& nested = static_cast<const NestedMessage&>(
+      field.Get(NestedMessage::default_instance(), nullptr));
+  EXPECT_TRUE(field.IsParsed());
+  EXPECT_EQ(nested.bb(), 42);
+  field.Destroy();
+}
+
+TEST(LazyFieldTest, UnmodifiedFieldSerializesOriginalBytes) {
+  // The payload sets `bb` twice. Reserializing the parsed message would
+  // collapse that, so identical output shows the bytes were copied through.
+  const std::string payload = Nested(1) + Nested(2);
+  LazyField field;
+  ASSERT_TRUE(ParseInto(field, payload, LazyField::Verification::kLazy));
+
+  TestAllTypes expected;
+  expected.mutable_optional_nested_message()->set_bb(2);
+  EXPECT_EQ(Write(field, 18), std::string("\x92\x01", 2) +
+                                  LengthDelimited(payload));
+
+  field.Get(NestedMessage::default_instance(), nullptr);
+  EXPECT_EQ(Write(field, 18), std::string("\x92\x01", 2) +
+                                  LengthDelimited(payload));
+
+  field.Mutable(NestedMessage::default_instance(), nullptr);
+  EXPECT_EQ(Write(field, 18), expected.SerializeAsString());
+  field.Destroy();
+}
+
+TEST(LazyFieldTest, RepeatedParsesMerge) {
+  Arena arena;
+  LazyField field;
+  ASSERT_TRUE(
+      ParseInto(field, Nested(1), LazyField::Verification::kLazy, &arena));
+  ASSERT_TRUE(
+      ParseInto(field, Nested(7), LazyField::Verification::kLazy, &arena));
+  EXPECT_FALSE(field.IsParsed());
+  EXPECT_EQ(static_cast<const NestedMessage&>(
+                field.Get(NestedMessage::default_instance(), &arena))
+                .bb(),
+            7);
+
+  // Once parsed, further input goes straight into the message.
+  ASSERT_TRUE(
+      ParseInto(field, Nested(9), LazyField::Verification::kLazy, &arena));
+  EXPECT_EQ(static_cast<const NestedMessage&>(
+                field.Get(NestedMessage::default_instance(), &arena))
+                .bb(),
+            9);
+}
+
+TEST(LazyFieldTest, EagerVerificationRejectsMalformedPayload) {
+  // Tag for field 1 (varint) followed by a truncated varint.
+  const std::string truncated("\x08\x80", 2);
+  LazyField lazy;
+  EXPECT_TRUE(ParseInto(lazy, truncated, LazyField::Verification::kLazy));
+  lazy.Destroy();
+
+  LazyField eager;
+  EXPECT_FALSE(ParseInto(eager, truncated, LazyField::Verification::kEager));
+  eager.Destroy();
+
+  LazyField valid;
+  EXPECT_TRUE(ParseInto(valid, Nested(3), LazyField::Verification::kEager));
+  valid.Destroy();
+}
+
+TEST(LazyFieldTest, LazyVerificationReportsErrorOnAccess) {
+  // Field 1 (bb) = 6, then a tag for field 2 (varint) with a truncated value.
+  const std::string malformed = Nested(6) + std::string("\x10\x80", 2);
+  LazyField field;
+  ASSERT_TRUE(ParseInto(field, malformed, LazyField::Verification::kLazy));
+  EXPECT_FALSE(field.ParseFailed());
+
+  const auto& message = static_cast<const NestedMessage&>(
+      field.Get(NestedMessage::default_instance(), nullptr));
+  EXPECT_TRUE(field.ParseFailed());
+  EXPECT_EQ(message.bb(), 6);
+  EXPECT_FALSE(field.IsInitialized(NestedMessage::default_instance(), nullptr));
+
+  LazyField merged;
+  LazyField unparsed;
+  ASSERT_TRUE(ParseInto(unparsed, malformed, LazyField::Verification::kLazy));
+  merged.Mutable(NestedMessage::default_instance(), nullptr);
+  merged.MergeFrom(NestedMessage::default_instance(), unparsed, nullptr);
+  EXPECT_TRUE(merged.ParseFailed());
+
+  field.Clear();
+  EXPECT_FALSE(field.ParseFailed());
+  EXPECT_TRUE(field.IsInitialized(NestedMessage::default_instance(), nullptr));
+  field.Destroy();
+  merged.Destroy();
+  unparsed.Destroy();
+}
+
+TEST(LazyFieldTest, VerifyWireFormat) {
+  EXPECT_TRUE(LazyField::VerifyWireFormat(""));
+  EXPECT_TRUE(LazyField::VerifyWireFormat(Nested(5)));
+  // Unmatched end-group tag.
+  EXPECT_FALSE(LazyField::VerifyWireFormat("\x0c"));
+  // Length exceeds the payload.
+  EXPECT_FALSE(LazyField::VerifyWireFormat("\x0a\x05" "ab"));
+  // Field number zero.
+  EXPECT_FALSE(LazyField::VerifyWireFormat(std::string("\x00\x01", 2)));
+}
+
+TEST(LazyFieldTest, MergeFromAppendsBytes) {
+  LazyField a;
+  LazyField b;
+  ASSERT_TRUE(ParseInto(a, Nested(1), LazyField::Verification::kLazy));
+  ASSERT_TRUE(ParseInto(b, Nested(2), LazyField::Verification::kLazy));
+  a.MergeFrom(NestedMessage::default_instance(), b, nullptr);
+  EXPECT_FALSE(a.IsParsed());
+  EXPECT_FALSE(b.IsParsed());
+  EXPECT_EQ(a.ByteSizeLong(), Nested(1).size() + Nested(2).size());
+  EXPECT_EQ(static_cast<const NestedMessage&>(
+                a.Get(NestedMessage::default_instance(), nullptr))
+                .bb(),
+            2);
+  a.Destroy();
+  b.Destroy();
+}
+
+TEST(LazyFieldTest, ClearAndEmpty) {
+  LazyField field;
+  EXPECT_TRUE(field.IsEmpty());
+  EXPECT_EQ(&field.Get(NestedMessage::default_instance(), nullptr),
+            &NestedMessage::default_instance());
+  ASSERT_TRUE(ParseInto(field, Nested(4), LazyField::Verification::kLazy));
+  EXPECT_FALSE(field.IsEmpty());
+  field.Clear();
+  EXPECT_EQ(field.ByteSizeLong(), 0);
+  field.Destroy();
+}
+
+// Parses a message with two lazy NestedMessage fields through a table laid
+// out by hand, the way codegen would for [lazy=true] fields: field 1 is eagerly
+// verified and has a fast entry, field 2 is lazily verified and is parsed
+// through its field entry.
+class LazyFieldTableTest : public testing::Test {
+ protected:
+  // The message header (vtable and metadata) stays zero, so it has no arena.
+  static constexpr uint16_t kHasBitsOffset = 16;
+  static constexpr uint32_t kEagerOffset = 24;
+  static constexpr uint32_t kLazyOffset = kEagerOffset + sizeof(LazyField);
+
+  LazyFieldTableTest() {
+    memset(msg_, 0, sizeof(msg_));
+    new (msg_ + kEagerOffset) LazyField;
+    new (msg_ + kLazyOffset) LazyField;
+  }
+  ~LazyFieldTableTest() override {
+    eager().Destroy();
+    lazy().Destroy();
+  }
+
+  // Returns false on errors, which include unknown fields.
+  bool Parse(absl::string_view input) {
+    const char* ptr;
+    ParseContext ctx(io::CodedInputStream::GetDefaultRecursionLimit(),
+                     /* aliasing= */ false, &ptr, input);
+    ptr = TcParser::ParseLoop(reinterpret_cast<MessageLite*>(msg_), ptr, &ctx,
+                              &GetTable().header);
+    return ptr != nullptr && ctx.EndedAtLimit();
+  }
+
+  uint32_t hasbits() const {
+    uint32_t result;
+    memcpy(&result, msg_ + kHasBitsOffset, sizeof(result));
+    return result;
+  }
+  LazyField& eager() {
+    return *reinterpret_cast<LazyField*>(msg_ + kEagerOffset);
+  }
+  LazyField& lazy() {
+    return *reinterpret_cast<LazyField*>(msg_ + kLazyOffset);
+  }
+
+ private:
+  static const char* Fail(MessageLite*, const char*, ParseContext*,
+                          TcFieldData, const TcParseTableBase*, uint64_t) {
+    return nullptr;
+  }
+
+  using Table = TcParseTable<1, 2, 2, 0, 2>;
+
+  static const Table& GetTable() {
+    static const auto* const table = new Table{
+        {
+            kHasBitsOffset,
+            0,     // no _extensions_
+            2, 8,  // max_field_number, fast_idx_mask
+            offsetof(Table, field_lookup_table),
+            0xFFFFFFFF - 3,  // skipmap
+            offsetof(Table, field_entries),
+            2,  // num_field_entries
+            2,  // num_aux_entries
+            offsetof(Table, aux_entries),
+            nullptr,  // default instance
+            Fail,     // fallback
+        },
+        {{
+            // Field 2 (tag 0x12) has no fast entry.
+            {TcParser::MiniParse, {}},
+            // Field 1 (tag 0x0a).
+            {TcParser::FastMlS1,
+             {/* coded_tag= */ 10, /* hasbit_idx= */ 0, /* aux_idx= */ 0,
+              kEagerOffset}},
+        }},
+        {{65535, 65535}},
+        {{
+            {kEagerOffset, kHasBitsOffset * 8 + 0, 0,
+             field_layout::kFkMessage | field_layout::kRepLazy |
+                 field_layout::kFcOptional | field_layout::kTvEager},
+            {kLazyOffset, kHasBitsOffset * 8 + 1, 1,
+             field_layout::kFkMessage | field_layout::kRepLazy |
+                 field_layout::kFcOptional | field_layout::kTvLazy},
+        }},
+        {{
+            &NestedMessage::default_instance(),
+            &NestedMessage::default_instance(),
+        }},
+        {{}},
+    };
+    return *table;
+  }
+
+  alignas(LazyField) char msg_[kLazyOffset + sizeof(LazyField)];
+};
+
+const NestedMessage& Get(const LazyField& field) {
+  return static_cast<const NestedMessage&>(
+      field.Get(NestedMessage::default_instance(), nullptr));
+}
+
+TEST_F(LazyFieldTableTest, ParsesLazyFields) {
+  const std::string input = "\x0a" + LengthDelimited(Nested(1)) + "\x12" +
+                            LengthDelimited(Nested(2)) + "\x0a" +
+                            LengthDelimited(Nested(3));
+  ASSERT_TRUE(Parse(input));
+  EXPECT_EQ(hasbits(), 3);
+  EXPECT_FALSE(eager().IsParsed());
+  EXPECT_FALSE(lazy().IsParsed());
+  // Occurrences of a field merge, so the last value wins.
+  EXPECT_EQ(Get(eager()).bb(), 3);
+  EXPECT_EQ(Get(lazy()).bb(), 2);
+  EXPECT_EQ(Write(eager(), 1), "\x0a" + LengthDelimited(Nested(1) + Nested(3)));
+}
+
+TEST_F(LazyFieldTableTest, EagerFieldFailsParse) {
+  // Tag for field 1 (varint) followed by a truncated varint.
+  const std::string truncated("\x08\x80", 2);
+  EXPECT_FALSE(Parse("\x0a" + LengthDelimited(truncated)));
+}
+
+TEST_F(LazyFieldTableTest, LazyFieldReportsErrorOnAccess) {
+  // Field 1 (bb) = 6, then a tag for field 2 (varint) with a truncated value.
+  const std::string malformed = Nested(6) + std::string("\x10\x80", 2);
+  ASSERT_TRUE(Parse("\x12" + LengthDelimited(malformed)));
+  EXPECT_EQ(hasbits(), 2);
+  EXPECT_FALSE(lazy().ParseFailed());
+  EXPECT_EQ(Get(lazy()).bb(), 6);
+  EXPECT_TRUE(lazy().ParseFailed());
+  EXPECT_FALSE(
+      lazy().IsInitialized(NestedMessage::default_instance(), nullptr));
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace protobuf
+}  // namespace google
@@ -27,6 +27,22 @@ namespace internal {
 
 const TableEntryPtr kGlobalEmptyTable[kGlobalEmptyTableSize] = {};
 
+void UntypedMapBase::CreateSmallTable(size_t node_size) {
+  ABSL_DCHECK_EQ(num_buckets_, kGlobalEmptyTableSize);
+  ABSL_DCHECK(small_table_ == nullptr);
+  const size_t alloc_size = SmallTableAllocSize(node_size);
+  TableEntryPtr* result = AllocFor<TableEntryPtr>(alloc_).allocate(alloc_size);
+  // The nodes are left uninitialized.
+  memset(result, 0, (1 + kMinTableSize) * sizeof(result[0]));
+  small_table_ = table_ = result + 1;
+  num_buckets_ = index_of_first_non_null_ = kMinTableSize;
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+  memset(ctrl(), kMapCtrlEmpty, kMinTableSize);
+  num_deleted_ = 0;
+#endif
+  seed_ = Seed();
+}
+
 NodeBase* UntypedMapBase::DestroyTree(Tree* tree) {
   NodeBase* head = tree->empty() ? nullptr : tree->begin()->second;
   if (alloc_.arena() == nullptr) {
@@ -132,7 +148,9 @@ void UntypedMapBase::ClearTable(const ClearInput input) {
         while (node != nullptr) {
           NodeBase* next = node->next;
           destroy_node(node);
-          SizedDelete(node, SizeFromInfo(input.size_info));
+          if (!IsInSmallTable(node, SizeFromInfo(input.size_info))) {
+            SizedDelete(node, SizeFromInfo(input.size_info));
+          }
           node = next;
         }
       }
@@ -176,14 +194,24 @@ void UntypedMapBase::ClearTable(const ClearInput input) {
         loop(input.destroy_node);
         break;
     }
+    if (small_table_ != nullptr) SetSmallNodesInUse(0);
   }
 
+  // On an arena, the nodes of the small table stay in use: their keys and
+  // values may have registered destructors with the arena.
   if (input.reset_table) {
     std::fill(table_, table_ + num_buckets_, TableEntryPtr{});
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    memset(ctrl(), kMapCtrlEmpty, num_buckets_);
+    num_deleted_ = 0;
+#endif
     num_elements_ = 0;
     index_of_first_non_null_ = num_buckets_;
   } else {
-    DeleteTable(table_, num_buckets_);
+    if (!IsSmallTable()) DeleteTable(table_, num_buckets_);
+    if (small_table_ != nullptr) {
+      DeleteSmallTable(SizeFromInfo(input.size_info));
+    }
   }
 }
 
@@ -201,9 +229,18 @@ auto UntypedMapBase::FindFromTree(map_index_t b, VariantKey key,
 size_t UntypedMapBase::SpaceUsedInTable(size_t sizeof_node) const {
   size_t size = 0;
   // The size of the table.
-  size += sizeof(void*) * num_buckets_;
-  // All the nodes.
-  size += sizeof_node * num_elements_;
+  if (!IsSmallTable()) {
+    size += sizeof(TableEntryPtr) * TableAllocSize(num_buckets_);
+  }
+  // The small table and the nodes it holds, and all the other nodes.
+  if (small_table_ != nullptr) {
+    size += sizeof(TableEntryPtr) * SmallTableAllocSize(sizeof_node);
+    for (UntypedMapIterator it(this); it.node_ != nullptr; it.PlusPlus()) {
+      if (!IsInSmallTable(it.node_, sizeof_node)) size += sizeof_node;
+    }
+  } else {
+    size += sizeof_node * num_elements_;
+  }
   // For each tree, count the overhead of those nodes.
   // Two buckets at a time because we only care about trees.
   for (map_index_t b = 0; b < num_buckets_; ++b) {
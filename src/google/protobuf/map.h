@@ -28,11 +28,16 @@
 #include <mach/mach_time.h>
 #endif
 
+#if defined(GOOGLE_PROTOBUF_MAP_FLAT_TABLE) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "google/protobuf/stubs/common.h"
 #include "absl/base/attributes.h"
 #include "absl/container/btree_map.h"
 #include "absl/hash/hash.h"
 #include "absl/meta/type_traits.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/string_view.h"
 #include "google/protobuf/arena.h"
 #include "google/protobuf/generated_enum_util.h"
@@ -426,6 +431,50 @@ inline TableEntryPtr TreeToTableEntry(TreeForMap* node) {
   return static_cast<TableEntryPtr>(reinterpret_cast<uintptr_t>(node) | 1);
 }
 
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+// When built with GOOGLE_PROTOBUF_MAP_FLAT_TABLE, the table is open addressed,
+// like absl::node_hash_map, instead of chained.  Every entry holds at most one
+// node, and a control byte per entry says whether it is empty, deleted, or
+// full.  A full entry has 7 bits of the hash in its control byte, so a lookup
+// compares a whole group of entries at once and only looks at the nodes whose
+// bits match.  The control bytes follow the entries in the same allocation.
+using MapCtrl = int8_t;
+constexpr MapCtrl kMapCtrlEmpty = -128;
+constexpr MapCtrl kMapCtrlDeleted = -2;
+constexpr uint32_t kMapGroupWidth = 16;
+
+// Bit i of the result is set if `group[i] == ctrl`.
+inline uint32_t MapGroupMatch(const MapCtrl* group, MapCtrl ctrl) {
+#if defined(__SSE2__)
+  const __m128i bytes =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+  return static_cast<uint32_t>(
+      _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(ctrl), bytes)));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kMapGroupWidth; ++i) {
+    mask |= uint32_t{group[i] == ctrl} << i;
+  }
+  return mask;
+#endif
+}
+
+// Bit i of the result is set if `group[i]` is empty or deleted.  Both are
+// negative, while full entries are not.
+inline uint32_t MapGroupMatchFree(const MapCtrl* group) {
+#if defined(__SSE2__)
+  return static_cast<uint32_t>(_mm_movemask_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < kMapGroupWidth; ++i) {
+    mask |= uint32_t{group[i] < 0} << i;
+  }
+  return mask;
+#endif
+}
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+
 // This captures all numeric types.
 inline size_t MapValueSpaceUsedExcludingSelfLong(bool) { return 0; }
 inline size_t MapValueSpaceUsedExcludingSelfLong(const std::string& str) {
@@ -530,13 +579,20 @@ class PROTOBUF_EXPORT UntypedMapBase {
         seed_(0),
         index_of_first_non_null_(internal::kGlobalEmptyTableSize),
         table_(const_cast<TableEntryPtr*>(internal::kGlobalEmptyTable)),
-        alloc_(arena) {}
+        alloc_(arena),
+        small_table_(nullptr),
+        min_num_buckets_(kMinTableSize) {}
 
   UntypedMapBase(const UntypedMapBase&) = delete;
   UntypedMapBase& operator=(const UntypedMapBase&) = delete;
 
  protected:
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+  // The flat table is probed one group at a time.
+  enum { kMinTableSize = kMapGroupWidth };
+#else
   enum { kMinTableSize = 8 };
+#endif
 
  public:
   Arena* arena() const { return this->alloc_.arena(); }
@@ -548,6 +604,11 @@ class PROTOBUF_EXPORT UntypedMapBase {
     std::swap(index_of_first_non_null_, other->index_of_first_non_null_);
     std::swap(table_, other->table_);
     std::swap(alloc_, other->alloc_);
+    std::swap(small_table_, other->small_table_);
+    std::swap(min_num_buckets_, other->min_num_buckets_);
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    std::swap(num_deleted_, other->num_deleted_);
+#endif
   }
 
   static size_type max_size() {
@@ -634,22 +695,116 @@ class PROTOBUF_EXPORT UntypedMapBase {
     return AllocNode(SizeFromInfo(size_info));
   }
 
+  // The first node of a map sets up its small table, as this is where the
+  // size of the nodes is known.  Nodes come from the small table while it has
+  // free ones.
   NodeBase* AllocNode(size_t node_size) {
     PROTOBUF_ASSUME(node_size % sizeof(NodeBase) == 0);
+    if (PROTOBUF_PREDICT_FALSE(num_buckets_ == kGlobalEmptyTableSize)) {
+      CreateSmallTable(node_size);
+    }
+    if (small_table_ != nullptr) {
+      const uintptr_t in_use = SmallNodesInUse();
+      const map_index_t n = SmallTableNodes(node_size);
+      if (in_use != (uintptr_t{1} << n) - 1) {
+        const int i = absl::countr_zero(~in_use);
+        SetSmallNodesInUse(in_use | (uintptr_t{1} << i));
+        return SmallTableNode(i, node_size);
+      }
+    }
     return AllocFor<NodeBase>(alloc_).allocate(node_size / sizeof(NodeBase));
   }
 
+  // Allocates `n` nodes next to each other.  They can only be freed along
+  // with the arena, so the map must be on one.
+  NodeBase* AllocNodesOnArena(size_t n, MapNodeSizeInfoT size_info) {
+    ABSL_DCHECK(arena() != nullptr);
+    return AllocFor<NodeBase>(alloc_).allocate(n * SizeFromInfo(size_info) /
+                                               sizeof(NodeBase));
+  }
+
   void DeallocNode(NodeBase* node, MapNodeSizeInfoT size_info) {
     DeallocNode(node, SizeFromInfo(size_info));
   }
 
   void DeallocNode(NodeBase* node, size_t node_size) {
     PROTOBUF_ASSUME(node_size % sizeof(NodeBase) == 0);
+    if (IsInSmallTable(node, node_size)) {
+      const size_t i =
+          (reinterpret_cast<uintptr_t>(node) -
+           reinterpret_cast<uintptr_t>(SmallTableNode(0, node_size))) /
+          node_size;
+      SetSmallNodesInUse(SmallNodesInUse() & ~(uintptr_t{1} << i));
+      return;
+    }
     AllocFor<NodeBase>(alloc_).deallocate(node, node_size / sizeof(NodeBase));
   }
 
+  // Number of TableEntryPtr to allocate for a table with `n` entries.
+  static size_t TableAllocSize(map_index_t n) {
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    // Room for the control bytes after the entries.  `n` is a multiple of
+    // kMapGroupWidth, so this is exact.
+    return n + n / sizeof(TableEntryPtr);
+#else
+    return n;
+#endif
+  }
+
   void DeleteTable(TableEntryPtr* table, map_index_t n) {
-    AllocFor<TableEntryPtr>(alloc_).deallocate(table, n);
+    AllocFor<TableEntryPtr>(alloc_).deallocate(table, TableAllocSize(n));
+  }
+
+  // The first table of a map, which it has while it is small, also holds the
+  // nodes of its first elements.  A map of a few elements thus needs a single
+  // allocation, and its nodes are next to each other.  The allocation is laid
+  // out as
+  //   - a bitmap of the nodes in use, at small_table_[-1],
+  //   - the table of kMinTableSize entries, at small_table_,
+  //   - SmallTableNodes() nodes.
+  // When the map outgrows the table, its elements move to a larger one, but
+  // their nodes cannot move.  The small table then stays around for its
+  // nodes, which are reused when free, until the map is destroyed.
+  static constexpr size_t kSmallTableMaxNodeBytes = 128;
+  static constexpr map_index_t SmallTableNodes(size_t node_size) {
+    return node_size * 8 <= kSmallTableMaxNodeBytes ? 8
+           : node_size <= kSmallTableMaxNodeBytes
+               ? static_cast<map_index_t>(kSmallTableMaxNodeBytes / node_size)
+               : 1;
+  }
+
+  // Number of TableEntryPtr to allocate for a small table.
+  static size_t SmallTableAllocSize(size_t node_size) {
+    return 1 + TableAllocSize(kMinTableSize) +
+           SmallTableNodes(node_size) * (node_size / sizeof(TableEntryPtr));
+  }
+
+  bool IsSmallTable() const { return table_ == small_table_; }
+
+  uintptr_t SmallNodesInUse() const {
+    return static_cast<uintptr_t>(small_table_[-1]);
+  }
+  void SetSmallNodesInUse(uintptr_t in_use) {
+    small_table_[-1] = static_cast<TableEntryPtr>(in_use);
+  }
+
+  NodeBase* SmallTableNode(size_t i, size_t node_size) const {
+    return reinterpret_cast<NodeBase*>(
+        reinterpret_cast<char*>(small_table_ + TableAllocSize(kMinTableSize)) +
+        i * node_size);
+  }
+
+  bool IsInSmallTable(const NodeBase* node, size_t node_size) const {
+    return small_table_ != nullptr &&
+           reinterpret_cast<uintptr_t>(node) -
+                   reinterpret_cast<uintptr_t>(SmallTableNode(0, node_size)) <
+               SmallTableNodes(node_size) * node_size;
+  }
+
+  void CreateSmallTable(size_t node_size);
+  void DeleteSmallTable(size_t node_size) {
+    AllocFor<TableEntryPtr>(alloc_).deallocate(small_table_ - 1,
+                                               SmallTableAllocSize(node_size));
   }
 
   NodeBase* DestroyTree(Tree* tree);
@@ -661,7 +816,7 @@ class PROTOBUF_EXPORT UntypedMapBase {
 
   map_index_t VariantBucketNumber(VariantKey key) const;
 
-  map_index_t BucketNumberFromHash(uint64_t h) const {
+  uint64_t MixHash(uint64_t h) const {
     // We xor the hash value against the random seed so that we effectively
     // have a random hash function.
     h ^= seed_;
@@ -670,17 +825,82 @@ class PROTOBUF_EXPORT UntypedMapBase {
     // the hash value. The constant kPhi (suggested by Knuth) is roughly
     // (sqrt(5) - 1) / 2 * 2^64.
     constexpr uint64_t kPhi = uint64_t{0x9e3779b97f4a7c15};
-    return (MultiplyWithOverflow(kPhi, h) >> 32) & (num_buckets_ - 1);
+    return MultiplyWithOverflow(kPhi, h);
+  }
+
+  map_index_t BucketNumberFromHash(uint64_t h) const {
+    return (MixHash(h) >> 32) & (num_buckets_ - 1);
   }
 
   TableEntryPtr* CreateEmptyTable(map_index_t n) {
     ABSL_DCHECK_GE(n, map_index_t{kMinTableSize});
     ABSL_DCHECK_EQ(n & (n - 1), 0u);
-    TableEntryPtr* result = AllocFor<TableEntryPtr>(alloc_).allocate(n);
-    memset(result, 0, n * sizeof(result[0]));
+    const size_t alloc_size = TableAllocSize(n);
+    TableEntryPtr* result =
+        AllocFor<TableEntryPtr>(alloc_).allocate(alloc_size);
+    memset(result, 0, alloc_size * sizeof(result[0]));
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    memset(result + n, kMapCtrlEmpty, n);
+#endif
     return result;
   }
 
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+  MapCtrl* ctrl() const {
+    return reinterpret_cast<MapCtrl*>(table_ + num_buckets_);
+  }
+
+  // The control byte of a full entry: 7 bits of the hash that do not overlap
+  // with the ones BucketNumberFromHash() uses.
+  MapCtrl CtrlFromHash(uint64_t h) const {
+    return static_cast<MapCtrl>((MixHash(h) >> 25) & 0x7f);
+  }
+
+  // Probing visits the groups of the table in a triangular sequence, which
+  // reaches all of them because their number is a power of two.  It starts
+  // from the group of the entry BucketNumberFromHash() returns.
+  map_index_t FirstGroup(uint64_t h) const {
+    return BucketNumberFromHash(h) & ~(kMapGroupWidth - 1);
+  }
+  map_index_t NextGroup(map_index_t group, map_index_t* step) const {
+    *step += kMapGroupWidth;
+    return (group + *step) & (num_buckets_ - 1);
+  }
+
+  // Returns the entry of group `g` to use for hash `h`, given the mask of the
+  // free entries of the group.  It is the first one at or after the position
+  // of BucketNumberFromHash(h) in the group, wrapping around, so that the
+  // order of iteration is as random as the hash.
+  map_index_t PickFreeEntry(map_index_t g, uint32_t free, uint64_t h) const {
+    const uint32_t offset = BucketNumberFromHash(h) & (kMapGroupWidth - 1);
+    const uint32_t rotated =
+        (free >> offset) | (free << (kMapGroupWidth - offset));
+    return g + ((offset + absl::countr_zero(rotated)) & (kMapGroupWidth - 1));
+  }
+
+  // Returns an empty or deleted entry in the first group of the probe sequence
+  // of `h` that has one.
+  map_index_t FindFreeEntry(uint64_t h) const {
+    map_index_t step = 0;
+    for (map_index_t g = FirstGroup(h);; g = NextGroup(g, &step)) {
+      const uint32_t free = MapGroupMatchFree(ctrl() + g);
+      if (free != 0) return PickFreeEntry(g, free, h);
+    }
+  }
+
+  // Puts `node` in entry `b`, which must be empty or deleted.
+  void SetFlatEntry(map_index_t b, NodeBase* node, uint64_t h) {
+    ABSL_DCHECK(TableEntryIsEmpty(b));
+    MapCtrl& c = ctrl()[b];
+    ABSL_DCHECK_LT(c, 0);
+    if (c == kMapCtrlDeleted) --num_deleted_;
+    c = CtrlFromHash(h);
+    node->next = nullptr;
+    table_[b] = NodeToTableEntry(node);
+    index_of_first_non_null_ = (std::min)(index_of_first_non_null_, b);
+  }
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+
   // Return a randomish value.
   map_index_t Seed() const {
     // We get a little bit of randomness from the address of the map. The
@@ -771,6 +991,16 @@ class PROTOBUF_EXPORT UntypedMapBase {
   map_index_t index_of_first_non_null_;
   TableEntryPtr* table_;  // an array with num_buckets_ entries
   Allocator alloc_;
+  // The entries of the small table, which is table_ until the map outgrows
+  // it.  Null if the map never had one.
+  TableEntryPtr* small_table_;
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+  // Deleted entries in the flat table.  They do not end a probe, so they
+  // count towards the load.
+  map_index_t num_deleted_ = 0;
+#endif
+  // The table does not shrink below this size, which Reserve() sets.
+  map_index_t min_num_buckets_;
 };
 
 inline UntypedMapIterator::UntypedMapIterator(const UntypedMapBase* m) : m_(m) {
@@ -872,6 +1102,18 @@ struct KeyNode : NodeBase {
 // 6. Except for erase(iterator), any non-const method can reorder iterators.
 // 7. Uses VariantKey when using the Tree representation, which holds all
 //    possible key types as a variant value.
+//
+// With GOOGLE_PROTOBUF_MAP_FLAT_TABLE the table is open addressed instead, as
+// described next to MapCtrl, and there are no lists or trees: every non-empty
+// entry is a single node with a null `next`.  Nodes are still allocated one by
+// one, so 2., 5. and 6. hold all the same, and iteration, the table-driven
+// parser and reflection work on both layouts.  Lookups touch fewer cache lines
+// and the table has a higher load factor, but there is no O(lg n) bound for
+// keys with colliding hashes.  It changes the layout of Map, so everything
+// linked together must agree on it.
+//
+// Either way, the nodes of the first few elements of a map are allocated along
+// with its first table.  See SmallTableNodes().
 
 template <typename Key>
 class KeyMapBase : public UntypedMapBase {
@@ -904,6 +1146,64 @@ class KeyMapBase : public UntypedMapBase {
   friend struct MapTestPeer;
   friend struct MapBenchmarkPeer;
 
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+  PROTOBUF_NOINLINE void erase_no_destroy(map_index_t b, KeyNode* node) {
+    // `b` may be stale if the table was rehashed since it was found.
+    b &= (num_buckets_ - 1);
+    if (table_[b] != NodeToTableEntry(node)) {
+      b = FindHelper(node->key()).bucket;
+    }
+    ABSL_DCHECK(table_[b] == NodeToTableEntry(node));
+    table_[b] = TableEntryPtr{};
+    // A group with an empty entry never was full, so no probe went past it
+    // and the entry can be empty again.  Otherwise probes for other keys may
+    // go through it, and it has to stay deleted until the next rehash.
+    if (MapGroupMatch(ctrl() + (b & ~(kMapGroupWidth - 1)), kMapCtrlEmpty) !=
+        0) {
+      ctrl()[b] = kMapCtrlEmpty;
+    } else {
+      ctrl()[b] = kMapCtrlDeleted;
+      ++num_deleted_;
+    }
+    --num_elements_;
+    if (PROTOBUF_PREDICT_FALSE(b == index_of_first_non_null_)) {
+      while (index_of_first_non_null_ < num_buckets_ &&
+             TableEntryIsEmpty(index_of_first_non_null_)) {
+        ++index_of_first_non_null_;
+      }
+    }
+  }
+
+  // If the key is missing, the returned bucket is the entry where to insert
+  // it, in the first group of its probe sequence with an empty or deleted
+  // entry.
+  NodeAndBucket FindHelper(typename TS::ViewType k,
+                           TreeIterator* = nullptr) const {
+    if (PROTOBUF_PREDICT_FALSE(num_buckets_ == kGlobalEmptyTableSize)) {
+      return {nullptr, 0};
+    }
+    const uint64_t h = hash_function()(k);
+    const MapCtrl c = CtrlFromHash(h);
+    map_index_t free = num_buckets_;
+    map_index_t step = 0;
+    for (map_index_t g = FirstGroup(h);; g = NextGroup(g, &step)) {
+      const MapCtrl* group = ctrl() + g;
+      for (uint32_t match = MapGroupMatch(group, c); match != 0;
+           match &= match - 1) {
+        const map_index_t b = g + absl::countr_zero(match);
+        auto* node = internal::TableEntryToNode(table_[b]);
+        if (TS::Equals(static_cast<KeyNode*>(node)->key(), k)) {
+          return {node, b};
+        }
+      }
+      if (free == num_buckets_) {
+        const uint32_t free_mask = MapGroupMatchFree(group);
+        if (free_mask != 0) free = PickFreeEntry(g, free_mask, h);
+      }
+      if (MapGroupMatch(group, kMapCtrlEmpty) != 0) return {nullptr, free};
+    }
+  }
+#else
   PROTOBUF_NOINLINE void erase_no_destroy(map_index_t b, KeyNode* node) {
     TreeIterator tree_it;
     const bool is_list = revalidate_if_necessary(b, node, &tree_it);
@@ -941,6 +1241,7 @@ class KeyMapBase : public UntypedMapBase {
     }
     return {nullptr, b};
   }
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
 
   // Insert the given node.
   // If the key is a duplicate, it inserts the new node and returns the old one.
@@ -961,6 +1262,15 @@ class KeyMapBase : public UntypedMapBase {
     return to_erase;
   }
 
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+  // Insert the given Node in entry b, which must be empty or deleted and in
+  // the probe sequence of the key before any empty entry, as the one that
+  // FindHelper() returned for it.  num_elements_ is not modified.
+  void InsertUnique(map_index_t b, KeyNode* node) {
+    ABSL_DCHECK(FindHelper(node->key()).node == nullptr);
+    SetFlatEntry(b, node, hash_function()(node->key()));
+  }
+#else
   // Insert the given Node in bucket b.  If that would make bucket b too big,
   // and bucket b is not a tree, create a tree for buckets b.
   // Requires count(*KeyPtrFromNodePtr(node)) == 0 and that b is the correct
@@ -982,6 +1292,7 @@ class KeyMapBase : public UntypedMapBase {
       InsertUniqueInTree(b, NodeToVariantKey, node);
     }
   }
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
 
   static VariantKey NodeToVariantKey(NodeBase* node) {
     return internal::RealKeyToVariantKey<Key>{}(
@@ -997,19 +1308,28 @@ class KeyMapBase : public UntypedMapBase {
   // policy that sometimes we resize down as well as up, clients can easily
   // keep O(size()) = O(number of buckets) if they want that.
   bool ResizeIfLoadIsOutOfRange(size_type new_size) {
-    const size_type kMaxMapLoadTimes16 = 12;  // controls RAM vs CPU tradeoff
-    const size_type hi_cutoff = num_buckets_ * kMaxMapLoadTimes16 / 16;
+    const size_type hi_cutoff = HiCutoff(num_buckets_);
     const size_type lo_cutoff = hi_cutoff / 4;
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    if (PROTOBUF_PREDICT_FALSE(new_size + num_deleted_ > hi_cutoff)) {
+      // If deleted entries make most of the load, rehashing in place frees
+      // them.  Only doing it below half of the cutoff keeps its cost amortized.
+      if (new_size <= hi_cutoff / 2) {
+        Resize(num_buckets_);
+        return true;
+      }
+#else
     // We don't care how many elements are in trees.  If a lot are,
     // we may resize even though there are many empty buckets.  In
     // practice, this seems fine.
     if (PROTOBUF_PREDICT_FALSE(new_size >= hi_cutoff)) {
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
       if (num_buckets_ <= max_size() / 2) {
         Resize(num_buckets_ * 2);
         return true;
       }
     } else if (PROTOBUF_PREDICT_FALSE(new_size <= lo_cutoff &&
-                                      num_buckets_ > kMinTableSize)) {
+                                      num_buckets_ > min_num_buckets_)) {
       size_type lg2_of_size_reduction_factor = 1;
       // It's possible we want to shrink a lot here... size() could even be 0.
       // So, estimate how much to shrink by making sure we don't shrink so
@@ -1019,7 +1339,7 @@ class KeyMapBase : public UntypedMapBase {
         ++lg2_of_size_reduction_factor;
       }
       size_type new_num_buckets = std::max<size_type>(
-          kMinTableSize, num_buckets_ >> lg2_of_size_reduction_factor);
+          min_num_buckets_, num_buckets_ >> lg2_of_size_reduction_factor);
       if (new_num_buckets != num_buckets_) {
         Resize(new_num_buckets);
         return true;
@@ -1028,12 +1348,64 @@ class KeyMapBase : public UntypedMapBase {
     return false;
   }
 
+  // The number of elements past which a table of `num_buckets` entries grows.
+  static size_type HiCutoff(map_index_t num_buckets) {
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    // Probes end at an empty entry, so the table must never be full.
+    return size_type{num_buckets} * 7 / 8;
+#else
+    const size_type kMaxMapLoadTimes16 = 12;  // controls RAM vs CPU tradeoff
+    return size_type{num_buckets} * kMaxMapLoadTimes16 / 16;
+#endif
+  }
+
+  // The number of buckets that holds `n` elements without growing.
+  static map_index_t NumBucketsFor(size_type n) {
+    map_index_t num_buckets = kMinTableSize;
+    // The same conditions as in ResizeIfLoadIsOutOfRange().
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    while (n > HiCutoff(num_buckets) && num_buckets <= max_size() / 2) {
+#else
+    while (n >= HiCutoff(num_buckets) && num_buckets <= max_size() / 2) {
+#endif
+      num_buckets *= 2;
+    }
+    return num_buckets;
+  }
+
+  // Makes the table large enough for `n` elements, and keeps it from
+  // shrinking below that.  An empty map that fits in the smallest table keeps
+  // the global empty table, so that its first insertion sets up a small table.
+  void Reserve(size_type n) {
+    const map_index_t new_num_buckets = NumBucketsFor(n);
+    min_num_buckets_ = (std::max)(min_num_buckets_, new_num_buckets);
+    if (new_num_buckets > num_buckets_ && new_num_buckets > kMinTableSize) {
+      Resize(new_num_buckets);
+    }
+  }
+
+  // Like Reserve(), but `n` is only an estimate: the table may shrink again
+  // as usual, and it grows to at most 16 times its size or
+  // kMaxReserveHintBuckets, whichever is larger.  The parser passes the number
+  // of entries on the wire, whose keys may repeat.
+  void ReserveHint(size_type n) {
+    enum { kMaxReserveHintBuckets = 4096 };
+    const size_type limit = (std::max)(size_type{kMaxReserveHintBuckets},
+                                       size_type{num_buckets_} * 16);
+    const map_index_t new_num_buckets = static_cast<map_index_t>(
+        (std::min)(size_type{NumBucketsFor(n)}, limit));
+    if (new_num_buckets > num_buckets_ && new_num_buckets > kMinTableSize) {
+      Resize(new_num_buckets);
+    }
+  }
+
   // Resize to the given number of buckets.
   void Resize(map_index_t new_num_buckets) {
     if (num_buckets_ == kGlobalEmptyTableSize) {
       // This is the global empty array.
       // Just overwrite with a new one. No need to transfer or free anything.
-      num_buckets_ = index_of_first_non_null_ = kMinTableSize;
+      num_buckets_ = index_of_first_non_null_ =
+          (std::max)(new_num_buckets, map_index_t{kMinTableSize});
       table_ = CreateEmptyTable(num_buckets_);
       seed_ = Seed();
       return;
@@ -1046,6 +1418,16 @@ class KeyMapBase : public UntypedMapBase {
     table_ = CreateEmptyTable(num_buckets_);
     const map_index_t start = index_of_first_non_null_;
     index_of_first_non_null_ = num_buckets_;
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    num_deleted_ = 0;
+    for (map_index_t i = start; i < old_table_size; ++i) {
+      if (!internal::TableEntryIsEmpty(old_table[i])) {
+        auto* node = static_cast<KeyNode*>(TableEntryToNode(old_table[i]));
+        const uint64_t h = hash_function()(node->key());
+        SetFlatEntry(FindFreeEntry(h), node, h);
+      }
+    }
+#else
     for (map_index_t i = start; i < old_table_size; ++i) {
       if (internal::TableEntryIsNonEmptyList(old_table[i])) {
         TransferList(static_cast<KeyNode*>(TableEntryToNode(old_table[i])));
@@ -1053,7 +1435,9 @@ class KeyMapBase : public UntypedMapBase {
         this->TransferTree(TableEntryToTree(old_table[i]), NodeToVariantKey);
       }
     }
-    DeleteTable(old_table, old_table_size);
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    // The small table still holds nodes.
+    if (old_table != small_table_) DeleteTable(old_table, old_table_size);
   }
 
   // Transfer all nodes in the list `node` into `this`.
@@ -1344,6 +1728,11 @@ class Map : private internal::KeyMapBase<internal::KeyForBase<Key>> {
   using Base::empty;
   using Base::size;
 
+  // Makes room for `n` elements in all, so that inserting up to that many
+  // does not rehash.  The map keeps at least that room, even when elements
+  // are erased.
+  void reserve(size_type n) { this->Reserve(n); }
+
   // Element access
   template <typename K = key_type>
   T& operator[](const key_arg<K>& key) ABSL_ATTRIBUTE_LIFETIME_BOUND {
@@ -1587,7 +1976,13 @@ class Map : private internal::KeyMapBase<internal::KeyForBase<Key>> {
       return std::make_pair(
           iterator(static_cast<Node*>(p.node), this, p.bucket), false);
     // Case 2: insert.
-    if (this->ResizeIfLoadIsOutOfRange(this->num_elements_ + 1)) {
+    // Allocating the first node sets up the table, so the bucket is not known
+    // before.
+    const bool had_table =
+        this->num_buckets_ != internal::kGlobalEmptyTableSize;
+    Node* node = static_cast<Node*>(this->AllocNode(sizeof(Node)));
+    if (this->ResizeIfLoadIsOutOfRange(this->num_elements_ + 1) ||
+        !had_table) {
       p = this->FindHelper(TS::ToView(k));
     }
     const auto b = p.bucket;  // bucket number
@@ -1595,7 +1990,6 @@ class Map : private internal::KeyMapBase<internal::KeyForBase<Key>> {
     using TypeToInit = typename std::conditional<
         std::is_same<typename std::decay<K>::type, key_type>::value, K&&,
         key_type>::type;
-    Node* node = static_cast<Node*>(this->AllocNode(sizeof(Node)));
 
     // Even when arena is nullptr, CreateInArenaStorage is still used to
     // ensure the arena of submessage will be consistent. Otherwise,
@@ -5,13 +5,23 @@
 // license that can be found in the LICENSE file or at
 // https://developers.google.com/open-source/licenses/bsd
 
+// Measures the hash table behind google::protobuf::Map: the mean probe
+// length at the lowest, average and highest load factors, and the time of
+// insertion, lookup, iteration and table-driven parsing at the highest one.
+// Build it with and without GOOGLE_PROTOBUF_MAP_FLAT_TABLE to compare the
+// chained and the open addressing table.
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <new>
 #include <string>
 #include <vector>
 
+#include <benchmark/benchmark.h>
 #include "absl/random/random.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
@@ -29,6 +39,22 @@ struct MapBenchmarkPeer {
   template <typename T>
   static double GetMeanProbeLength(const T& map) {
     double total_probe_cost = 0;
+#ifdef GOOGLE_PROTOBUF_MAP_FLAT_TABLE
+    // The number of groups looked at before the one that holds the node.
+    for (map_index_t b = 0; b < map.num_buckets_; ++b) {
+      if (map.TableEntryIsEmpty(b)) continue;
+      auto* node = static_cast<const typename T::Node*>(
+          internal::TableEntryToNode(map.table_[b]));
+      const uint64_t h = map.hash_function()(node->kv.first);
+      map_index_t step = 0;
+      size_t cost = 0;
+      for (map_index_t g = map.FirstGroup(h); g != (b & ~(kMapGroupWidth - 1));
+           g = map.NextGroup(g, &step)) {
+        ++cost;
+      }
+      total_probe_cost += static_cast<double>(cost);
+    }
+#else
     for (map_index_t b = 0; b < map.num_buckets_; ++b) {
       if (map.TableEntryIsList(b)) {
         auto* node = internal::TableEntryToNode(map.table_[b]);
@@ -46,6 +72,7 @@ struct MapBenchmarkPeer {
                             std::log2(tree_size);
       }
     }
+#endif  // GOOGLE_PROTOBUF_MAP_FLAT_TABLE
     return total_probe_cost / map.size();
   }
 
@@ -60,9 +87,25 @@ struct MapBenchmarkPeer {
     return static_cast<double>(total_tree_size) /
            static_cast<double>(map.size());
   }
+
+  // Inserts an entry the way the table-driven parser does: the node is
+  // allocated and filled before the lookup, and replaces any node with the
+  // same key.
+  template <typename T>
+  static void ParseEntry(T& map, const typename T::key_type& key,
+                         const typename T::mapped_type& value) {
+    using Node = typename T::Node;
+    auto* node = static_cast<Node*>(map.AllocNode(sizeof(Node)));
+    ::new (static_cast<void*>(&node->kv)) typename T::value_type{key, value};
+    node = static_cast<Node*>(
+        static_cast<typename T::KeyMapBase&>(map).InsertOrReplaceNode(node));
+    if (node != nullptr) {
+      node->~Node();
+      map.DeallocNode(node, sizeof(Node));
+    }
+  }
 };
-}  // namespace protobuf
-}  // namespace google::internal
+}  // namespace google::protobuf::internal
 
 namespace {
 
@@ -137,6 +180,61 @@ Ratios CollectMeanProbeLengths() {
   return result;
 }
 
+struct Timings {
+  // Nanoseconds per operation.
+  double insert;
+  double lookup;
+  double iterate;
+  double parse;
+};
+
+// Returns the fastest of a few runs of `fn(run)`, in nanoseconds per
+// operation.
+template <class Fn>
+double MinNanosPerOp(size_t ops, int runs, Fn fn) {
+  double best = std::numeric_limits<double>::infinity();
+  for (int run = 0; run < runs; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    fn(run);
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / static_cast<double>(ops));
+  }
+  return best;
+}
+
+template <class ElemFn>
+Timings CollectTimings() {
+  constexpr int kRuns = 5;
+  const size_t size = GetMinMaxLoadSizes().max_load;
+
+  ElemFn elem;
+  using Key = decltype(elem());
+  std::vector<Key> keys;
+  keys.reserve(size);
+  while (keys.size() < size) keys.push_back(elem());
+
+  Timings result;
+  std::vector<Table<Key>> tables(kRuns);
+  result.insert = MinNanosPerOp(keys.size(), kRuns, [&](int run) {
+    for (const Key& key : keys) tables[run][key];
+  });
+  const Table<Key>& t = tables.front();
+  result.lookup = MinNanosPerOp(keys.size(), kRuns, [&](int) {
+    for (const Key& key : keys) {
+      benchmark::DoNotOptimize(t.find(key)->second);
+    }
+  });
+  result.iterate = MinNanosPerOp(t.size(), kRuns, [&](int) {
+    for (const auto& entry : t) benchmark::DoNotOptimize(entry.second);
+  });
+  std::vector<Table<Key>> parsed(kRuns);
+  result.parse = MinNanosPerOp(keys.size(), kRuns, [&](int run) {
+    for (const Key& key : keys) Peer::ParseEntry(parsed[run], key, 1);
+  });
+  return result;
+}
+
 constexpr char kStringFormat[] = "/path/to/file/name-%07d-of-9999999.txt";
 
 template <bool small>
@@ -251,11 +349,13 @@ struct Result {
   std::string name;
   std::string dist_name;
   Ratios ratios;
+  Timings timings;
 };
 
 template <typename T, typename Dist>
 void RunForTypeAndDistribution(std::vector<Result>& results) {
-  results.push_back({Name<T>(), Name<Dist>(), CollectMeanProbeLengths<Dist>()});
+  results.push_back({Name<T>(), Name<Dist>(), CollectMeanProbeLengths<Dist>(),
+                     CollectTimings<Dist>()});
 }
 
 template <class T>
@@ -294,10 +394,26 @@ int main(int argc, char** argv) {
       absl::PrintF("    }\n");
       comma = ",";
     };
+    auto print_time = [&](absl::string_view stat, double Timings::*val) {
+      std::string name =
+          absl::StrCat(result.name, "/", result.dist_name, "/", stat);
+      absl::PrintF("    %s{\n", comma);
+      absl::PrintF("      \"cpu_time\": %f,\n", result.timings.*val);
+      absl::PrintF("      \"real_time\": %f,\n", result.timings.*val);
+      absl::PrintF("      \"iterations\": 1,\n");
+      absl::PrintF("      \"name\": \"%s\",\n", name);
+      absl::PrintF("      \"time_unit\": \"ns\"\n");
+      absl::PrintF("    }\n");
+      comma = ",";
+    };
     print("min", &Ratios::min_load);
     print("avg", &Ratios::avg_load);
     print("max", &Ratios::max_load);
     print("tree_percent", &Ratios::percent_tree);
+    print_time("insert", &Timings::insert);
+    print_time("lookup", &Timings::lookup);
+    print_time("iterate", &Timings::iterate);
+    print_time("parse", &Timings::parse);
   }
   absl::PrintF("  ],\n");
   absl::PrintF("  \"context\": {\n");
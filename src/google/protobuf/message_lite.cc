@@ -463,6 +463,7 @@ bool MessageLite::SerializePartialToZeroCopyStream(
     return false;
   }
 
+  output->ExpectBytes(static_cast<int64_t>(size));
   uint8_t* target;
   io::EpsCopyOutputStream stream(
       output, io::CodedOutputStream::IsDefaultSerializationDeterministic(),
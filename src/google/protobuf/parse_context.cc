@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cstring>
 
+#include "absl/numeric/bits.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "google/protobuf/message_lite.h"
@@ -17,6 +18,11 @@
 #include "google/protobuf/wire_format_lite.h"
 #include "utf8_validity.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // Must be included last.
 #include "google/protobuf/port_def.inc"
@@ -423,21 +429,38 @@ const char* InlineGreedyStringParser(std::string* s, const char* ptr,
 }
 
 
+// The vector loops are chosen when the library is compiled, never in headers,
+// so that code built for different targets agrees on a single definition.
+int CountVarintEnds(const char* begin, const char* end) {
+  int count = 0;
+  const char* p = begin;
+#if defined(__AVX2__)
+  for (; end - p >= 32; p += 32) {
+    const __m256i bytes =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    count += 32 - absl::popcount(
+                      static_cast<uint32_t>(_mm256_movemask_epi8(bytes)));
+  }
+#endif  // __AVX2__
+#if defined(__SSE2__)
+  for (; end - p >= 16; p += 16) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    count += 16 - absl::popcount(
+                      static_cast<uint32_t>(_mm_movemask_epi8(bytes)));
+  }
+#endif  // __SSE2__
+  for (; end - p >= 8; p += 8) {
+    count += 8 - absl::popcount(UnalignedLoad<uint64_t>(p) &
+                                uint64_t{0x8080808080808080});
+  }
+  for (; p < end; ++p) count += static_cast<uint8_t>(*p) < 0x80;
+  return count;
+}
+
 template <typename T, bool sign>
 const char* VarintParser(void* object, const char* ptr, ParseContext* ctx) {
-  return ctx->ReadPackedVarint(ptr, [object](uint64_t varint) {
-    T val;
-    if (sign) {
-      if (sizeof(T) == 8) {
-        val = WireFormatLite::ZigZagDecode64(varint);
-      } else {
-        val = WireFormatLite::ZigZagDecode32(varint);
-      }
-    } else {
-      val = varint;
-    }
-    static_cast<RepeatedField<T>*>(object)->Add(val);
-  });
+  return ctx->ReadPackedVarint(
+      ptr, PackedVarintSink<T, sign>{static_cast<RepeatedField<T>*>(object)});
 }
 
 const char* PackedInt32Parser(void* object, const char* ptr,
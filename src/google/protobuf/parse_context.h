@@ -17,6 +17,7 @@
 #include "absl/base/config.h"
 #include "absl/log/absl_check.h"
 #include "absl/log/absl_log.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/cord.h"
 #include "absl/strings/internal/resize_uninitialized.h"
 #include "absl/strings/string_view.h"
@@ -33,7 +34,6 @@
 #include "google/protobuf/repeated_field.h"
 #include "google/protobuf/wire_format_lite.h"
 
-
 // Must be included last.
 #include "google/protobuf/port_def.inc"
 
@@ -252,6 +252,11 @@ class PROTOBUF_EXPORT EpsCopyInputStream {
   int MaximumReadSize(const char* ptr) const {
     return static_cast<int>(limit_end_ - ptr) + kSlopBytes;
   }
+  // Number of bytes from `ptr` that are in the buffer and before the limit.
+  // Unlike MaximumReadSize(), this does not count the slop bytes.
+  int BytesAvailable(const char* ptr) const {
+    return static_cast<int>(limit_end_ - ptr);
+  }
   // Returns true if more data is available, if false is returned one has to
   // call Done for further checks.
   bool DataAvailable(const char* ptr) { return ptr < limit_end_; }
@@ -1219,6 +1224,72 @@ const char* ReadPackedVarintArray(const char* ptr, const char* end, Add add) {
   return ptr;
 }
 
+// Returns the number of bytes in [begin, end) with the high bit clear, which
+// is the number of varints that end in that range.
+PROTOBUF_EXPORT int CountVarintEnds(const char* begin, const char* end);
+
+// Appends varints to a RepeatedField<T>, converted the way generated code
+// does. Passing this instead of a lambda to ReadPackedVarint() selects the
+// bulk decoder below.
+template <typename T, bool zigzag>
+struct PackedVarintSink {
+  static T Convert(uint64_t varint) {
+    if (!zigzag) return static_cast<T>(varint);
+    if (sizeof(T) == 8) {
+      return static_cast<T>(WireFormatLite::ZigZagDecode64(varint));
+    }
+    return static_cast<T>(
+        WireFormatLite::ZigZagDecode32(static_cast<uint32_t>(varint)));
+  }
+  void operator()(uint64_t varint) const { field->Add(Convert(varint)); }
+
+  RepeatedField<T>* field;
+};
+
+// Same contract as the generic ReadPackedVarintArray(), but decodes straight
+// into the field: counting varint ends up front allows reserving once and
+// writing without per-element capacity checks, and runs of single byte
+// varints, which dominate typical feature data, are widened eight at a time.
+template <typename T, bool zigzag>
+const char* ReadPackedVarintArray(const char* ptr, const char* end,
+                                  PackedVarintSink<T, zigzag> sink) {
+  constexpr uint64_t kHighBits = 0x8080808080808080;
+  const int count = ptr < end ? CountVarintEnds(ptr, end) : 0;
+  if (count > 0) {
+    RepeatedField<T>* field = sink.field;
+    const int old_size = field->size();
+    field->Reserve(old_size + count);
+    T* out = field->AddNAlreadyReserved(count);
+    T* const out_end = out + count;
+    while (out != out_end) {
+      if (out_end - out >= 8 && end - ptr >= 8 &&
+          (UnalignedLoad<uint64_t>(ptr) & kHighBits) == 0) {
+        for (int i = 0; i < 8; ++i) {
+          out[i] = sink.Convert(static_cast<uint8_t>(ptr[i]));
+        }
+        ptr += 8;
+        out += 8;
+        continue;
+      }
+      uint64_t varint;
+      ptr = VarintParse(ptr, &varint);
+      if (ptr == nullptr) {
+        field->Truncate(old_size);
+        return nullptr;
+      }
+      *out++ = sink.Convert(varint);
+    }
+  }
+  // A varint may start before `end` and finish in the slop bytes after it.
+  while (ptr < end) {
+    uint64_t varint;
+    ptr = VarintParse(ptr, &varint);
+    if (ptr == nullptr) return nullptr;
+    sink(varint);
+  }
+  return ptr;
+}
+
 template <typename Add, typename SizeCb>
 const char* EpsCopyInputStream::ReadPackedVarint(const char* ptr, Add add,
                                                  SizeCb size_callback) {
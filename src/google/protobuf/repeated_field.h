@@ -23,6 +23,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <limits>
 #include <memory>
@@ -72,6 +73,25 @@ constexpr int RepeatedFieldLowerClampLimit() {
   return kRepHeaderSize / sizeof(T);
 }
 
+// A RepeatedField keeps its first few elements inline, in the bytes that
+// otherwise hold its size and capacity. The first word of the object is
+// tagged to tell the two representations apart: while the elements are inline
+// it holds the Arena* with the number of elements in the low bits, and once
+// they live in a separate array it holds a pointer to that array with
+// kNotSooBit set. Both pointers are at least 8-byte aligned.
+constexpr uintptr_t kSooSizeMask = 3;
+constexpr uintptr_t kNotSooBit = 4;
+constexpr uintptr_t kSooTagMask = kSooSizeMask | kNotSooBit;
+constexpr size_t kSooCapacityBytes = 2 * sizeof(int);
+
+// Number of elements of type T that a RepeatedField<T> stores inline.
+template <typename T>
+constexpr int SooCapacityElements() {
+  return alignof(T) > alignof(uintptr_t)
+             ? 0
+             : std::min<int>(kSooCapacityBytes / sizeof(T), kSooSizeMask);
+}
+
 // kRepeatedFieldUpperClampLimit is the lowest signed integer value that
 // overflows when multiplied by 2 (which is undefined behavior). Sizes above
 // this will clamp to the maximum int value instead of following exponential
@@ -234,7 +254,8 @@ class RepeatedField final
   void Resize(size_type new_size, const Element& value);
 
   // Gets the underlying array.  This pointer is possibly invalidated by
-  // any add or remove operation.
+  // any add or remove operation.  While the field is small enough to store its
+  // elements inline it is also invalidated by moving or swapping the field.
   pointer mutable_data() ABSL_ATTRIBUTE_LIFETIME_BOUND;
   const_pointer data() const ABSL_ATTRIBUTE_LIFETIME_BOUND;
 
@@ -294,8 +315,8 @@ class RepeatedField final
   // Note: this can be inaccurate for split default fields so we make this
   // function non-const.
   inline Arena* GetArena() {
-    return (total_size_ == 0) ? static_cast<Arena*>(arena_or_elements_)
-                              : rep()->arena;
+    return is_soo() ? reinterpret_cast<Arena*>(tagged_ & ~internal::kSooTagMask)
+                    : rep()->arena;
   }
 
   // For internal use only.
@@ -325,9 +346,18 @@ class RepeatedField final
     ~Rep() = delete;
   };
 
-  static constexpr int kInitialSize = 0;
   static PROTOBUF_CONSTEXPR const size_t kRepHeaderSize = sizeof(Rep);
 
+  // Number of elements stored inline before a Rep is allocated.
+  static constexpr int kSooCapacity = internal::SooCapacityElements<Element>();
+
+  // The size and capacity once the elements live in a Rep. While they are
+  // inline the same bytes hold the elements themselves.
+  struct HeapSize {
+    int size;
+    int capacity;
+  };
+
   RepeatedField(Arena* arena, const RepeatedField& rhs);
 
 
@@ -371,66 +401,94 @@ class RepeatedField final
   // Reserves space to expand the field to at least the given size.
   // If the array is grown, it will always be at least doubled in size.
   // If `annotate_size` is true (the default), then this function will annotate
-  // the old container from `current_size` to `total_size_` (unpoison memory)
+  // the old container from `current_size` to its capacity (unpoison memory)
   // directly before it is being released, and annotate the new container from
-  // `total_size_` to `current_size` (poison unused memory).
-  void Grow(int current_size, int new_size);
-  void GrowNoAnnotate(int current_size, int new_size);
+  // its capacity to `current_size` (poison unused memory).
+  // `was_soo` is the representation before growing; the field is never inline
+  // afterwards.
+  void Grow(bool was_soo, int current_size, int new_size);
+  void GrowNoAnnotate(bool was_soo, int current_size, int new_size);
 
   // Annotates a change in size of this instance. This function should be called
   // with (total_size, current_size) after new memory has been allocated and
   // filled from previous memory), and called with (current_size, total_size)
   // right before (previously annotated) memory is released.
+  // Inline elements live inside the object, which is copied and swapped as a
+  // whole, so only a Rep is annotated.
   void AnnotateSize(int old_size, int new_size) const {
-    if (old_size != new_size) {
+    if (old_size != new_size && !is_soo()) {
       ABSL_ANNOTATE_CONTIGUOUS_CONTAINER(
-          unsafe_elements(), unsafe_elements() + total_size_,
-          unsafe_elements() + old_size, unsafe_elements() + new_size);
+          unsafe_elements(false), unsafe_elements(false) + Capacity(false),
+          unsafe_elements(false) + old_size, unsafe_elements(false) + new_size);
       if (new_size < old_size) {
         ABSL_ANNOTATE_MEMORY_IS_UNINITIALIZED(
-            unsafe_elements() + new_size,
+            unsafe_elements(false) + new_size,
             (old_size - new_size) * sizeof(Element));
       }
     }
   }
 
-  // Replaces current_size_ with new_size and returns the previous value of
-  // current_size_. This function is intended to be the only place where
-  // current_size_ is modified, with the exception of `AddInputIterator()`
-  // where the size of added items is not known in advance.
-  inline int ExchangeCurrentSize(int new_size) {
-    const int prev_size = current_size_;
+  // Replaces the size with new_size and returns the previous size. This
+  // function is intended to be the only place where the size is modified, with
+  // the exception of `AddInputIterator()` where the size of added items is not
+  // known in advance.
+  inline int ExchangeCurrentSize(bool is_soo, int new_size) {
+    const int prev_size = size(is_soo);
     AnnotateSize(prev_size, new_size);
-    current_size_ = new_size;
+    set_size(is_soo, new_size);
     return prev_size;
   }
 
+  // Returns true if the elements are stored inline rather than in a Rep.
+  bool is_soo() const { return (tagged_ & internal::kNotSooBit) == 0; }
+
+  // The accessors below take the result of `is_soo()` so that callers which
+  // touch several of them only test the representation once.
+  int size(bool is_soo) const {
+    return is_soo ? static_cast<int>(tagged_ & internal::kSooSizeMask)
+                  : heap_.size;
+  }
+  int Capacity(bool is_soo) const {
+    return is_soo ? kSooCapacity : heap_.capacity;
+  }
+  void set_size(bool is_soo, int new_size) {
+    if (is_soo) {
+      ABSL_DCHECK_LE(new_size, kSooCapacity);
+      tagged_ = (tagged_ & ~internal::kSooSizeMask) |
+                static_cast<uintptr_t>(new_size);
+    } else {
+      heap_.size = new_size;
+    }
+  }
+
   // Returns a pointer to elements array.
-  // pre-condition: the array must have been allocated.
-  Element* elements() const {
-    ABSL_DCHECK_GT(total_size_, 0);
-    // Because of above pre-condition this cast is safe.
-    return unsafe_elements();
+  // pre-condition: the array must have room for at least one element.
+  Element* elements(bool is_soo) const {
+    ABSL_DCHECK_GT(Capacity(is_soo), 0);
+    return unsafe_elements(is_soo);
   }
 
-  // Returns a pointer to elements array if it exists; otherwise either null or
-  // an invalid pointer is returned. This only happens for empty repeated
-  // fields, where you can't dereference this pointer anyway (it's empty).
-  Element* unsafe_elements() const {
-    return static_cast<Element*>(arena_or_elements_);
+  // Returns a pointer to the elements array, which is the inline storage when
+  // `is_soo` is true. The pointer can't be dereferenced if the capacity is 0.
+  Element* unsafe_elements(bool is_soo) const {
+    if (is_soo) return reinterpret_cast<Element*>(const_cast<char*>(soo_));
+    return reinterpret_cast<Element*>(tagged_ & ~internal::kSooTagMask);
   }
+  Element* unsafe_elements() const { return unsafe_elements(is_soo()); }
 
   // Returns a pointer to the Rep struct.
-  // pre-condition: the Rep must have been allocated, ie elements() is safe.
+  // pre-condition: the elements are not inline.
   Rep* rep() const {
-    return reinterpret_cast<Rep*>(reinterpret_cast<char*>(elements()) -
-                                  kRepHeaderSize);
+    ABSL_DCHECK(!is_soo());
+    return reinterpret_cast<Rep*>(
+        reinterpret_cast<char*>(unsafe_elements(false)) - kRepHeaderSize);
   }
 
   // Internal helper to delete all elements and deallocate the storage.
+  // pre-condition: the elements are not inline.
   template <bool in_destructor = false>
   void InternalDeallocate() {
-    const size_t bytes = total_size_ * sizeof(Element) + kRepHeaderSize;
+    const size_t bytes = Capacity(false) * sizeof(Element) + kRepHeaderSize;
     if (rep()->arena == nullptr) {
       internal::SizedDelete(rep(), bytes);
     } else if (!in_destructor) {
@@ -448,46 +506,55 @@ class RepeatedField final
   // adding an arena_ element to RepeatedField is quite costly. By using
   // indirection in this way, we keep the same size when the RepeatedField is
   // empty (common case), and add only an 8-byte header to the elements array
-  // when non-empty. We make sure to place the size fields directly in the
+  // when it is allocated. We make sure to place the size fields directly in the
   // RepeatedField class to avoid costly cache misses due to the indirection.
-  int current_size_;
-  int total_size_;
-  // If total_size_ == 0 this points to an Arena otherwise it points to the
-  // elements member of a Rep struct. Using this invariant allows the storage of
-  // the arena pointer without an extra allocation in the constructor.
-  void* arena_or_elements_;
+  //
+  // Fields that hold only a few elements (also common) don't allocate at all:
+  // up to kSooCapacity elements are stored in place of `heap_`, with the size
+  // kept in the low bits of `tagged_` next to the arena pointer. See
+  // internal::kNotSooBit. All-zero bytes are a valid empty field.
+  uintptr_t tagged_;
+  union {
+    HeapSize heap_;
+    char soo_[internal::kSooCapacityBytes];
+  };
 };
 
 // implementation ====================================================
 
 template <typename Element>
-constexpr RepeatedField<Element>::RepeatedField()
-    : current_size_(0), total_size_(0), arena_or_elements_(nullptr) {
+constexpr RepeatedField<Element>::RepeatedField() : tagged_(0), heap_{0, 0} {
   StaticValidityCheck();
 }
 
 template <typename Element>
 inline RepeatedField<Element>::RepeatedField(Arena* arena)
-    : current_size_(0), total_size_(0), arena_or_elements_(arena) {
+    : tagged_(reinterpret_cast<uintptr_t>(arena)), heap_{0, 0} {
   StaticValidityCheck();
+  ABSL_DCHECK_EQ(tagged_ & internal::kSooTagMask, 0u);
 }
 
 template <typename Element>
 inline RepeatedField<Element>::RepeatedField(Arena* arena,
                                              const RepeatedField& rhs)
-    : current_size_(0), total_size_(0), arena_or_elements_(arena) {
+    : tagged_(reinterpret_cast<uintptr_t>(arena)), heap_{0, 0} {
   StaticValidityCheck();
-  if (auto size = rhs.current_size_) {
-    Grow(0, size);
-    ExchangeCurrentSize(size);
-    UninitializedCopyN(rhs.elements(), size, unsafe_elements());
+  const bool rhs_soo = rhs.is_soo();
+  if (auto size = rhs.size(rhs_soo)) {
+    bool soo = true;
+    if (size > kSooCapacity) {
+      Grow(soo, 0, size);
+      soo = false;
+    }
+    ExchangeCurrentSize(soo, size);
+    UninitializedCopyN(rhs.elements(rhs_soo), size, unsafe_elements(soo));
   }
 }
 
 template <typename Element>
 template <typename Iter, typename>
 RepeatedField<Element>::RepeatedField(Iter begin, Iter end)
-    : current_size_(0), total_size_(0), arena_or_elements_(nullptr) {
+    : tagged_(0), heap_{0, 0} {
   StaticValidityCheck();
   Add(begin, end);
 }
@@ -501,10 +568,9 @@ RepeatedField<Element>::~RepeatedField() {
   auto arena = GetArena();
   if (arena) (void)arena->SpaceAllocated();
 #endif
-  if (total_size_ > 0) {
-    Destroy(unsafe_elements(), unsafe_elements() + current_size_);
-    InternalDeallocate<true>();
-  }
+  const bool soo = is_soo();
+  Destroy(unsafe_elements(soo), unsafe_elements(soo) + size(soo));
+  if (!soo) InternalDeallocate<true>();
 }
 
 template <typename Element>
@@ -552,42 +618,48 @@ inline RepeatedField<Element>& RepeatedField<Element>::operator=(
 
 template <typename Element>
 inline bool RepeatedField<Element>::empty() const {
-  return current_size_ == 0;
+  return size() == 0;
 }
 
 template <typename Element>
 inline int RepeatedField<Element>::size() const {
-  return current_size_;
+  return size(is_soo());
 }
 
 template <typename Element>
 inline int RepeatedField<Element>::Capacity() const {
-  return total_size_;
+  return Capacity(is_soo());
 }
 
 template <typename Element>
 inline void RepeatedField<Element>::AddAlreadyReserved(Element value) {
-  ABSL_DCHECK_LT(current_size_, total_size_);
-  void* p = elements() + ExchangeCurrentSize(current_size_ + 1);
+  const bool soo = is_soo();
+  const int old_size = size(soo);
+  ABSL_DCHECK_LT(old_size, Capacity(soo));
+  void* p = elements(soo) + ExchangeCurrentSize(soo, old_size + 1);
   ::new (p) Element(std::move(value));
 }
 
 template <typename Element>
 inline Element* RepeatedField<Element>::AddAlreadyReserved()
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
-  ABSL_DCHECK_LT(current_size_, total_size_);
+  const bool soo = is_soo();
+  const int old_size = size(soo);
+  ABSL_DCHECK_LT(old_size, Capacity(soo));
   // new (p) <TrivialType> compiles into nothing: this is intentional as this
   // function is documented to return uninitialized data for trivial types.
-  void* p = elements() + ExchangeCurrentSize(current_size_ + 1);
+  void* p = elements(soo) + ExchangeCurrentSize(soo, old_size + 1);
   return ::new (p) Element;
 }
 
 template <typename Element>
 inline Element* RepeatedField<Element>::AddNAlreadyReserved(int n)
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
-  ABSL_DCHECK_GE(total_size_ - current_size_, n)
-      << total_size_ << ", " << current_size_;
-  Element* p = unsafe_elements() + ExchangeCurrentSize(current_size_ + n);
+  const bool soo = is_soo();
+  const int old_size = size(soo);
+  ABSL_DCHECK_GE(Capacity(soo) - old_size, n)
+      << Capacity(soo) << ", " << old_size;
+  Element* p = unsafe_elements(soo) + ExchangeCurrentSize(soo, old_size + n);
   for (Element *begin = p, *end = p + n; begin != end; ++begin) {
     new (static_cast<void*>(begin)) Element;
   }
@@ -597,123 +669,148 @@ inline Element* RepeatedField<Element>::AddNAlreadyReserved(int n)
 template <typename Element>
 inline void RepeatedField<Element>::Resize(int new_size, const Element& value) {
   ABSL_DCHECK_GE(new_size, 0);
-  if (new_size > current_size_) {
-    if (new_size > total_size_) Grow(current_size_, new_size);
-    Element* first = elements() + ExchangeCurrentSize(new_size);
-    std::uninitialized_fill(first, elements() + current_size_, value);
-  } else if (new_size < current_size_) {
-    Destroy(unsafe_elements() + new_size, unsafe_elements() + current_size_);
-    ExchangeCurrentSize(new_size);
+  bool soo = is_soo();
+  const int old_size = size(soo);
+  if (new_size > old_size) {
+    if (new_size > Capacity(soo)) {
+      Grow(soo, old_size, new_size);
+      soo = false;
+    }
+    Element* first = elements(soo) + ExchangeCurrentSize(soo, new_size);
+    std::uninitialized_fill(first, elements(soo) + new_size, value);
+  } else if (new_size < old_size) {
+    Element* elem = unsafe_elements(soo);
+    Destroy(elem + new_size, elem + old_size);
+    ExchangeCurrentSize(soo, new_size);
   }
 }
 
 template <typename Element>
 inline const Element& RepeatedField<Element>::Get(int index) const
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
+  const bool soo = is_soo();
   ABSL_DCHECK_GE(index, 0);
-  ABSL_DCHECK_LT(index, current_size_);
-  return elements()[index];
+  ABSL_DCHECK_LT(index, size(soo));
+  return elements(soo)[index];
 }
 
 template <typename Element>
 inline const Element& RepeatedField<Element>::at(int index) const
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
+  const bool soo = is_soo();
   ABSL_CHECK_GE(index, 0);
-  ABSL_CHECK_LT(index, current_size_);
-  return elements()[index];
+  ABSL_CHECK_LT(index, size(soo));
+  return elements(soo)[index];
 }
 
 template <typename Element>
 inline Element& RepeatedField<Element>::at(int index)
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
+  const bool soo = is_soo();
   ABSL_CHECK_GE(index, 0);
-  ABSL_CHECK_LT(index, current_size_);
-  return elements()[index];
+  ABSL_CHECK_LT(index, size(soo));
+  return elements(soo)[index];
 }
 
 template <typename Element>
 inline Element* RepeatedField<Element>::Mutable(int index)
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
+  const bool soo = is_soo();
   ABSL_DCHECK_GE(index, 0);
-  ABSL_DCHECK_LT(index, current_size_);
-  return &elements()[index];
+  ABSL_DCHECK_LT(index, size(soo));
+  return &elements(soo)[index];
 }
 
 template <typename Element>
 inline void RepeatedField<Element>::Set(int index, const Element& value) {
+  const bool soo = is_soo();
   ABSL_DCHECK_GE(index, 0);
-  ABSL_DCHECK_LT(index, current_size_);
-  elements()[index] = value;
+  ABSL_DCHECK_LT(index, size(soo));
+  elements(soo)[index] = value;
 }
 
 template <typename Element>
 inline void RepeatedField<Element>::Add(Element value) {
-  int total_size = total_size_;
-  Element* elem = unsafe_elements();
-  if (ABSL_PREDICT_FALSE(current_size_ == total_size)) {
-    Grow(current_size_, current_size_ + 1);
-    total_size = total_size_;
-    elem = unsafe_elements();
+  bool soo = is_soo();
+  const int old_size = size(soo);
+  int capacity = Capacity(soo);
+  Element* elem = unsafe_elements(soo);
+  if (ABSL_PREDICT_FALSE(old_size == capacity)) {
+    Grow(soo, old_size, old_size + 1);
+    soo = false;
+    capacity = Capacity(soo);
+    elem = unsafe_elements(soo);
   }
-  int new_size = current_size_ + 1;
-  void* p = elem + ExchangeCurrentSize(new_size);
+  int new_size = old_size + 1;
+  void* p = elem + ExchangeCurrentSize(soo, new_size);
   ::new (p) Element(std::move(value));
 
   // The below helps the compiler optimize dense loops.
-  ABSL_ASSUME(new_size == current_size_);
-  ABSL_ASSUME(elem == arena_or_elements_);
-  ABSL_ASSUME(total_size == total_size_);
+  ABSL_ASSUME(soo == is_soo());
+  ABSL_ASSUME(new_size == size(soo));
+  ABSL_ASSUME(elem == unsafe_elements(soo));
+  ABSL_ASSUME(capacity == Capacity(soo));
 }
 
 template <typename Element>
 inline Element* RepeatedField<Element>::Add() ABSL_ATTRIBUTE_LIFETIME_BOUND {
-  if (ABSL_PREDICT_FALSE(current_size_ == total_size_)) {
-    Grow(current_size_, current_size_ + 1);
+  bool soo = is_soo();
+  const int old_size = size(soo);
+  if (ABSL_PREDICT_FALSE(old_size == Capacity(soo))) {
+    Grow(soo, old_size, old_size + 1);
+    soo = false;
   }
-  void* p = unsafe_elements() + ExchangeCurrentSize(current_size_ + 1);
+  void* p = unsafe_elements(soo) + ExchangeCurrentSize(soo, old_size + 1);
   return ::new (p) Element;
 }
 
 template <typename Element>
 template <typename Iter>
 inline void RepeatedField<Element>::AddForwardIterator(Iter begin, Iter end) {
-  int total_size = total_size_;
-  Element* elem = unsafe_elements();
-  int new_size = current_size_ + static_cast<int>(std::distance(begin, end));
-  if (ABSL_PREDICT_FALSE(new_size > total_size)) {
-    Grow(current_size_, new_size);
-    elem = unsafe_elements();
-    total_size = total_size_;
+  bool soo = is_soo();
+  const int old_size = size(soo);
+  int capacity = Capacity(soo);
+  Element* elem = unsafe_elements(soo);
+  int new_size = old_size + static_cast<int>(std::distance(begin, end));
+  if (ABSL_PREDICT_FALSE(new_size > capacity)) {
+    Grow(soo, old_size, new_size);
+    soo = false;
+    elem = unsafe_elements(soo);
+    capacity = Capacity(soo);
   }
-  UninitializedCopy(begin, end, elem + ExchangeCurrentSize(new_size));
+  UninitializedCopy(begin, end, elem + ExchangeCurrentSize(soo, new_size));
 
   // The below helps the compiler optimize dense loops.
-  ABSL_ASSUME(new_size == current_size_);
-  ABSL_ASSUME(elem == arena_or_elements_);
-  ABSL_ASSUME(total_size == total_size_);
+  ABSL_ASSUME(soo == is_soo());
+  ABSL_ASSUME(new_size == size(soo));
+  ABSL_ASSUME(elem == unsafe_elements(soo));
+  ABSL_ASSUME(capacity == Capacity(soo));
 }
 
 template <typename Element>
 template <typename Iter>
 inline void RepeatedField<Element>::AddInputIterator(Iter begin, Iter end) {
-  Element* first = unsafe_elements() + current_size_;
-  Element* last = unsafe_elements() + total_size_;
-  AnnotateSize(current_size_, total_size_);
+  bool soo = is_soo();
+  Element* first = unsafe_elements(soo) + size(soo);
+  Element* last = unsafe_elements(soo) + Capacity(soo);
+  AnnotateSize(size(soo), Capacity(soo));
 
   while (begin != end) {
     if (ABSL_PREDICT_FALSE(first == last)) {
-      int current_size = first - unsafe_elements();
-      GrowNoAnnotate(current_size, current_size + 1);
-      first = unsafe_elements() + current_size;
-      last = unsafe_elements() + total_size_;
+      int current_size = first - unsafe_elements(soo);
+      GrowNoAnnotate(soo, current_size, current_size + 1);
+      soo = false;
+      first = unsafe_elements(soo) + current_size;
+      last = unsafe_elements(soo) + Capacity(soo);
     }
     ::new (static_cast<void*>(first)) Element(*begin);
     ++begin;
     ++first;
   }
 
-  current_size_ = first - unsafe_elements();
-  AnnotateSize(total_size_, current_size_);
+  const int new_size = first - unsafe_elements(soo);
+  set_size(soo, new_size);
+  AnnotateSize(Capacity(soo), new_size);
 }
 
 template <typename Element>
@@ -730,9 +827,11 @@ inline void RepeatedField<Element>::Add(Iter begin, Iter end) {
 
 template <typename Element>
 inline void RepeatedField<Element>::RemoveLast() {
-  ABSL_DCHECK_GT(current_size_, 0);
-  elements()[current_size_ - 1].~Element();
-  ExchangeCurrentSize(current_size_ - 1);
+  const bool soo = is_soo();
+  const int old_size = size(soo);
+  ABSL_DCHECK_GT(old_size, 0);
+  elements(soo)[old_size - 1].~Element();
+  ExchangeCurrentSize(soo, old_size - 1);
 }
 
 template <typename Element>
@@ -740,7 +839,7 @@ void RepeatedField<Element>::ExtractSubrange(int start, int num,
                                              Element* elements) {
   ABSL_DCHECK_GE(start, 0);
   ABSL_DCHECK_GE(num, 0);
-  ABSL_DCHECK_LE(start + num, this->current_size_);
+  ABSL_DCHECK_LE(start + num, this->size());
 
   // Save the values of the removed elements if requested.
   if (elements != nullptr) {
@@ -749,25 +848,31 @@ void RepeatedField<Element>::ExtractSubrange(int start, int num,
 
   // Slide remaining elements down to fill the gap.
   if (num > 0) {
-    for (int i = start + num; i < this->current_size_; ++i)
+    for (int i = start + num; i < this->size(); ++i)
       this->Set(i - num, this->Get(i));
-    this->Truncate(this->current_size_ - num);
+    this->Truncate(this->size() - num);
   }
 }
 
 template <typename Element>
 inline void RepeatedField<Element>::Clear() {
-  Destroy(unsafe_elements(), unsafe_elements() + current_size_);
-  ExchangeCurrentSize(0);
+  const bool soo = is_soo();
+  Element* elem = unsafe_elements(soo);
+  Destroy(elem, elem + size(soo));
+  ExchangeCurrentSize(soo, 0);
 }
 
 template <typename Element>
 inline void RepeatedField<Element>::MergeFrom(const RepeatedField& other) {
   ABSL_DCHECK_NE(&other, this);
-  if (auto size = other.current_size_) {
-    Reserve(current_size_ + size);
-    Element* dst = elements() + ExchangeCurrentSize(current_size_ + size);
-    UninitializedCopyN(other.elements(), size, dst);
+  const bool other_soo = other.is_soo();
+  if (auto other_size = other.size(other_soo)) {
+    const int old_size = size();
+    Reserve(old_size + other_size);
+    const bool soo = is_soo();
+    Element* dst =
+        elements(soo) + ExchangeCurrentSize(soo, old_size + other_size);
+    UninitializedCopyN(other.elements(other_soo), other_size, dst);
   }
 }
 
@@ -818,12 +923,12 @@ inline void RepeatedField<Element>::InternalSwap(
     RepeatedField* PROTOBUF_RESTRICT other) {
   ABSL_DCHECK(this != other);
 
-  // Swap all fields at once.
+  // Swap all fields at once. Inline elements are swapped along with the rest
+  // of the object.
   static_assert(std::is_standard_layout<RepeatedField<Element>>::value,
                 "offsetof() requires standard layout before c++17");
-  static constexpr size_t kOffset = offsetof(RepeatedField, current_size_);
-  internal::memswap<offsetof(RepeatedField, arena_or_elements_) +
-                    sizeof(this->arena_or_elements_) - kOffset>(
+  static constexpr size_t kOffset = offsetof(RepeatedField, tagged_);
+  internal::memswap<sizeof(RepeatedField) - kOffset>(
       reinterpret_cast<char*>(this) + kOffset,
       reinterpret_cast<char*>(other) + kOffset);
 }
@@ -855,7 +960,8 @@ void RepeatedField<Element>::UnsafeArenaSwap(RepeatedField* other) {
 template <typename Element>
 void RepeatedField<Element>::SwapElements(int index1, int index2) {
   using std::swap;  // enable ADL with fallback
-  swap(elements()[index1], elements()[index2]);
+  Element* elem = elements(is_soo());
+  swap(elem[index1], elem[index2]);
 }
 
 template <typename Element>
@@ -876,22 +982,25 @@ RepeatedField<Element>::cbegin() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
 template <typename Element>
 inline typename RepeatedField<Element>::iterator RepeatedField<Element>::end()
     ABSL_ATTRIBUTE_LIFETIME_BOUND {
-  return iterator(unsafe_elements() + current_size_);
+  const bool soo = is_soo();
+  return iterator(unsafe_elements(soo) + size(soo));
 }
 template <typename Element>
 inline typename RepeatedField<Element>::const_iterator
 RepeatedField<Element>::end() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
-  return const_iterator(unsafe_elements() + current_size_);
+  const bool soo = is_soo();
+  return const_iterator(unsafe_elements(soo) + size(soo));
 }
 template <typename Element>
 inline typename RepeatedField<Element>::const_iterator
 RepeatedField<Element>::cend() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
-  return const_iterator(unsafe_elements() + current_size_);
+  const bool soo = is_soo();
+  return const_iterator(unsafe_elements(soo) + size(soo));
 }
 
 template <typename Element>
 inline size_t RepeatedField<Element>::SpaceUsedExcludingSelfLong() const {
-  return total_size_ > 0 ? (total_size_ * sizeof(Element) + kRepHeaderSize) : 0;
+  return is_soo() ? 0 : (Capacity(false) * sizeof(Element) + kRepHeaderSize);
 }
 
 namespace internal {
@@ -925,22 +1034,32 @@ inline int CalculateReserveSize(int total_size, int new_size) {
 
 template <typename Element>
 void RepeatedField<Element>::Reserve(int new_size) {
-  if (ABSL_PREDICT_FALSE(new_size > total_size_)) {
-    Grow(current_size_, new_size);
+  const bool soo = is_soo();
+  if (ABSL_PREDICT_FALSE(new_size > Capacity(soo))) {
+    Grow(soo, size(soo), new_size);
   }
 }
 
 // Avoid inlining of Reserve(): new, copy, and delete[] lead to a significant
 // amount of code bloat.
 template <typename Element>
-PROTOBUF_NOINLINE void RepeatedField<Element>::GrowNoAnnotate(int current_size,
+PROTOBUF_NOINLINE void RepeatedField<Element>::GrowNoAnnotate(bool was_soo,
+                                                              int current_size,
                                                               int new_size) {
-  ABSL_DCHECK_GT(new_size, total_size_);
+  ABSL_DCHECK_EQ(was_soo, is_soo());
+  ABSL_DCHECK_GT(new_size, Capacity(was_soo));
   Rep* new_rep;
   Arena* arena = GetArena();
 
+  // Leaving the inline storage grows as if from the smallest Rep, which holds
+  // as many bytes of elements as the inline storage does. This keeps the
+  // allocation sizes at powers of two.
+  const int old_capacity =
+      was_soo && kSooCapacity > 0
+          ? internal::RepeatedFieldLowerClampLimit<Element, kRepHeaderSize>()
+          : Capacity(was_soo);
   new_size = internal::CalculateReserveSize<Element, kRepHeaderSize>(
-      total_size_, new_size);
+      old_capacity, new_size);
 
   ABSL_DCHECK_LE(
       static_cast<size_t>(new_size),
@@ -963,25 +1082,28 @@ PROTOBUF_NOINLINE void RepeatedField<Element>::GrowNoAnnotate(int current_size,
   }
   new_rep->arena = arena;
 
-  if (total_size_ > 0) {
-    if (current_size > 0) {
-      Element* pnew = new_rep->elements();
-      Element* pold = elements();
-      // TODO: add absl::is_trivially_relocatable<Element>
-      if (std::is_trivial<Element>::value) {
-        memcpy(static_cast<void*>(pnew), pold, current_size * sizeof(Element));
-      } else {
-        for (Element* end = pnew + current_size; pnew != end; ++pnew, ++pold) {
-          ::new (static_cast<void*>(pnew)) Element(std::move(*pold));
-          pold->~Element();
-        }
+  if (current_size > 0) {
+    Element* pnew = new_rep->elements();
+    Element* pold = unsafe_elements(was_soo);
+    // TODO: add absl::is_trivially_relocatable<Element>
+    if (std::is_trivial<Element>::value) {
+      memcpy(static_cast<void*>(pnew), pold, current_size * sizeof(Element));
+    } else {
+      for (Element* end = pnew + current_size; pnew != end; ++pnew, ++pold) {
+        ::new (static_cast<void*>(pnew)) Element(std::move(*pold));
+        pold->~Element();
       }
     }
-    InternalDeallocate();
   }
-
-  total_size_ = new_size;
-  arena_or_elements_ = new_rep->elements();
+  if (!was_soo) InternalDeallocate();
+
+  // The inline elements overlap `heap_`, so it is only written once they have
+  // been moved out.
+  tagged_ = reinterpret_cast<uintptr_t>(new_rep->elements());
+  ABSL_DCHECK_EQ(tagged_ & internal::kSooTagMask, 0u);
+  tagged_ |= internal::kNotSooBit;
+  heap_.size = current_size;
+  heap_.capacity = new_size;
 }
 
 // Ideally we would be able to use:
@@ -990,19 +1112,23 @@ PROTOBUF_NOINLINE void RepeatedField<Element>::GrowNoAnnotate(int current_size,
 // However, as explained in b/266411038#comment9, this causes issues
 // in shared libraries for Youtube (and possibly elsewhere).
 template <typename Element>
-PROTOBUF_NOINLINE void RepeatedField<Element>::Grow(int current_size,
+PROTOBUF_NOINLINE void RepeatedField<Element>::Grow(bool was_soo,
+                                                    int current_size,
                                                     int new_size) {
-  AnnotateSize(current_size, total_size_);
-  GrowNoAnnotate(current_size, new_size);
-  AnnotateSize(total_size_, current_size);
+  AnnotateSize(current_size, Capacity(was_soo));
+  GrowNoAnnotate(was_soo, current_size, new_size);
+  AnnotateSize(Capacity(false), current_size);
 }
 
 template <typename Element>
 inline void RepeatedField<Element>::Truncate(int new_size) {
-  ABSL_DCHECK_LE(new_size, current_size_);
-  if (new_size < current_size_) {
-    Destroy(unsafe_elements() + new_size, unsafe_elements() + current_size_);
-    ExchangeCurrentSize(new_size);
+  const bool soo = is_soo();
+  const int old_size = size(soo);
+  ABSL_DCHECK_LE(new_size, old_size);
+  if (new_size < old_size) {
+    Element* elem = unsafe_elements(soo);
+    Destroy(elem + new_size, elem + old_size);
+    ExchangeCurrentSize(soo, new_size);
   }
 }
 
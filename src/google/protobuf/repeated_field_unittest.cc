@@ -116,12 +116,75 @@ TEST(RepeatedField, Small) {
 
   EXPECT_TRUE(field.empty());
   EXPECT_EQ(field.size(), 0);
-  // Additional bytes are for 'struct Rep' header.
-  int expected_usage =
-      (sizeof(Arena*) > sizeof(int) ? sizeof(Arena*) / sizeof(int) : 3) *
-          sizeof(int) +
-      sizeof(Arena*);
-  EXPECT_GE(field.SpaceUsedExcludingSelf(), expected_usage);
+  // Two ints are stored inline, so nothing was allocated.
+  EXPECT_EQ(field.SpaceUsedExcludingSelf(), 0);
+}
+
+TEST(RepeatedField, InlineCapacity) {
+  EXPECT_EQ(RepeatedField<bool>().Capacity(), 3);
+  EXPECT_EQ(RepeatedField<int32_t>().Capacity(), 2);
+  EXPECT_EQ(RepeatedField<float>().Capacity(), 2);
+  EXPECT_EQ(RepeatedField<absl::Cord>().Capacity(), 0);
+  if (alignof(int64_t) <= alignof(void*)) {
+    EXPECT_EQ(RepeatedField<int64_t>().Capacity(), 1);
+  }
+  EXPECT_EQ(sizeof(RepeatedField<int32_t>), sizeof(void*) + 2 * sizeof(int));
+}
+
+TEST(RepeatedField, InlineElementsMoveToHeapWhenGrowing) {
+  RepeatedField<int> field;
+  field.Add(1);
+  field.Add(2);
+  const int* inline_data = field.data();
+  EXPECT_GE(inline_data, reinterpret_cast<const void*>(&field));
+  EXPECT_LT(inline_data, reinterpret_cast<const void*>(&field + 1));
+  EXPECT_EQ(field.SpaceUsedExcludingSelf(), 0);
+
+  field.Add(3);
+  EXPECT_NE(field.data(), inline_data);
+  EXPECT_GT(field.SpaceUsedExcludingSelf(), 0);
+  EXPECT_THAT(field, ElementsAre(1, 2, 3));
+
+  // Once on the heap, the elements stay there.
+  field.Clear();
+  field.Add(4);
+  EXPECT_NE(field.data(), inline_data);
+  EXPECT_THAT(field, ElementsAre(4));
+}
+
+TEST(RepeatedField, InlineElementsOnArena) {
+  Arena arena;
+  auto* field = Arena::CreateMessage<RepeatedField<int>>(&arena);
+  const size_t used = arena.SpaceUsed();
+  field->Add(1);
+  field->Add(2);
+  EXPECT_EQ(field->GetArena(), &arena);
+  EXPECT_EQ(arena.SpaceUsed(), used);
+
+  field->Add(3);
+  EXPECT_EQ(field->GetArena(), &arena);
+  EXPECT_GT(arena.SpaceUsed(), used);
+  EXPECT_THAT(*field, ElementsAre(1, 2, 3));
+
+  RepeatedField<int> copy(*field);
+  EXPECT_EQ(copy.GetArena(), nullptr);
+  EXPECT_THAT(copy, ElementsAre(1, 2, 3));
+}
+
+TEST(RepeatedField, SwapInlineAndHeap) {
+  RepeatedField<int64_t> small;
+  RepeatedField<int64_t> large;
+  small.Add(7);
+  for (int i = 0; i < 5; ++i) large.Add(i);
+
+  small.Swap(&large);
+  EXPECT_THAT(small, ElementsAre(0, 1, 2, 3, 4));
+  EXPECT_THAT(large, ElementsAre(7));
+
+  RepeatedField<int64_t> moved(std::move(large));
+  EXPECT_THAT(moved, ElementsAre(7));
+  small = std::move(moved);
+  EXPECT_THAT(small, ElementsAre(7));
 }
 
 
@@ -173,8 +236,11 @@ void CheckAllocationSizes(bool is_ptr) {
         ASSERT_EQ((1 << log2), last_alloc);
       }
 
-      // The byte size must be a multiple of 8.
-      ASSERT_EQ(rep->Capacity() * sizeof(T) % 8, 0);
+      // The byte size must be a multiple of 8. Elements stored inline are not
+      // an allocation.
+      if (is_ptr || rep->SpaceUsedExcludingSelf() > 0) {
+        ASSERT_EQ(rep->Capacity() * sizeof(T) % 8, 0);
+      }
     }
   }
 }
@@ -397,10 +463,11 @@ TEST(RepeatedField, Resize) {
 
 TEST(RepeatedField, ReserveNothing) {
   RepeatedField<int> field;
-  EXPECT_EQ(0, field.Capacity());
+  const int inline_capacity = field.Capacity();
 
   field.Reserve(-1);
-  EXPECT_EQ(0, field.Capacity());
+  EXPECT_EQ(inline_capacity, field.Capacity());
+  EXPECT_EQ(0, field.SpaceUsedExcludingSelf());
 }
 
 TEST(RepeatedField, ReserveLowerClamp) {
@@ -810,13 +877,15 @@ TEST(RepeatedField, SelfAssign) {
 
 TEST(RepeatedField, MoveConstruct) {
   {
+    // Three elements don't fit inline, so the heap array is moved.
     RepeatedField<int> source;
     source.Add(1);
     source.Add(2);
+    source.Add(3);
     const int* data = source.data();
     RepeatedField<int> destination = std::move(source);
     EXPECT_EQ(data, destination.data());
-    EXPECT_THAT(destination, ElementsAre(1, 2));
+    EXPECT_THAT(destination, ElementsAre(1, 2, 3));
     // This property isn't guaranteed but it's useful to have a test that would
     // catch changes in this area.
     EXPECT_TRUE(source.empty());
@@ -838,20 +907,24 @@ TEST(RepeatedField, MoveConstruct) {
 
 TEST(RepeatedField, MoveAssign) {
   {
+    // Three elements don't fit inline, so the heap arrays are swapped.
     RepeatedField<int> source;
     source.Add(1);
     source.Add(2);
+    source.Add(3);
     RepeatedField<int> destination;
-    destination.Add(3);
+    destination.Add(4);
+    destination.Add(5);
+    destination.Add(6);
     const int* source_data = source.data();
     const int* destination_data = destination.data();
     destination = std::move(source);
     EXPECT_EQ(source_data, destination.data());
-    EXPECT_THAT(destination, ElementsAre(1, 2));
+    EXPECT_THAT(destination, ElementsAre(1, 2, 3));
     // This property isn't guaranteed but it's useful to have a test that would
     // catch changes in this area.
     EXPECT_EQ(destination_data, source.data());
-    EXPECT_THAT(source, ElementsAre(3));
+    EXPECT_THAT(source, ElementsAre(4, 5, 6));
   }
   {
     Arena arena;
@@ -859,14 +932,15 @@ TEST(RepeatedField, MoveAssign) {
         Arena::CreateMessage<RepeatedField<int>>(&arena);
     source->Add(1);
     source->Add(2);
+    source->Add(3);
     RepeatedField<int>* destination =
         Arena::CreateMessage<RepeatedField<int>>(&arena);
-    destination->Add(3);
+    destination->Add(4);
     const int* source_data = source->data();
     *destination = std::move(*source);
     EXPECT_EQ(source_data, destination->data());
-    EXPECT_THAT(*destination, ElementsAre(1, 2));
-    EXPECT_THAT(*source, ElementsAre(3));
+    EXPECT_THAT(*destination, ElementsAre(1, 2, 3));
+    EXPECT_THAT(*source, ElementsAre(4));
   }
   {
     Arena source_arena;
@@ -63,6 +63,9 @@ class PROTOBUF_EXPORT ThreadSafeArena {
 
   uint64_t SpaceAllocated() const;
   uint64_t SpaceUsed() const;
+  uint64_t SpaceRetained() const {
+    return space_retained_.load(std::memory_order_relaxed);
+  }
 
   template <AllocationClient alloc_client = AllocationClient::kDefault>
   void* AllocateAligned(size_t n) {
@@ -129,6 +132,24 @@ class PROTOBUF_EXPORT ThreadSafeArena {
   // Adds SerialArena to the chunked list. May create a new chunk.
   void AddSerialArena(void* id, SerialArena* serial);
 
+  // Returns a block of at least `min_bytes` usable bytes. Reuses a block kept
+  // by Reset() if one is large enough; otherwise allocates a new block whose
+  // size follows the growth policy from `last_size`.
+  SizedPtr AllocateBlock(size_t last_size, size_t min_bytes);
+
+  // Keeps `mem` for reuse by AllocateBlock() if that doesn't exceed
+  // AllocationPolicy::max_retained_bytes. Returns false if the caller still
+  // owns `mem` and must deallocate it.
+  bool RetainBlock(SizedPtr mem);
+
+  // Pops the first retained block with room for `min_bytes` usable bytes.
+  // Returns {nullptr, 0} if there is none.
+  SizedPtr TakeRetainedBlock(size_t min_bytes);
+
+  // Deallocates all retained blocks.
+  template <typename Deallocator>
+  void FreeRetainedBlocks(Deallocator deallocator);
+
   // Members are declared here to track sizeof(ThreadSafeArena) and hotness
   // centrally.
 
@@ -148,6 +169,17 @@ class PROTOBUF_EXPORT ThreadSafeArena {
   // user-provided initial block.
   SerialArena first_arena_;
 
+  // Blocks released by Reset() and kept for reuse, threaded through their
+  // first bytes. Protected by mutex_ once the arena is shared between threads.
+  struct RetainedBlock {
+    RetainedBlock* next;
+    size_t size;
+  };
+  RetainedBlock* retained_blocks_ = nullptr;
+  // Total size of `retained_blocks_`. Read without the mutex to skip the
+  // lookup in the common case where nothing is retained.
+  std::atomic<size_t> space_retained_{0};
+
   static_assert(std::is_trivially_destructible<SerialArena>{},
                 "SerialArena needs to be trivially destructible.");
 
@@ -203,8 +235,9 @@ class PROTOBUF_EXPORT ThreadSafeArena {
 
   // Releases all memory except the first block which it returns. The first
   // block might be owned by the user and thus need some extra checks before
-  // deleting.
-  SizedPtr Free(size_t* space_allocated);
+  // deleting. If `retain_blocks` is true, released blocks are offered to
+  // RetainBlock() first.
+  SizedPtr Free(size_t* space_allocated, bool retain_blocks = false);
 
   // ThreadCache is accessed very frequently, so we align it such that it's
   // located within a single cache line.
@@ -10,7 +10,17 @@
 
 #include "google/protobuf/util/delimited_message_util.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/parse_context.h"
 
 namespace google {
 namespace protobuf {
@@ -101,6 +111,111 @@ bool SerializeDelimitedToCodedStream(const MessageLite& message,
   return true;
 }
 
+DelimitedMessageReader::DelimitedMessageReader(io::ZeroCopyInputStream* input)
+    : input_(input) {
+  Restart();
+}
+
+DelimitedMessageReader::~DelimitedMessageReader() {
+  if (ptr_ != nullptr) ctx_->BackUp(ptr_);
+}
+
+void DelimitedMessageReader::Restart() {
+  if (ctx_ != nullptr) ctx_->BackUp(ptr_);
+  // ParseMessage() counts the messages read as one level of recursion.
+  ctx_ = std::make_unique<internal::ParseContext>(
+      io::CodedInputStream::GetDefaultRecursionLimit() + 1,
+      /*aliasing=*/false, &ptr_, input_);
+}
+
+bool DelimitedMessageReader::AtEnd() {
+  if (ptr_ == nullptr) return true;
+  // A context reads at most INT_MAX bytes, and then reports the end of the
+  // stream.  Start a new one well before that, so that only messages of more
+  // than 1GB can run into the limit.
+  if (ctx_->BytesUntilLimit(ptr_) < INT_MAX / 2) Restart();
+  if (!ctx_->Done(&ptr_)) return false;
+  // Done() sets ptr_ to null if the last message went past the end.
+  clean_eof_ = ptr_ != nullptr;
+  ptr_ = nullptr;
+  return true;
+}
+
+bool DelimitedMessageReader::ReadMessage(MessageLite* message) {
+  if (AtEnd()) return false;
+  message->Clear();
+  ptr_ = ctx_->ParseMessage(message, ptr_);
+  return ptr_ != nullptr && message->IsInitialized();
+}
+
+int DelimitedMessageReader::ReadMessages(const MessageLite& prototype,
+                                         Arena* arena, int max_count,
+                                         std::vector<MessageLite*>* messages) {
+  int count = 0;
+  while (count < max_count && !AtEnd()) {
+    MessageLite* message = prototype.New(arena);
+    ptr_ = ctx_->ParseMessage(message, ptr_);
+    if (ptr_ == nullptr || !message->IsInitialized()) {
+      if (arena == nullptr) delete message;
+      break;
+    }
+    messages->push_back(message);
+    ++count;
+  }
+  return count;
+}
+
+int DelimitedMessageReader::ReadMessagesParallel(
+    const MessageLite& prototype, Arena* arena, int max_count, int batch_size,
+    ParseExecutor executor, std::vector<MessageLite*>* messages) {
+  ABSL_CHECK_GT(batch_size, 0);
+  // Copies the messages next to each other, and records where each one ends.
+  std::string buffer;
+  std::vector<size_t> ends;
+  while (static_cast<int>(ends.size()) < max_count && !AtEnd()) {
+    const int size = static_cast<int>(internal::ReadSize(&ptr_));
+    if (ptr_ == nullptr) break;
+    ptr_ = ctx_->AppendString(ptr_, size, &buffer);
+    // A message cut short by the end of the stream shows as an overrun there.
+    if (ptr_ == nullptr || (AtEnd() && !clean_eof_)) {
+      ptr_ = nullptr;
+      break;
+    }
+    ends.push_back(buffer.size());
+  }
+
+  const int count = static_cast<int>(ends.size());
+  const size_t first = messages->size();
+  messages->resize(first + count);
+  std::unique_ptr<bool[]> parsed(new bool[count]);
+  const int num_batches = (count + batch_size - 1) / batch_size;
+  absl::BlockingCounter pending(num_batches);
+  for (int begin = 0; begin < count; begin += batch_size) {
+    const int end = std::min(count, begin + batch_size);
+    executor([&, begin, end] {
+      for (int i = begin; i < end; i++) {
+        const size_t offset = i == 0 ? 0 : ends[i - 1];
+        MessageLite* message = prototype.New(arena);
+        (*messages)[first + i] = message;
+        parsed[i] = message->ParseFromArray(buffer.data() + offset,
+                                            static_cast<int>(ends[i] - offset));
+      }
+      pending.DecrementCount();
+    });
+  }
+  pending.Wait();
+
+  // Drops the messages from the first one that does not parse, as
+  // ReadMessages() stops there.
+  const int valid = static_cast<int>(
+      std::find(parsed.get(), parsed.get() + count, false) - parsed.get());
+  if (arena == nullptr) {
+    for (int i = valid; i < count; i++) delete (*messages)[first + i];
+  }
+  messages->resize(first + valid);
+  return valid;
+}
+
 }  // namespace util
 }  // namespace protobuf
 }  // namespace google
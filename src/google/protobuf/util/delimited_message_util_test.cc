@@ -10,10 +10,19 @@
 
 #include "google/protobuf/util/delimited_message_util.h"
 
+#include <climits>
+#include <cstdint>
+#include <functional>
 #include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "google/protobuf/testing/googletest.h"
 #include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/test_util.h"
 #include "google/protobuf/unittest.pb.h"
 
@@ -88,6 +97,191 @@ TEST(DelimitedMessageUtilTest, FailsAtEndOfStream) {
   }
 }
 
+// Writes `count` messages, the i-th one with c = i.
+std::string WriteForeignMessages(int count) {
+  std::string data;
+  io::StringOutputStream output(&data);
+  protobuf_unittest::ForeignMessage message;
+  for (int i = 0; i < count; i++) {
+    message.set_c(i);
+    EXPECT_TRUE(SerializeDelimitedToZeroCopyStream(message, &output));
+  }
+  return data;
+}
+
+TEST(DelimitedMessageReaderTest, ReadMessage) {
+  std::stringstream stream;
+  protobuf_unittest::TestAllTypes message1;
+  TestUtil::SetAllFields(&message1);
+  EXPECT_TRUE(SerializeDelimitedToOstream(message1, &stream));
+  protobuf_unittest::TestPackedTypes message2;
+  TestUtil::SetPackedFields(&message2);
+  EXPECT_TRUE(SerializeDelimitedToOstream(message2, &stream));
+  // Replaces the fields of the previous message.
+  protobuf_unittest::TestAllTypes message3;
+  message3.set_optional_int32(3);
+  EXPECT_TRUE(SerializeDelimitedToOstream(message3, &stream));
+
+  // Small blocks, so that messages span several of them.
+  io::IstreamInputStream zstream(&stream, 7);
+  DelimitedMessageReader reader(&zstream);
+  protobuf_unittest::TestAllTypes all_types;
+  ASSERT_TRUE(reader.ReadMessage(&all_types));
+  TestUtil::ExpectAllFieldsSet(all_types);
+  protobuf_unittest::TestPackedTypes packed_types;
+  ASSERT_TRUE(reader.ReadMessage(&packed_types));
+  TestUtil::ExpectPackedFieldsSet(packed_types);
+  ASSERT_TRUE(reader.ReadMessage(&all_types));
+  EXPECT_EQ(all_types.optional_int32(), 3);
+  EXPECT_FALSE(all_types.has_optional_string());
+  EXPECT_FALSE(reader.ReadMessage(&all_types));
+  EXPECT_TRUE(reader.clean_eof());
+}
+
+TEST(DelimitedMessageReaderTest, ReadMessages) {
+  const std::string data = WriteForeignMessages(1000);
+  io::ArrayInputStream input(data.data(), static_cast<int>(data.size()), 100);
+  DelimitedMessageReader reader(&input);
+  Arena arena;
+  std::vector<MessageLite*> messages;
+  EXPECT_EQ(reader.ReadMessages(protobuf_unittest::ForeignMessage(), &arena,
+                                600, &messages),
+            600);
+  EXPECT_EQ(reader.ReadMessages(protobuf_unittest::ForeignMessage(), &arena,
+                                600, &messages),
+            400);
+  EXPECT_TRUE(reader.clean_eof());
+  ASSERT_EQ(messages.size(), size_t{1000});
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(messages[i]->GetArena(), &arena);
+    EXPECT_EQ(
+        static_cast<protobuf_unittest::ForeignMessage*>(messages[i])->c(), i);
+  }
+}
+
+TEST(DelimitedMessageReaderTest, ReadMessagesParallel) {
+  const std::string data = WriteForeignMessages(1000);
+  io::ArrayInputStream input(data.data(), static_cast<int>(data.size()), 100);
+  DelimitedMessageReader reader(&input);
+  std::vector<std::thread> threads;
+  auto executor = [&threads](std::function<void()> task) {
+    threads.emplace_back(std::move(task));
+  };
+  std::vector<MessageLite*> messages;
+  EXPECT_EQ(reader.ReadMessagesParallel(protobuf_unittest::ForeignMessage(),
+                                        nullptr, 2000, 64, executor,
+                                        &messages),
+            1000);
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(threads.size(), size_t{16});
+  EXPECT_TRUE(reader.clean_eof());
+  ASSERT_EQ(messages.size(), size_t{1000});
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(
+        static_cast<protobuf_unittest::ForeignMessage*>(messages[i])->c(), i);
+    delete messages[i];
+  }
+}
+
+TEST(DelimitedMessageReaderTest, FailsAtEndOfStream) {
+  std::string data = WriteForeignMessages(3);
+  data.pop_back();
+
+  {
+    io::ArrayInputStream input(data.data(), static_cast<int>(data.size()));
+    DelimitedMessageReader reader(&input);
+    protobuf_unittest::ForeignMessage message;
+    EXPECT_TRUE(reader.ReadMessage(&message));
+    EXPECT_TRUE(reader.ReadMessage(&message));
+    EXPECT_FALSE(reader.ReadMessage(&message));
+    EXPECT_FALSE(reader.clean_eof());
+  }
+  {
+    io::ArrayInputStream input(data.data(), static_cast<int>(data.size()));
+    DelimitedMessageReader reader(&input);
+    std::vector<MessageLite*> messages;
+    auto executor = [](std::function<void()> task) { task(); };
+    EXPECT_EQ(reader.ReadMessagesParallel(protobuf_unittest::ForeignMessage(),
+                                          nullptr, 10, 1, executor,
+                                          &messages),
+              2);
+    EXPECT_FALSE(reader.clean_eof());
+    for (MessageLite* message : messages) delete message;
+  }
+}
+
+TEST(DelimitedMessageReaderTest, BacksUpUnreadData) {
+  std::string data = WriteForeignMessages(2);
+  const size_t first_size = data.size() / 2;
+  data += "trailing data";
+  io::ArrayInputStream input(data.data(), static_cast<int>(data.size()));
+  {
+    DelimitedMessageReader reader(&input);
+    protobuf_unittest::ForeignMessage message;
+    EXPECT_TRUE(reader.ReadMessage(&message));
+  }
+  EXPECT_EQ(input.ByteCount(), static_cast<int64_t>(first_size));
+}
+
+// Returns `block` `count` times, without storing the copies.
+class RepeatingInputStream : public io::ZeroCopyInputStream {
+ public:
+  RepeatingInputStream(absl::string_view block, int count)
+      : block_(block), remaining_(count) {}
+
+  bool Next(const void** data, int* size) override {
+    if (position_ == static_cast<int>(block_.size())) {
+      if (remaining_ == 0) return false;
+      --remaining_;
+      position_ = 0;
+    }
+    *data = block_.data() + position_;
+    *size = static_cast<int>(block_.size()) - position_;
+    position_ = static_cast<int>(block_.size());
+    byte_count_ += *size;
+    return true;
+  }
+  void BackUp(int count) override {
+    position_ -= count;
+    byte_count_ -= count;
+  }
+  bool Skip(int count) override { return false; }
+  int64_t ByteCount() const override { return byte_count_; }
+
+ private:
+  absl::string_view block_;
+  int remaining_;
+  int position_ = static_cast<int>(block_.size());
+  int64_t byte_count_ = 0;
+};
+
+TEST(DelimitedMessageReaderTest, ReadsPast2GB) {
+  std::string block;
+  {
+    io::StringOutputStream output(&block);
+    protobuf_unittest::TestAllTypes message;
+    message.set_optional_bytes(std::string(4000, 'x'));
+    for (int i = 0; i < 500; i++) {
+      message.set_optional_int32(i);
+      EXPECT_TRUE(SerializeDelimitedToZeroCopyStream(message, &output));
+    }
+  }
+  // A bit more than 2GB in total.
+  const int kBlocks =
+      static_cast<int>((int64_t{INT_MAX} + (1 << 28)) / block.size() + 1);
+  RepeatingInputStream input(block, kBlocks);
+  DelimitedMessageReader reader(&input);
+  protobuf_unittest::TestAllTypes message;
+  int64_t count = 0;
+  while (reader.ReadMessage(&message)) {
+    ASSERT_EQ(message.optional_int32(), count % 500);
+    ++count;
+  }
+  EXPECT_TRUE(reader.clean_eof());
+  EXPECT_EQ(count, int64_t{kBlocks} * 500);
+  EXPECT_GT(input.ByteCount(), INT_MAX);
+}
+
 }  // namespace util
 }  // namespace protobuf
 }  // namespace google
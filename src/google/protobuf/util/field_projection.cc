@@ -0,0 +1,234 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/field_projection.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/field_mask.pb.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/absl_check.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/util/field_mask_util.h"
+#include "google/protobuf/wire_format_lite.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+using ::google::protobuf::internal::WireFormatLite;
+
+FieldProjection::FieldProjection(const Descriptor* descriptor)
+    : descriptor_(descriptor) {
+  NewNode();
+}
+
+FieldProjection::~FieldProjection() = default;
+
+FieldProjection::Node* FieldProjection::NewNode() {
+  nodes_.push_back(std::make_unique<Node>());
+  return nodes_.back().get();
+}
+
+void FieldProjection::AddPath(absl::Span<const FieldDescriptor* const> path) {
+  Node* node = nodes_[0].get();
+  for (size_t i = 0; i < path.size(); ++i) {
+    const int number = path[i]->number();
+    if (i + 1 == path.size()) {
+      // Selecting a field selects everything below it.
+      node->fields[number] = nullptr;
+      return;
+    }
+    auto it = node->fields.find(number);
+    if (it == node->fields.end()) {
+      Node* child = NewNode();
+      node->fields.emplace(number, child);
+      node = child;
+    } else if (it->second == nullptr) {
+      // The whole field is already selected.
+      return;
+    } else {
+      node = const_cast<Node*>(it->second);
+    }
+  }
+}
+
+std::unique_ptr<FieldProjection> FieldProjection::FromFieldMask(
+    const Descriptor* descriptor, const FieldMask& mask) {
+  std::unique_ptr<FieldProjection> projection(new FieldProjection(descriptor));
+  std::vector<const FieldDescriptor*> path;
+  for (const std::string& mask_path : mask.paths()) {
+    if (!FieldMaskUtil::GetFieldDescriptors(descriptor, mask_path, &path)) {
+      return nullptr;
+    }
+    projection->AddPath(path);
+  }
+  return projection;
+}
+
+std::unique_ptr<FieldProjection> FieldProjection::FromFields(
+    const Descriptor* descriptor,
+    absl::Span<const FieldDescriptor* const> fields) {
+  std::unique_ptr<FieldProjection> projection(new FieldProjection(descriptor));
+  for (const FieldDescriptor* field : fields) {
+    if (field->containing_type() != descriptor || field->is_extension()) {
+      return nullptr;
+    }
+    projection->AddPath({field});
+  }
+  return projection;
+}
+
+const FieldProjection* FieldProjection::Cached(const Descriptor* descriptor,
+                                               const FieldMask& mask) {
+  struct Cache {
+    absl::Mutex mutex;
+    absl::flat_hash_map<std::pair<const Descriptor*, std::string>,
+                        std::unique_ptr<FieldProjection>>
+        projections ABSL_GUARDED_BY(mutex);
+  };
+  static Cache* const cache = new Cache();
+
+  FieldMask canonical;
+  FieldMaskUtil::ToCanonicalForm(mask, &canonical);
+  auto key = std::make_pair(descriptor, FieldMaskUtil::ToString(canonical));
+
+  absl::MutexLock lock(&cache->mutex);
+  auto it = cache->projections.find(key);
+  if (it == cache->projections.end()) {
+    // Invalid masks are cached too, as nullptr.
+    it = cache->projections
+             .emplace(std::move(key), FromFieldMask(descriptor, canonical))
+             .first;
+  }
+  return it->second.get();
+}
+
+bool FieldProjection::ParsePartialFromString(absl::string_view data,
+                                             Message* message) const {
+  io::CodedInputStream input(reinterpret_cast<const uint8_t*>(data.data()),
+                             static_cast<int>(data.size()));
+  return ParsePartialFromCodedStream(&input, message);
+}
+
+bool FieldProjection::ParsePartialFromZeroCopyStream(
+    io::ZeroCopyInputStream* input, Message* message) const {
+  io::CodedInputStream coded_input(input);
+  return ParsePartialFromCodedStream(&coded_input, message);
+}
+
+bool FieldProjection::ParsePartialFromCodedStream(io::CodedInputStream* input,
+                                                  Message* message) const {
+  ABSL_DCHECK_EQ(message->GetDescriptor(), descriptor_);
+  message->Clear();
+  // The selected fields are usually a small part of the input, so copying
+  // them out and handing them to the regular parser is cheap.
+  std::string selected;
+  {
+    io::StringOutputStream string_output(&selected);
+    io::CodedOutputStream output(&string_output);
+    if (!Filter(*nodes_[0], input, &output) ||
+        !input->ConsumedEntireMessage()) {
+      return false;
+    }
+  }
+  return message->ParsePartialFromString(selected);
+}
+
+bool FieldProjection::Filter(const Node& node, io::CodedInputStream* input,
+                             io::CodedOutputStream* output) const {
+  while (true) {
+    const uint32_t tag = input->ReadTag();
+    if (tag == 0) return true;
+    if (WireFormatLite::GetTagWireType(tag) ==
+        WireFormatLite::WIRETYPE_END_GROUP) {
+      return true;
+    }
+
+    auto it = node.fields.find(WireFormatLite::GetTagFieldNumber(tag));
+    if (it == node.fields.end()) {
+      if (!WireFormatLite::SkipField(input, tag)) return false;
+    } else if (it->second == nullptr) {
+      // SkipField() copies what it skips, tag included.
+      if (!WireFormatLite::SkipField(input, tag, output)) return false;
+    } else {
+      if (!FilterSubMessage(*it->second, tag, input, output)) return false;
+    }
+  }
+}
+
+bool FieldProjection::FilterSubMessage(const Node& node, uint32_t tag,
+                                       io::CodedInputStream* input,
+                                       io::CodedOutputStream* output) const {
+  switch (WireFormatLite::GetTagWireType(tag)) {
+    case WireFormatLite::WIRETYPE_LENGTH_DELIMITED: {
+      uint32_t length;
+      if (!input->ReadVarint32(&length)) return false;
+      // PushLimit() ignores negative limits, which would let the sub-message
+      // run past its end.
+      if (length > static_cast<uint32_t>(std::numeric_limits<int>::max())) {
+        return false;
+      }
+      if (!input->IncrementRecursionDepth()) return false;
+      io::CodedInputStream::Limit limit =
+          input->PushLimit(static_cast<int>(length));
+      std::string selected;
+      bool ok;
+      {
+        io::StringOutputStream string_output(&selected);
+        io::CodedOutputStream sub_output(&string_output);
+        ok = Filter(node, input, &sub_output) &&
+             input->ConsumedEntireMessage();
+      }
+      input->PopLimit(limit);
+      input->DecrementRecursionDepth();
+      if (!ok) return false;
+      // An empty result still sets the field.
+      output->WriteTag(tag);
+      output->WriteVarint32(static_cast<uint32_t>(selected.size()));
+      output->WriteString(selected);
+      return true;
+    }
+    case WireFormatLite::WIRETYPE_START_GROUP: {
+      if (!input->IncrementRecursionDepth()) return false;
+      output->WriteTag(tag);
+      const uint32_t end_tag = WireFormatLite::MakeTag(
+          WireFormatLite::GetTagFieldNumber(tag),
+          WireFormatLite::WIRETYPE_END_GROUP);
+      const bool ok = Filter(node, input, output) && input->LastTagWas(end_tag);
+      input->DecrementRecursionDepth();
+      if (!ok) return false;
+      output->WriteTag(end_tag);
+      return true;
+    }
+    default:
+      // Wrong wire type for a message. Let the parser deal with it.
+      return WireFormatLite::SkipField(input, tag, output);
+  }
+}
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
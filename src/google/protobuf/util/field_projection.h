@@ -0,0 +1,123 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// Defines FieldProjection, which parses only selected fields of a message.
+
+#ifndef GOOGLE_PROTOBUF_UTIL_FIELD_PROJECTION_H__
+#define GOOGLE_PROTOBUF_UTIL_FIELD_PROJECTION_H__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "google/protobuf/field_mask.pb.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+// A FieldProjection is a FieldMask compiled for one message type. Parsing
+// through it only materializes the selected fields: everything else is skipped
+// on the wire, including whole sub-messages, and is not kept as unknown
+// fields either.
+//
+// For example, to read two fields out of a large message:
+//
+//   static const FieldProjection* const projection = [] {
+//     FieldMask mask;
+//     FieldMaskUtil::FromString("id,header.timestamp", &mask);
+//     return FieldProjection::Cached(Event::descriptor(), mask);
+//   }();
+//   Event event;
+//   if (!projection->ParsePartialFromString(data, &event)) { ... }
+//
+// Selecting a message field selects all of its sub-fields. As in FieldMask,
+// paths can only traverse singular message fields.
+//
+// Required fields that are not selected will be missing, so only the
+// "Partial" flavor of parsing is provided.
+//
+// A FieldProjection is immutable once built and may be shared between threads.
+class PROTOBUF_EXPORT FieldProjection {
+ public:
+  FieldProjection(const FieldProjection&) = delete;
+  FieldProjection& operator=(const FieldProjection&) = delete;
+  ~FieldProjection();
+
+  // Compiles `mask` for messages of type `descriptor`. Returns nullptr if a
+  // path is not valid for `descriptor`.
+  static std::unique_ptr<FieldProjection> FromFieldMask(
+      const Descriptor* descriptor, const FieldMask& mask);
+
+  // Builds a projection that selects `fields`, which must all be fields of
+  // `descriptor`. Returns nullptr otherwise.
+  static std::unique_ptr<FieldProjection> FromFields(
+      const Descriptor* descriptor,
+      absl::Span<const FieldDescriptor* const> fields);
+
+  // Like FromFieldMask(), but compiles each distinct (descriptor, mask) pair
+  // only once. The returned projection lives until the program exits.
+  //
+  // Each call canonicalizes `mask` and looks it up under a global lock, which
+  // can cost more than parsing a small message. Look the projection up once
+  // and keep the pointer rather than calling this for every parse.
+  static const FieldProjection* Cached(const Descriptor* descriptor,
+                                       const FieldMask& mask);
+
+  const Descriptor* descriptor() const { return descriptor_; }
+
+  // Clears `message` and parses the selected fields of `data` into it.
+  // `message` must be of type descriptor(). Returns false if `data` is not
+  // valid wire format; unselected fields are only checked structurally.
+  bool ParsePartialFromString(absl::string_view data, Message* message) const;
+  bool ParsePartialFromZeroCopyStream(io::ZeroCopyInputStream* input,
+                                      Message* message) const;
+
+ private:
+  struct Node {
+    // Selected field numbers. A null child selects the whole field.
+    absl::flat_hash_map<int, const Node*> fields;
+  };
+
+  explicit FieldProjection(const Descriptor* descriptor);
+
+  Node* NewNode();
+  // Selects the field path `path`, starting at the root.
+  void AddPath(absl::Span<const FieldDescriptor* const> path);
+
+  bool ParsePartialFromCodedStream(io::CodedInputStream* input,
+                                   Message* message) const;
+  // Copies the fields of `input` that `node` selects to `output`. Stops at
+  // the end of input, a limit, or an end-group tag.
+  bool Filter(const Node& node, io::CodedInputStream* input,
+              io::CodedOutputStream* output) const;
+  bool FilterSubMessage(const Node& node, uint32_t tag,
+                        io::CodedInputStream* input,
+                        io::CodedOutputStream* output) const;
+
+  const Descriptor* descriptor_;
+  // nodes_[0] is the root.
+  std::vector<std::unique_ptr<Node>> nodes_;
+};
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_UTIL_FIELD_PROJECTION_H__
@@ -0,0 +1,161 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/field_projection.h"
+
+#include <memory>
+#include <string>
+
+#include "google/protobuf/field_mask.pb.h"
+#include <gtest/gtest.h>
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/test_util.h"
+#include "google/protobuf/unittest.pb.h"
+#include "google/protobuf/util/field_mask_util.h"
+
+namespace google {
+namespace protobuf {
+namespace util {
+namespace {
+
+using ::protobuf_unittest::TestAllTypes;
+
+FieldMask MaskFromString(absl::string_view paths) {
+  FieldMask mask;
+  FieldMaskUtil::FromString(paths, &mask);
+  return mask;
+}
+
+std::string AllFieldsSerialized() {
+  TestAllTypes message;
+  TestUtil::SetAllFields(&message);
+  return message.SerializeAsString();
+}
+
+TEST(FieldProjectionTest, ParsesOnlySelectedFields) {
+  auto projection = FieldProjection::FromFieldMask(
+      TestAllTypes::descriptor(),
+      MaskFromString("optional_int32,optional_foreign_message,"
+                     "optional_nested_message.bb,optionalgroup.a"));
+  ASSERT_NE(projection, nullptr);
+
+  TestAllTypes message;
+  ASSERT_TRUE(projection->ParsePartialFromString(AllFieldsSerialized(),
+                                                 &message));
+
+  TestAllTypes full;
+  TestUtil::SetAllFields(&full);
+  TestAllTypes expected;
+  expected.set_optional_int32(full.optional_int32());
+  *expected.mutable_optional_foreign_message() =
+      full.optional_foreign_message();
+  expected.mutable_optional_nested_message()->set_bb(
+      full.optional_nested_message().bb());
+  expected.mutable_optionalgroup()->set_a(full.optionalgroup().a());
+  EXPECT_EQ(message.SerializeAsString(), expected.SerializeAsString());
+  // Unselected fields are dropped, not kept as unknown fields.
+  EXPECT_TRUE(message.GetReflection()->GetUnknownFields(message).empty());
+}
+
+TEST(FieldProjectionTest, ParentPathSelectsWholeField) {
+  auto projection = FieldProjection::FromFieldMask(
+      TestAllTypes::descriptor(),
+      MaskFromString("optional_nested_message.bb,optional_nested_message"));
+  ASSERT_NE(projection, nullptr);
+
+  TestAllTypes source;
+  source.mutable_optional_nested_message()->set_bb(1);
+  source.set_optional_string("dropped");
+  TestAllTypes message;
+  ASSERT_TRUE(projection->ParsePartialFromString(source.SerializeAsString(),
+                                                 &message));
+  EXPECT_EQ(message.optional_nested_message().SerializeAsString(),
+            source.optional_nested_message().SerializeAsString());
+  EXPECT_FALSE(message.has_optional_string());
+}
+
+TEST(FieldProjectionTest, EmptySubMessageKeepsPresence) {
+  auto projection = FieldProjection::FromFieldMask(
+      TestAllTypes::descriptor(), MaskFromString("optional_nested_message.bb"));
+  ASSERT_NE(projection, nullptr);
+
+  TestAllTypes source;
+  source.mutable_optional_nested_message();
+  TestAllTypes message;
+  ASSERT_TRUE(projection->ParsePartialFromString(source.SerializeAsString(),
+                                                 &message));
+  EXPECT_TRUE(message.has_optional_nested_message());
+}
+
+TEST(FieldProjectionTest, FromFields) {
+  const Descriptor* descriptor = TestAllTypes::descriptor();
+  auto projection = FieldProjection::FromFields(
+      descriptor, {descriptor->FindFieldByName("repeated_string"),
+                   descriptor->FindFieldByName("optional_bytes")});
+  ASSERT_NE(projection, nullptr);
+
+  const std::string data = AllFieldsSerialized();
+  io::ArrayInputStream input(data.data(), static_cast<int>(data.size()),
+                             /* block_size= */ 7);
+  TestAllTypes message;
+  ASSERT_TRUE(projection->ParsePartialFromZeroCopyStream(&input, &message));
+  EXPECT_EQ(message.repeated_string_size(), 2);
+  EXPECT_TRUE(message.has_optional_bytes());
+  EXPECT_FALSE(message.has_optional_int32());
+  EXPECT_EQ(message.repeated_int32_size(), 0);
+
+  EXPECT_EQ(FieldProjection::FromFields(
+                descriptor,
+                {TestAllTypes::NestedMessage::descriptor()->field(0)}),
+            nullptr);
+}
+
+TEST(FieldProjectionTest, RejectsInvalidInput) {
+  auto projection = FieldProjection::FromFieldMask(
+      TestAllTypes::descriptor(), MaskFromString("optional_int32"));
+  ASSERT_NE(projection, nullptr);
+  TestAllTypes message;
+  // Unselected field 2 (optional_int64) with a truncated varint.
+  EXPECT_FALSE(
+      projection->ParsePartialFromString(std::string("\x10\x80", 2), &message));
+  // Stray end-group tag.
+  EXPECT_FALSE(projection->ParsePartialFromString("\x0c", &message));
+
+  auto nested = FieldProjection::FromFieldMask(
+      TestAllTypes::descriptor(), MaskFromString("optional_nested_message.bb"));
+  ASSERT_NE(nested, nullptr);
+  // optional_nested_message (field 18) with a length above INT_MAX, followed
+  // by a valid bb.
+  EXPECT_FALSE(nested->ParsePartialFromString(
+      std::string("\x92\x01\xff\xff\xff\xff\x0f\x08\x01", 9), &message));
+}
+
+TEST(FieldProjectionTest, InvalidMask) {
+  EXPECT_EQ(FieldProjection::FromFieldMask(TestAllTypes::descriptor(),
+                                           MaskFromString("no_such_field")),
+            nullptr);
+  EXPECT_EQ(FieldProjection::Cached(TestAllTypes::descriptor(),
+                                    MaskFromString("no_such_field")),
+            nullptr);
+}
+
+TEST(FieldProjectionTest, CachedProjectionsAreShared) {
+  const FieldProjection* a =
+      FieldProjection::Cached(TestAllTypes::descriptor(),
+                              MaskFromString("optional_int32,optional_string"));
+  const FieldProjection* b =
+      FieldProjection::Cached(TestAllTypes::descriptor(),
+                              MaskFromString("optional_string,optional_int32"));
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a->descriptor(), TestAllTypes::descriptor());
+}
+
+}  // namespace
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
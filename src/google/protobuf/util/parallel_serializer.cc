@@ -0,0 +1,233 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/parallel_serializer.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_check.h"
+#include "absl/log/absl_log.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/internal/resize_uninitialized.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/descriptor.pb.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/wire_format.h"
+#include "google/protobuf/wire_format_lite.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+using ::google::protobuf::internal::WireFormat;
+using ::google::protobuf::internal::WireFormatLite;
+
+namespace {
+
+// A contiguous part of the output: either a run of fields serialized by the
+// calling thread, or the elements [begin, end) of a split field, serialized by
+// a task.
+struct Piece {
+  std::vector<const FieldDescriptor*> fields;
+  const FieldDescriptor* split_field = nullptr;
+  int begin = 0;
+  int end = 0;
+
+  std::string data;
+  bool ok = false;
+};
+
+// Resizes `output` to `size` and fills it with `write`, which takes and
+// returns the write position like _InternalSerialize().
+template <typename Write>
+bool WriteExactly(size_t size, bool deterministic, std::string* output,
+                  const Write& write) {
+  if (size > INT_MAX) return false;
+  absl::strings_internal::STLStringResizeUninitialized(output, size);
+  uint8_t* start = reinterpret_cast<uint8_t*>(&(*output)[0]);
+  io::EpsCopyOutputStream stream(start, static_cast<int>(size), deterministic);
+  uint8_t* end = write(start, &stream);
+  ABSL_DCHECK_EQ(static_cast<size_t>(end - start), size);
+  (void)end;
+  return true;
+}
+
+bool SerializeFields(const Message& message, bool deterministic,
+                     Piece* piece) {
+  size_t size = 0;
+  for (const FieldDescriptor* field : piece->fields) {
+    size += WireFormat::FieldByteSize(field, message);
+  }
+  return WriteExactly(
+      size, deterministic, &piece->data,
+      [&](uint8_t* target, io::EpsCopyOutputStream* stream) {
+        for (const FieldDescriptor* field : piece->fields) {
+          target = WireFormat::InternalSerializeField(field, message, target,
+                                                      stream);
+        }
+        return target;
+      });
+}
+
+// Same as the serial path, but restricted to some elements.
+bool SerializeChunk(const Message& message, bool deterministic, Piece* piece) {
+  const Reflection* reflection = message.GetReflection();
+  const FieldDescriptor* field = piece->split_field;
+  const bool is_group = field->type() == FieldDescriptor::TYPE_GROUP;
+  const size_t tag_size = WireFormat::TagSize(field->number(), field->type());
+  size_t size = 0;
+  for (int i = piece->begin; i < piece->end; i++) {
+    const size_t element_size =
+        reflection->GetRepeatedMessage(message, field, i).ByteSizeLong();
+    size += tag_size + (is_group ? element_size
+                                 : WireFormatLite::LengthDelimitedSize(
+                                       element_size));
+  }
+  return WriteExactly(
+      size, deterministic, &piece->data,
+      [&](uint8_t* target, io::EpsCopyOutputStream* stream) {
+        for (int i = piece->begin; i < piece->end; i++) {
+          const Message& element =
+              reflection->GetRepeatedMessage(message, field, i);
+          target = is_group ? WireFormatLite::InternalWriteGroup(
+                                  field->number(), element, target, stream)
+                            : WireFormatLite::InternalWriteMessage(
+                                  field->number(), element,
+                                  element.GetCachedSize(), target, stream);
+        }
+        return target;
+      });
+}
+
+bool SerializeUnknownFields(const Message& message, bool deterministic,
+                            std::string* output) {
+  const UnknownFieldSet& unknown_fields =
+      message.GetReflection()->GetUnknownFields(message);
+  if (message.GetDescriptor()->options().message_set_wire_format()) {
+    return WriteExactly(
+        WireFormat::ComputeUnknownMessageSetItemsSize(unknown_fields),
+        deterministic, output,
+        [&](uint8_t* target, io::EpsCopyOutputStream* stream) {
+          return WireFormat::InternalSerializeUnknownMessageSetItemsToArray(
+              unknown_fields, target, stream);
+        });
+  }
+  return WriteExactly(
+      WireFormat::ComputeUnknownFieldsSize(unknown_fields), deterministic,
+      output, [&](uint8_t* target, io::EpsCopyOutputStream* stream) {
+        return WireFormat::InternalSerializeUnknownFieldsToArray(
+            unknown_fields, target, stream);
+      });
+}
+
+}  // namespace
+
+bool SerializePartialParallelToCord(const Message& message,
+                                    SerializationExecutor executor,
+                                    absl::Cord* output,
+                                    const ParallelSerializeOptions& options) {
+  ABSL_CHECK_GT(options.chunk_size, 0);
+  const Descriptor* descriptor = message.GetDescriptor();
+  const Reflection* reflection = message.GetReflection();
+
+  std::vector<const FieldDescriptor*> fields;
+  // Fields of map entry should always be serialized.
+  if (descriptor->options().map_entry()) {
+    for (int i = 0; i < descriptor->field_count(); i++) {
+      fields.push_back(descriptor->field(i));
+    }
+  } else {
+    reflection->ListFields(message, &fields);
+  }
+
+  // Cut the fields into pieces, in output order.
+  std::vector<Piece> pieces(1);
+  int num_chunks = 0;
+  for (const FieldDescriptor* field : fields) {
+    const int count =
+        field->is_repeated() ? reflection->FieldSize(message, field) : 0;
+    if (field->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE ||
+        !field->is_repeated() || field->is_map() ||
+        count < options.min_elements_to_split) {
+      pieces.back().fields.push_back(field);
+      continue;
+    }
+    for (int begin = 0; begin < count; begin += options.chunk_size) {
+      pieces.emplace_back();
+      pieces.back().split_field = field;
+      pieces.back().begin = begin;
+      pieces.back().end = begin + std::min(options.chunk_size, count - begin);
+      ++num_chunks;
+    }
+    pieces.emplace_back();
+  }
+
+  // Start the tasks first, so that they overlap with the serial work.
+  absl::BlockingCounter pending(num_chunks);
+  for (Piece& piece : pieces) {
+    if (piece.split_field == nullptr) continue;
+    Piece* chunk = &piece;
+    executor([&message, &options, &pending, chunk] {
+      chunk->ok = SerializeChunk(message, options.deterministic, chunk);
+      pending.DecrementCount();
+    });
+  }
+  for (Piece& piece : pieces) {
+    if (piece.split_field != nullptr) continue;
+    piece.ok = SerializeFields(message, options.deterministic, &piece);
+  }
+  std::string unknown_fields;
+  bool ok = SerializeUnknownFields(message, options.deterministic,
+                                   &unknown_fields);
+  pending.Wait();
+
+  size_t size = unknown_fields.size();
+  for (const Piece& piece : pieces) {
+    ok = ok && piece.ok;
+    size += piece.data.size();
+  }
+  if (!ok || size > INT_MAX) {
+    ABSL_LOG(ERROR) << message.GetTypeName()
+                    << " exceeded maximum protobuf size of 2GB";
+    return false;
+  }
+
+  output->Clear();
+  for (Piece& piece : pieces) {
+    output->Append(std::move(piece.data));
+  }
+  output->Append(std::move(unknown_fields));
+  return true;
+}
+
+bool SerializePartialParallelToZeroCopyStream(
+    const Message& message, SerializationExecutor executor,
+    io::ZeroCopyOutputStream* output,
+    const ParallelSerializeOptions& options) {
+  absl::Cord cord;
+  return SerializePartialParallelToCord(message, executor, &cord, options) &&
+         output->WriteCord(cord);
+}
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
@@ -0,0 +1,70 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// Utilities for serializing very large messages on several threads.
+
+#ifndef GOOGLE_PROTOBUF_UTIL_PARALLEL_SERIALIZER_H__
+#define GOOGLE_PROTOBUF_UTIL_PARALLEL_SERIALIZER_H__
+
+#include <functional>
+
+#include "absl/functional/function_ref.h"
+#include "absl/strings/cord.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+// Runs `task`, typically by handing it to a thread pool. It may also run it
+// right away on the calling thread.
+using SerializationExecutor = absl::FunctionRef<void(std::function<void()>)>;
+
+struct ParallelSerializeOptions {
+  // Same as CodedOutputStream::SetSerializationDeterministic().
+  bool deterministic = false;
+  // Repeated message fields with at least this many elements are split into
+  // chunks that are serialized by separate tasks.
+  int min_elements_to_split = 4096;
+  // Elements per chunk.
+  int chunk_size = 4096;
+};
+
+// Serializes `message` like SerializePartialToCord(), except that the large
+// repeated message fields of the top-level message are split into chunks,
+// and every chunk is sized and serialized by a task run on `executor`. The
+// calling thread serializes the rest of the message meanwhile, and returns
+// once all tasks have finished. The output is the same as the serial path,
+// byte for byte, in deterministic mode too.
+//
+// The chunks are appended to `output` without being copied. Only the
+// top-level message is split; map fields are never split.
+//
+// Like ByteSizeLong(), this updates the cached sizes of the sub-messages, so
+// the message must not be serialized by another thread at the same time.
+PROTOBUF_EXPORT bool SerializePartialParallelToCord(
+    const Message& message, SerializationExecutor executor, absl::Cord* output,
+    const ParallelSerializeOptions& options = ParallelSerializeOptions());
+
+// Same as above, but writes to `output` with WriteCord(), which does not copy
+// for streams that hold Cords themselves.
+PROTOBUF_EXPORT bool SerializePartialParallelToZeroCopyStream(
+    const Message& message, SerializationExecutor executor,
+    io::ZeroCopyOutputStream* output,
+    const ParallelSerializeOptions& options = ParallelSerializeOptions());
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_UTIL_PARALLEL_SERIALIZER_H__
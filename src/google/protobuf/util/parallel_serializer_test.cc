@@ -0,0 +1,121 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/parallel_serializer.h"
+
+#include <functional>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/cord.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/test_util.h"
+#include "google/protobuf/unittest.pb.h"
+
+namespace google {
+namespace protobuf {
+namespace util {
+namespace {
+
+using ::protobuf_unittest::TestAllTypes;
+
+// Runs every task on a new thread and joins them on destruction.
+class ThreadExecutor {
+ public:
+  ~ThreadExecutor() {
+    for (std::thread& thread : threads_) thread.join();
+  }
+
+  void operator()(std::function<void()> task) {
+    threads_.emplace_back(std::move(task));
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+};
+
+TestAllTypes LargeMessage() {
+  TestAllTypes message;
+  TestUtil::SetAllFields(&message);
+  for (int i = 0; i < 1000; i++) {
+    message.add_repeated_nested_message()->set_bb(i);
+    message.add_repeatedgroup()->set_a(i);
+  }
+  // Unknown fields come last.
+  message.GetReflection()->MutableUnknownFields(&message)->AddVarint(12345, 1);
+  return message;
+}
+
+std::string SerialOutput(const TestAllTypes& message, bool deterministic) {
+  std::string data;
+  io::StringOutputStream output(&data);
+  io::CodedOutputStream coded_output(&output);
+  coded_output.SetSerializationDeterministic(deterministic);
+  message.SerializePartialToCodedStream(&coded_output);
+  return data;
+}
+
+TEST(ParallelSerializerTest, MatchesSerialOutput) {
+  const TestAllTypes message = LargeMessage();
+  ParallelSerializeOptions options;
+  options.min_elements_to_split = 100;
+  // Not a divisor of the field sizes, so the last chunk is shorter.
+  options.chunk_size = 77;
+
+  for (bool deterministic : {false, true}) {
+    SCOPED_TRACE(deterministic);
+    options.deterministic = deterministic;
+    absl::Cord cord;
+    {
+      ThreadExecutor executor;
+      ASSERT_TRUE(SerializePartialParallelToCord(
+          message, std::ref(executor), &cord, options));
+    }
+    EXPECT_EQ(cord, SerialOutput(message, deterministic));
+  }
+}
+
+TEST(ParallelSerializerTest, InlineExecutorAndSmallFields) {
+  TestAllTypes message;
+  TestUtil::SetAllFields(&message);
+  auto run_inline = [](std::function<void()> task) { task(); };
+
+  // Nothing is large enough to split.
+  absl::Cord cord;
+  ASSERT_TRUE(SerializePartialParallelToCord(message, run_inline, &cord));
+  EXPECT_EQ(cord, message.SerializeAsString());
+
+  // Everything is split.
+  ParallelSerializeOptions options;
+  options.min_elements_to_split = 1;
+  options.chunk_size = 1;
+  ASSERT_TRUE(
+      SerializePartialParallelToCord(message, run_inline, &cord, options));
+  EXPECT_EQ(cord, message.SerializeAsString());
+}
+
+TEST(ParallelSerializerTest, ZeroCopyStream) {
+  const TestAllTypes message = LargeMessage();
+  ParallelSerializeOptions options;
+  options.min_elements_to_split = 100;
+  std::string data;
+  {
+    io::StringOutputStream output(&data);
+    ThreadExecutor executor;
+    ASSERT_TRUE(SerializePartialParallelToZeroCopyStream(
+        message, std::ref(executor), &output, options));
+  }
+  EXPECT_EQ(data, SerialOutput(message, false));
+}
+
+}  // namespace
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
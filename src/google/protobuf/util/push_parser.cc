@@ -0,0 +1,186 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/push_parser.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/message_lite.h"
+#include "google/protobuf/wire_format_lite.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+using ::google::protobuf::internal::WireFormatLite;
+
+PushParser::PushParser(MessageLite* message, Framing framing)
+    : message_(message),
+      framing_(framing),
+      phase_(framing == kDelimited ? kSize : kTag) {}
+
+PushParser::Status PushParser::Feed(absl::string_view chunk) {
+  if (status_ != kNeedMore) return status_;
+  buffer_.append(chunk.data(), chunk.size());
+  return Scan(buffer_.size());
+}
+
+PushParser::Status PushParser::Finish() {
+  if (status_ != kNeedMore) return status_;
+  // A kDelimited parse that completed has already returned kDone.
+  if (framing_ == kDelimited || !AtFieldBoundary()) return Fail();
+  if (!MergeComplete()) return Fail();
+  return status_ = kDone;
+}
+
+absl::string_view PushParser::Remaining() const {
+  if (framing_ != kDelimited || status_ != kDone) return absl::string_view();
+  return absl::string_view(buffer_).substr(message_end_);
+}
+
+bool PushParser::AccumulateVarint(uint8_t byte, int max_bytes) {
+  if (varint_bytes_ == max_bytes) return false;
+  varint_ |= static_cast<uint64_t>(byte & 0x7F) << (7 * varint_bytes_);
+  ++varint_bytes_;
+  return true;
+}
+
+bool PushParser::MergeComplete() {
+  if (complete_ == 0) return true;
+  if (!message_->ParseFrom<MessageLite::kMergePartial>(
+          absl::string_view(buffer_.data(), complete_))) {
+    return false;
+  }
+  buffer_.erase(0, complete_);
+  scan_ -= complete_;
+  if (framing_ == kDelimited) message_end_ -= complete_;
+  complete_ = 0;
+  return true;
+}
+
+PushParser::Status PushParser::Scan(size_t end) {
+  static const size_t kMaxGroupDepth =
+      io::CodedInputStream::GetDefaultRecursionLimit();
+
+  size_t pos = scan_;
+  size_t start = scan_;
+  if (phase_ != kSize && framing_ == kDelimited) {
+    end = std::min(end, message_end_);
+  }
+
+  while (pos < end) {
+    if (phase_ == kSkip) {
+      // Bulk path: length-delimited payloads make up most of the input.
+      const size_t n =
+          static_cast<size_t>(std::min<uint64_t>(skip_, end - pos));
+      pos += n;
+      skip_ -= n;
+      if (skip_ == 0) {
+        phase_ = kTag;
+        if (groups_.empty()) complete_ = pos;
+      }
+      continue;
+    }
+
+    const uint8_t byte = static_cast<uint8_t>(buffer_[pos++]);
+    const int max_bytes = phase_ == kVarint || phase_ == kSize ? 10 : 5;
+    if (!AccumulateVarint(byte, max_bytes)) return Fail();
+    if (byte & 0x80) continue;
+    const uint64_t value = varint_;
+    varint_ = 0;
+    varint_bytes_ = 0;
+
+    switch (phase_) {
+      case kSize:
+        if (value > INT_MAX) return Fail();
+        // Drop the prefix so that the buffer starts with the message.
+        buffer_.erase(0, pos);
+        message_end_ = static_cast<size_t>(value);
+        pos = start = 0;
+        end = std::min(buffer_.size(), message_end_);
+        phase_ = kTag;
+        break;
+
+      case kTag: {
+        if (value > UINT32_MAX) return Fail();
+        const uint32_t tag = static_cast<uint32_t>(value);
+        const uint32_t number = WireFormatLite::GetTagFieldNumber(tag);
+        if (number == 0) return Fail();
+        switch (WireFormatLite::GetTagWireType(tag)) {
+          case WireFormatLite::WIRETYPE_VARINT:
+            phase_ = kVarint;
+            break;
+          case WireFormatLite::WIRETYPE_FIXED64:
+            skip_ = 8;
+            phase_ = kSkip;
+            break;
+          case WireFormatLite::WIRETYPE_LENGTH_DELIMITED:
+            phase_ = kLength;
+            break;
+          case WireFormatLite::WIRETYPE_START_GROUP:
+            if (groups_.size() >= kMaxGroupDepth) return Fail();
+            groups_.push_back(number);
+            break;
+          case WireFormatLite::WIRETYPE_END_GROUP:
+            if (groups_.empty() || groups_.back() != number) return Fail();
+            groups_.pop_back();
+            if (groups_.empty()) complete_ = pos;
+            break;
+          case WireFormatLite::WIRETYPE_FIXED32:
+            skip_ = 4;
+            phase_ = kSkip;
+            break;
+          default:
+            return Fail();
+        }
+        break;
+      }
+
+      case kVarint:
+        phase_ = kTag;
+        if (groups_.empty()) complete_ = pos;
+        break;
+
+      case kLength:
+        if (value > INT_MAX) return Fail();
+        skip_ = value;
+        phase_ = kSkip;
+        if (skip_ == 0) {
+          phase_ = kTag;
+          if (groups_.empty()) complete_ = pos;
+        }
+        break;
+
+      case kSkip:
+        PROTOBUF_ASSUME(false);
+    }
+  }
+
+  scan_ = pos;
+  if (phase_ != kSize) byte_count_ += pos - start;
+  if (!MergeComplete()) return Fail();
+
+  if (framing_ == kDelimited && phase_ != kSize && scan_ == message_end_) {
+    if (!AtFieldBoundary()) return Fail();
+    return status_ = kDone;
+  }
+  return kNeedMore;
+}
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
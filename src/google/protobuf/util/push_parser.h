@@ -0,0 +1,140 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// Defines PushParser, which parses a message from chunks of input as they
+// arrive instead of pulling them from a blocking stream.
+
+#ifndef GOOGLE_PROTOBUF_UTIL_PUSH_PARSER_H__
+#define GOOGLE_PROTOBUF_UTIL_PUSH_PARSER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/message_lite.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+// PushParser parses a message from input that is handed over one chunk at a
+// time, for example from an event loop that reads a socket without blocking:
+//
+//   PushParser parser(&request, PushParser::kDelimited);
+//   // Whenever data arrives:
+//   switch (parser.Feed(chunk)) {
+//     case PushParser::kNeedMore: return;  // Wait for more data.
+//     case PushParser::kDone: Handle(request); break;
+//     case PushParser::kError: Close(); break;
+//   }
+//
+// The parser tracks the wire format across chunk boundaries (a partially read
+// tag, varint or length-delimited field, and open groups). Every top-level
+// field is merged into the message as soon as its last byte arrives, so most
+// of the parsing happens while the rest of the input is still in flight. Only
+// the incomplete trailing field is buffered.
+//
+// Required fields are not checked; call IsInitialized() on the message if
+// needed.
+class PROTOBUF_EXPORT PushParser {
+ public:
+  enum Framing {
+    // The input is one message. Call Finish() at end of input.
+    kUnframed,
+    // The message is preceded by its size as a varint, as written by
+    // SerializeDelimitedToZeroCopyStream(). The parse is done once that many
+    // bytes have been fed.
+    kDelimited,
+  };
+
+  enum Status {
+    kNeedMore,
+    kDone,
+    kError,
+  };
+
+  // Parses into `message`, which is merged into rather than cleared. It must
+  // outlive the parser.
+  explicit PushParser(MessageLite* message, Framing framing = kUnframed);
+  PushParser(const PushParser&) = delete;
+  PushParser& operator=(const PushParser&) = delete;
+
+  // Consumes `chunk`. Once the result is kDone or kError, further calls
+  // return the same result without consuming anything.
+  Status Feed(absl::string_view chunk);
+
+  // Signals the end of input. For kUnframed this completes the parse; for
+  // kDelimited it reports kError unless the message is already complete.
+  Status Finish();
+
+  // Returns the bytes fed after the end of a kDelimited message, which
+  // belong to whatever follows it in the stream.
+  absl::string_view Remaining() const;
+
+  // Number of bytes of the message that have been fed so far, excluding the
+  // size prefix.
+  size_t ByteCount() const { return byte_count_; }
+
+ private:
+  enum Phase {
+    kSize,    // Reading the size prefix (kDelimited only).
+    kTag,     // Reading a tag.
+    kVarint,  // Reading a varint value.
+    kLength,  // Reading the length of a length-delimited field.
+    kSkip,    // Skipping `skip_` bytes of a fixed or length-delimited value.
+  };
+
+  // Scans `buffer_` from `scan_` up to `end` and merges complete top-level
+  // fields into the message.
+  Status Scan(size_t end);
+  // Appends one varint byte. Returns false if the varint is too long.
+  bool AccumulateVarint(uint8_t byte, int max_bytes);
+  // Merges buffer_[0, complete_) into the message and drops it.
+  bool MergeComplete();
+  // Returns true if the input ends on a field boundary.
+  bool AtFieldBoundary() const {
+    return phase_ == kTag && varint_bytes_ == 0 && groups_.empty();
+  }
+  Status Fail() { return status_ = kError; }
+
+  MessageLite* const message_;
+  const Framing framing_;
+  Status status_ = kNeedMore;
+  Phase phase_;
+
+  // Received bytes that are not merged yet. For kDelimited, the message ends
+  // at `message_end_`, and anything after it is Remaining().
+  std::string buffer_;
+  // Position up to which `buffer_` has been scanned.
+  size_t scan_ = 0;
+  // Position after the last complete top-level field.
+  size_t complete_ = 0;
+  size_t message_end_ = 0;
+  // Bytes of the message seen so far.
+  size_t byte_count_ = 0;
+
+  // Varint being read.
+  uint64_t varint_ = 0;
+  int varint_bytes_ = 0;
+  // Bytes left to skip in phase kSkip.
+  uint64_t skip_ = 0;
+  // Field numbers of open groups, innermost last.
+  std::vector<uint32_t> groups_;
+};
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_UTIL_PUSH_PARSER_H__
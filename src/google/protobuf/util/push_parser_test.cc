@@ -0,0 +1,145 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/push_parser.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/test_util.h"
+#include "google/protobuf/unittest.pb.h"
+#include "google/protobuf/util/delimited_message_util.h"
+
+namespace google {
+namespace protobuf {
+namespace util {
+namespace {
+
+using ::protobuf_unittest::TestAllTypes;
+
+std::string AllFieldsSerialized() {
+  TestAllTypes message;
+  TestUtil::SetAllFields(&message);
+  return message.SerializeAsString();
+}
+
+std::string Delimited(const MessageLite& message) {
+  std::string out;
+  io::StringOutputStream output(&out);
+  SerializeDelimitedToZeroCopyStream(message, &output);
+  return out;
+}
+
+class PushParserTest : public testing::TestWithParam<size_t> {};
+
+TEST_P(PushParserTest, Unframed) {
+  const std::string data = AllFieldsSerialized();
+  const size_t chunk_size = GetParam();
+  TestAllTypes message;
+  PushParser parser(&message);
+  for (size_t i = 0; i < data.size(); i += chunk_size) {
+    ASSERT_EQ(parser.Feed(absl::string_view(data).substr(i, chunk_size)),
+              PushParser::kNeedMore);
+  }
+  ASSERT_EQ(parser.Finish(), PushParser::kDone);
+  EXPECT_EQ(parser.ByteCount(), data.size());
+  TestUtil::ExpectAllFieldsSet(message);
+}
+
+TEST_P(PushParserTest, DelimitedStopsAtMessageEnd) {
+  TestAllTypes first;
+  TestUtil::SetAllFields(&first);
+  TestAllTypes second;
+  second.set_optional_int32(5);
+  const std::string data = Delimited(first) + Delimited(second);
+  const size_t chunk_size = GetParam();
+
+  TestAllTypes message;
+  PushParser parser(&message, PushParser::kDelimited);
+  size_t i = 0;
+  PushParser::Status status = PushParser::kNeedMore;
+  for (; status == PushParser::kNeedMore && i < data.size(); i += chunk_size) {
+    status = parser.Feed(absl::string_view(data).substr(i, chunk_size));
+  }
+  ASSERT_EQ(status, PushParser::kDone);
+  TestUtil::ExpectAllFieldsSet(message);
+
+  // Whatever was fed past the end belongs to the next message.
+  std::string rest(parser.Remaining());
+  if (i < data.size()) rest.append(data.substr(i));
+  EXPECT_EQ(rest, Delimited(second));
+}
+
+INSTANTIATE_TEST_SUITE_P(ChunkSizes, PushParserTest,
+                         testing::Values(1, 3, 16, 100, 100000));
+
+TEST(PushParserTest, MergesFieldsAsTheyArrive) {
+  TestAllTypes source;
+  source.set_optional_int32(7);
+  source.set_optional_string(std::string(1000, 'x'));
+  const std::string data = source.SerializeAsString();
+
+  TestAllTypes message;
+  PushParser parser(&message);
+  ASSERT_EQ(parser.Feed(absl::string_view(data).substr(0, 100)),
+            PushParser::kNeedMore);
+  EXPECT_EQ(message.optional_int32(), 7);
+  EXPECT_FALSE(message.has_optional_string());
+
+  ASSERT_EQ(parser.Feed(absl::string_view(data).substr(100)),
+            PushParser::kNeedMore);
+  EXPECT_EQ(message.optional_string().size(), 1000);
+  EXPECT_EQ(parser.Finish(), PushParser::kDone);
+}
+
+TEST(PushParserTest, EmptyDelimitedMessage) {
+  TestAllTypes message;
+  PushParser parser(&message, PushParser::kDelimited);
+  EXPECT_EQ(parser.Feed(std::string("\0\x08\x01", 3)), PushParser::kDone);
+  EXPECT_EQ(parser.ByteCount(), 0);
+  EXPECT_EQ(parser.Remaining(), "\x08\x01");
+}
+
+TEST(PushParserTest, Errors) {
+  TestAllTypes message;
+  {
+    // Truncated varint.
+    PushParser parser(&message);
+    EXPECT_EQ(parser.Feed("\x08\x80"), PushParser::kNeedMore);
+    EXPECT_EQ(parser.Finish(), PushParser::kError);
+    // The result sticks.
+    EXPECT_EQ(parser.Feed("\x01"), PushParser::kError);
+  }
+  {
+    // Unterminated group.
+    PushParser parser(&message);
+    EXPECT_EQ(parser.Feed("\x83\x01"), PushParser::kNeedMore);
+    EXPECT_EQ(parser.Finish(), PushParser::kError);
+  }
+  {
+    // End-group tag that doesn't match.
+    PushParser parser(&message);
+    EXPECT_EQ(parser.Feed("\x83\x01\x8c\x02"), PushParser::kError);
+  }
+  {
+    // Field number zero.
+    PushParser parser(&message);
+    EXPECT_EQ(parser.Feed(std::string("\x00\x01", 2)), PushParser::kError);
+  }
+  {
+    // The size prefix ends in the middle of a field.
+    PushParser parser(&message, PushParser::kDelimited);
+    EXPECT_EQ(parser.Feed("\x01\x08\x01"), PushParser::kError);
+  }
+}
+
+}  // namespace
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
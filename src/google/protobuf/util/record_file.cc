@@ -0,0 +1,567 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/record_file.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/crc/crc32c.h"
+#include "absl/log/absl_check.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/message_lite.h"
+
+#if HAVE_ZLIB
+#include "google/protobuf/io/gzip_stream.h"
+#endif
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+namespace {
+
+constexpr int kBlockSize = 64 * 1024;
+// Masked CRC32C, little-endian length and type.
+constexpr int kHeaderSize = 4 + 2 + 1;
+
+enum FragmentType {
+  // Zeros at the end of a block.
+  kZeroType = 0,
+  kFullType = 1,
+  kFirstType = 2,
+  kMiddleType = 3,
+  kLastType = 4,
+};
+// Returned by RecordReader::ReadFragment().
+constexpr int kEndOfFile = -1;
+constexpr int kBadFragment = -2;
+
+// The first byte of each chunk.
+enum ChunkKind {
+  kRecordsChunk = 1,
+  kIndexChunk = 2,
+  kTrailerChunk = 3,
+};
+// The trailer chunk holds the offset of the index chunk.
+constexpr int kTrailerSize = kHeaderSize + 1 + 8;
+
+// CRCs of data that contains CRCs are weak, so the stored ones are masked,
+// as in LevelDB.
+uint32_t Mask(uint32_t crc) {
+  return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
+}
+
+uint32_t RecordCrc(absl::string_view record) {
+  return Mask(static_cast<uint32_t>(absl::ComputeCrc32c(record)));
+}
+
+uint32_t FragmentCrc(int type, absl::string_view data) {
+  const char type_byte = static_cast<char>(type);
+  return Mask(static_cast<uint32_t>(absl::ExtendCrc32c(
+      absl::ComputeCrc32c(absl::string_view(&type_byte, 1)), data)));
+}
+
+void AppendVarint(uint64_t value, std::string* output) {
+  uint8_t buffer[io::CodedOutputStream::kMaxVarintBytes];
+  const uint8_t* end =
+      io::CodedOutputStream::WriteVarint64ToArray(value, buffer);
+  output->append(reinterpret_cast<const char*>(buffer), end - buffer);
+}
+
+void AppendFixed32(uint32_t value, std::string* output) {
+  uint8_t buffer[4];
+  io::CodedOutputStream::WriteLittleEndian32ToArray(value, buffer);
+  output->append(reinterpret_cast<const char*>(buffer), sizeof(buffer));
+}
+
+uint32_t DecodeFixed32(const char* data) {
+  uint32_t value;
+  io::CodedInputStream::ReadLittleEndian32FromArray(
+      reinterpret_cast<const uint8_t*>(data), &value);
+  return value;
+}
+
+bool ReadVarint(absl::string_view* input, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && !input->empty(); shift += 7) {
+    const uint8_t byte = static_cast<uint8_t>(input->front());
+    input->remove_prefix(1);
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+// Takes the next record of a chunk from `records`.  Returns false if the
+// chunk is malformed.
+bool NextRecord(absl::string_view* records, absl::string_view* record,
+                uint32_t* crc) {
+  uint64_t size;
+  if (!ReadVarint(records, &size) || records->size() < 4 ||
+      records->size() - 4 < size) {
+    return false;
+  }
+  *crc = DecodeFixed32(records->data());
+  *record = records->substr(4, size);
+  records->remove_prefix(4 + size);
+  return true;
+}
+
+// Parses the header of a records chunk.  If `records` is not null, also sets
+// it to the records, decompressing them into `buffer` if needed.
+bool ParseRecordsChunk(absl::string_view chunk, int64_t* record_count,
+                       absl::string_view* records, std::string* buffer) {
+  uint64_t count;
+  uint64_t size;
+  if (chunk.size() < 2 || chunk[0] != kRecordsChunk) return false;
+  const int compression = static_cast<uint8_t>(chunk[1]);
+  chunk.remove_prefix(2);
+  if (!ReadVarint(&chunk, &count) || !ReadVarint(&chunk, &size) ||
+      count > static_cast<uint64_t>(INT64_MAX)) {
+    return false;
+  }
+  *record_count = static_cast<int64_t>(count);
+  if (records == nullptr) return true;
+
+  switch (compression) {
+    case RecordWriter::NO_COMPRESSION:
+      *records = chunk;
+      return chunk.size() == size;
+#if HAVE_ZLIB
+    case RecordWriter::ZLIB: {
+      io::ArrayInputStream input(chunk.data(), static_cast<int>(chunk.size()));
+      io::GzipInputStream gzip_input(&input, io::GzipInputStream::ZLIB);
+      buffer->clear();
+      const void* data;
+      int data_size;
+      while (gzip_input.Next(&data, &data_size)) {
+        if (size - buffer->size() < static_cast<uint64_t>(data_size)) {
+          return false;
+        }
+        buffer->append(static_cast<const char*>(data), data_size);
+      }
+      *records = *buffer;
+      return buffer->size() == size &&
+             gzip_input.ZlibErrorCode() == Z_STREAM_END;
+    }
+#endif  // HAVE_ZLIB
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+// ===================================================================
+
+RecordWriter::Options::Options()
+    : chunk_size(64 << 10), compression(NO_COMPRESSION) {}
+
+RecordWriter::RecordWriter(io::ZeroCopyOutputStream* output)
+    : RecordWriter(output, Options()) {}
+
+RecordWriter::RecordWriter(io::ZeroCopyOutputStream* output,
+                           const Options& options)
+    : output_(output), options_(options) {
+  ABSL_CHECK_GT(options.chunk_size, 0);
+}
+
+RecordWriter::~RecordWriter() {
+  if (!closed_) Close();
+}
+
+bool RecordWriter::WriteRecord(absl::string_view record) {
+  ABSL_CHECK(!closed_);
+  AppendVarint(record.size(), &records_);
+  AppendFixed32(RecordCrc(record), &records_);
+  records_.append(record.data(), record.size());
+  ++records_in_chunk_;
+  ++record_count_;
+  if (records_.size() >= static_cast<size_t>(options_.chunk_size)) {
+    WriteRecordsChunk();
+  }
+  return !output_.HadError();
+}
+
+bool RecordWriter::WriteMessage(const MessageLite& message) {
+  ABSL_CHECK(!closed_);
+  const size_t size = message.ByteSizeLong();
+  if (size > static_cast<size_t>(INT_MAX)) return false;
+  AppendVarint(size, &records_);
+  // The CRC goes before the message, so it is filled in afterwards.
+  const size_t crc_position = records_.size();
+  records_.resize(crc_position + 4 + size);
+  char* data = &records_[crc_position + 4];
+  message.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(data));
+  io::CodedOutputStream::WriteLittleEndian32ToArray(
+      RecordCrc(absl::string_view(data, size)),
+      reinterpret_cast<uint8_t*>(&records_[crc_position]));
+  ++records_in_chunk_;
+  ++record_count_;
+  if (records_.size() >= static_cast<size_t>(options_.chunk_size)) {
+    WriteRecordsChunk();
+  }
+  return !output_.HadError();
+}
+
+bool RecordWriter::Flush() {
+  ABSL_CHECK(!closed_);
+  WriteRecordsChunk();
+  output_.Trim();
+  return !output_.HadError();
+}
+
+bool RecordWriter::Close() {
+  ABSL_CHECK(!closed_);
+  WriteRecordsChunk();
+  closed_ = true;
+
+  std::string index;
+  index.push_back(kIndexChunk);
+  AppendVarint(chunks_.size(), &index);
+  int64_t previous_offset = 0;
+  for (const ChunkInfo& chunk : chunks_) {
+    AppendVarint(chunk.offset - previous_offset, &index);
+    AppendVarint(chunk.record_count, &index);
+    previous_offset = chunk.offset;
+  }
+  const int64_t index_offset = offset_;
+  WriteChunk(index);
+
+  // The trailer ends the file in a single fragment, so that readers find it
+  // at a fixed distance from the end.
+  std::string trailer;
+  trailer.push_back(kTrailerChunk);
+  AppendFixed32(static_cast<uint32_t>(index_offset), &trailer);
+  AppendFixed32(static_cast<uint32_t>(index_offset >> 32), &trailer);
+  PadBlock(kTrailerSize);
+  WriteChunk(trailer);
+  output_.Trim();
+  return !output_.HadError();
+}
+
+void RecordWriter::WriteRecordsChunk() {
+  if (records_in_chunk_ == 0) return;
+  absl::string_view payload = records_;
+  Compression compression = NO_COMPRESSION;
+#if HAVE_ZLIB
+  std::string compressed;
+  if (options_.compression == ZLIB) {
+    {
+      io::StringOutputStream string_output(&compressed);
+      io::GzipOutputStream::Options gzip_options;
+      gzip_options.format = io::GzipOutputStream::ZLIB;
+      io::GzipOutputStream gzip_output(&string_output, gzip_options);
+      io::CodedOutputStream coded_output(&gzip_output);
+      coded_output.WriteRaw(records_.data(),
+                            static_cast<int>(records_.size()));
+    }
+    if (compressed.size() < records_.size()) {
+      payload = compressed;
+      compression = ZLIB;
+    }
+  }
+#endif  // HAVE_ZLIB
+
+  std::string chunk;
+  chunk.reserve(payload.size() + 2 +
+                2 * io::CodedOutputStream::kMaxVarintBytes);
+  chunk.push_back(kRecordsChunk);
+  chunk.push_back(static_cast<char>(compression));
+  AppendVarint(records_in_chunk_, &chunk);
+  AppendVarint(records_.size(), &chunk);
+  chunk.append(payload.data(), payload.size());
+  chunks_.push_back({offset_, records_in_chunk_});
+  WriteChunk(chunk);
+  records_.clear();
+  records_in_chunk_ = 0;
+}
+
+void RecordWriter::WriteChunk(absl::string_view chunk) {
+  bool first = true;
+  do {
+    PadBlock(kHeaderSize);
+    const size_t available = kBlockSize - offset_ % kBlockSize - kHeaderSize;
+    const size_t size = std::min(chunk.size(), available);
+    const bool last = size == chunk.size();
+    const int type = first && last ? kFullType
+                     : first       ? kFirstType
+                     : last        ? kLastType
+                                   : kMiddleType;
+    WriteFragment(type, chunk.substr(0, size));
+    chunk.remove_prefix(size);
+    first = false;
+  } while (!chunk.empty());
+}
+
+void RecordWriter::WriteFragment(int type, absl::string_view data) {
+  uint8_t header[kHeaderSize];
+  io::CodedOutputStream::WriteLittleEndian32ToArray(FragmentCrc(type, data),
+                                                    header);
+  header[4] = static_cast<uint8_t>(data.size() & 0xff);
+  header[5] = static_cast<uint8_t>(data.size() >> 8);
+  header[6] = static_cast<uint8_t>(type);
+  output_.WriteRaw(header, kHeaderSize);
+  output_.WriteRaw(data.data(), static_cast<int>(data.size()));
+  offset_ += kHeaderSize + static_cast<int64_t>(data.size());
+}
+
+void RecordWriter::PadBlock(int size) {
+  const int left = kBlockSize - static_cast<int>(offset_ % kBlockSize);
+  if (left >= size) return;
+  static const char kZeros[kTrailerSize] = {};
+  output_.WriteRaw(kZeros, left);
+  offset_ += left;
+}
+
+// ===================================================================
+
+RecordReader::RecordReader(absl::string_view contents) : contents_(contents) {}
+
+int RecordReader::ReadFragment(Cursor* cursor, absl::string_view* data,
+                               int64_t* offset) const {
+  const int64_t size = static_cast<int64_t>(contents_.size());
+  while (cursor->position < size) {
+    const int64_t block_left = kBlockSize - cursor->position % kBlockSize;
+    const int64_t left = std::min(block_left, size - cursor->position);
+    if (block_left < kHeaderSize) {
+      // Padding.
+      cursor->position += left;
+      continue;
+    }
+    if (left < kHeaderSize) {
+      cursor->skipped_bytes += left;
+      cursor->position += left;
+      return kBadFragment;
+    }
+    const char* header = contents_.data() + cursor->position;
+    const int length = static_cast<uint8_t>(header[4]) |
+                       (static_cast<uint8_t>(header[5]) << 8);
+    const int type = static_cast<uint8_t>(header[6]);
+    if (type == kZeroType && length == 0) {
+      // Padding before the trailer.
+      cursor->position += left;
+      continue;
+    }
+    const absl::string_view fragment =
+        contents_.substr(cursor->position + kHeaderSize, length);
+    if (kHeaderSize + length > left ||
+        DecodeFixed32(header) != FragmentCrc(type, fragment)) {
+      // The length may be corrupted too, so the rest of the block is lost.
+      cursor->skipped_bytes += left;
+      cursor->position += left;
+      return kBadFragment;
+    }
+    *data = fragment;
+    *offset = cursor->position;
+    cursor->position += kHeaderSize + length;
+    return type;
+  }
+  return kEndOfFile;
+}
+
+bool RecordReader::ReadChunk(Cursor* cursor, absl::string_view* chunk,
+                             int64_t* offset) const {
+  bool in_chunk = false;
+  while (true) {
+    absl::string_view data;
+    int64_t fragment_offset;
+    const int type = ReadFragment(cursor, &data, &fragment_offset);
+    switch (type) {
+      case kFullType:
+        if (in_chunk) cursor->skipped_bytes += cursor->fragments.size();
+        *chunk = data;
+        *offset = fragment_offset;
+        return true;
+      case kFirstType:
+        if (in_chunk) cursor->skipped_bytes += cursor->fragments.size();
+        cursor->fragments.assign(data.data(), data.size());
+        *offset = fragment_offset;
+        in_chunk = true;
+        break;
+      case kMiddleType:
+      case kLastType:
+        if (!in_chunk) {
+          // The start of the chunk was lost.
+          cursor->skipped_bytes += data.size();
+          break;
+        }
+        cursor->fragments.append(data.data(), data.size());
+        if (type == kLastType) {
+          *chunk = cursor->fragments;
+          return true;
+        }
+        break;
+      case kBadFragment:
+        // The chunk misses a piece.
+        if (in_chunk) cursor->skipped_bytes += cursor->fragments.size();
+        in_chunk = false;
+        break;
+      case kEndOfFile:
+        if (in_chunk) cursor->skipped_bytes += cursor->fragments.size();
+        return false;
+      default:
+        cursor->skipped_bytes += data.size();
+        break;
+    }
+  }
+}
+
+bool RecordReader::NextRecordsChunk(int64_t* offset) {
+  absl::string_view chunk;
+  int64_t record_count;
+  while (ReadChunk(&cursor_, &chunk, offset)) {
+    // Skips the index and the trailer.
+    if (chunk.empty() || chunk[0] != kRecordsChunk) continue;
+    if (ParseRecordsChunk(chunk, &record_count, &records_, &uncompressed_)) {
+      return true;
+    }
+    cursor_.skipped_bytes += chunk.size();
+  }
+  records_ = absl::string_view();
+  return false;
+}
+
+bool RecordReader::ReadRecord(absl::string_view* record) {
+  while (true) {
+    while (!records_.empty()) {
+      uint32_t crc;
+      if (!NextRecord(&records_, record, &crc)) {
+        cursor_.skipped_bytes += records_.size();
+        records_ = absl::string_view();
+        break;
+      }
+      if (crc == RecordCrc(*record)) return true;
+      cursor_.skipped_bytes += record->size();
+    }
+    int64_t offset;
+    if (!NextRecordsChunk(&offset)) return false;
+  }
+}
+
+bool RecordReader::ReadMessage(MessageLite* message) {
+  absl::string_view record;
+  return ReadRecord(&record) && message->ParseFromArray(
+                                    record.data(),
+                                    static_cast<int>(record.size()));
+}
+
+bool RecordReader::Seek(int64_t index) {
+  ABSL_CHECK_GE(index, 0);
+  LoadIndex();
+  records_ = absl::string_view();
+  if (index >= record_count_) {
+    cursor_.position = static_cast<int64_t>(contents_.size());
+    return index == record_count_;
+  }
+  // The last chunk that starts at or before the record.  The first one
+  // starts with record zero.
+  auto chunk = std::upper_bound(chunks_.begin(), chunks_.end(), index,
+                                [](int64_t index, const ChunkInfo& chunk) {
+                                  return index < chunk.first_record;
+                                }) -
+               1;
+  cursor_.position = chunk->offset;
+  int64_t offset;
+  if (!NextRecordsChunk(&offset) || offset != chunk->offset) {
+    records_ = absl::string_view();
+    return false;
+  }
+  absl::string_view record;
+  uint32_t crc;
+  for (int64_t i = chunk->first_record; i < index; i++) {
+    if (!NextRecord(&records_, &record, &crc)) return false;
+  }
+  return true;
+}
+
+int64_t RecordReader::record_count() {
+  LoadIndex();
+  return record_count_;
+}
+
+void RecordReader::LoadIndex() {
+  if (index_loaded_) return;
+  index_loaded_ = true;
+  if (ReadIndex()) return;
+
+  chunks_.clear();
+  record_count_ = 0;
+  Cursor cursor;
+  absl::string_view chunk;
+  int64_t offset;
+  int64_t record_count;
+  while (ReadChunk(&cursor, &chunk, &offset)) {
+    if (ParseRecordsChunk(chunk, &record_count, nullptr, nullptr)) {
+      chunks_.push_back({offset, record_count_});
+      record_count_ += record_count;
+    }
+  }
+}
+
+bool RecordReader::ReadIndex() {
+  const int64_t size = static_cast<int64_t>(contents_.size());
+  if (size < kTrailerSize) return false;
+  Cursor cursor;
+  cursor.position = size - kTrailerSize;
+  absl::string_view trailer;
+  int64_t offset;
+  if (ReadFragment(&cursor, &trailer, &offset) != kFullType ||
+      offset != size - kTrailerSize || trailer.size() != 9 ||
+      trailer[0] != kTrailerChunk) {
+    return false;
+  }
+  const int64_t index_offset =
+      DecodeFixed32(trailer.data() + 1) |
+      (static_cast<int64_t>(DecodeFixed32(trailer.data() + 5)) << 32);
+  if (index_offset < 0 || index_offset >= size) return false;
+
+  cursor = Cursor();
+  cursor.position = index_offset;
+  absl::string_view index;
+  uint64_t chunk_count;
+  if (!ReadChunk(&cursor, &index, &offset) || index.empty() ||
+      index[0] != kIndexChunk) {
+    return false;
+  }
+  index.remove_prefix(1);
+  if (!ReadVarint(&index, &chunk_count)) return false;
+  std::vector<ChunkInfo> chunks;
+  int64_t chunk_offset = 0;
+  int64_t record_count = 0;
+  for (uint64_t i = 0; i < chunk_count; i++) {
+    uint64_t delta;
+    uint64_t records;
+    if (!ReadVarint(&index, &delta) || !ReadVarint(&index, &records) ||
+        delta >= static_cast<uint64_t>(size - chunk_offset) ||
+        records > static_cast<uint64_t>(INT64_MAX - record_count)) {
+      return false;
+    }
+    chunk_offset += static_cast<int64_t>(delta);
+    chunks.push_back({chunk_offset, record_count});
+    record_count += static_cast<int64_t>(records);
+  }
+  chunks_ = std::move(chunks);
+  record_count_ = record_count;
+  return true;
+}
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
@@ -0,0 +1,219 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+// A file format for sequences of records, typically serialized messages,
+// that can be read from any record and recovers from corruption.
+//
+// Unlike the framing of delimited_message_util.h, the format has
+//   * a CRC32C of every record,
+//   * fixed-size blocks, so that a reader skips a corrupted region and picks
+//     up again at the next block,
+//   * optional compression of chunks of records,
+//   * an index at the end of the file, so that RecordReader::Seek() goes
+//     straight to any record, and several readers can split a file among
+//     them.
+//
+// The file is a sequence of 64kB blocks.  Each block holds fragments, each
+// with a 7-byte header: a masked CRC32C of its type and data, the length of
+// the data and a type saying whether it is a whole chunk or the first, a
+// middle or the last part of one.  This is the log format of LevelDB.  A
+// chunk holds a number of records, each preceded by its size and CRC32C,
+// possibly compressed with zlib.  When the writer is closed, it appends a
+// chunk with the offsets of all chunks, followed by a fixed-size trailer
+// that points to it.
+
+#ifndef GOOGLE_PROTOBUF_UTIL_RECORD_FILE_H__
+#define GOOGLE_PROTOBUF_UTIL_RECORD_FILE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message_lite.h"
+
+// Must be included last.
+#include "google/protobuf/port_def.inc"
+
+namespace google {
+namespace protobuf {
+namespace util {
+
+// Writes a record file.
+//
+//   io::FileOutputStream file(fd);
+//   RecordWriter writer(&file);
+//   for (const MyMessage& message : messages) writer.WriteMessage(message);
+//   if (!writer.Close()) { ... }
+class PROTOBUF_EXPORT RecordWriter {
+ public:
+  enum Compression {
+    NO_COMPRESSION = 0,
+    // Chunks are compressed with zlib, unless that does not make them
+    // smaller or protobuf was built without zlib.
+    ZLIB = 1,
+  };
+
+  struct PROTOBUF_EXPORT Options {
+    // Records are collected into chunks of about this many bytes before they
+    // are compressed and written.  Seek() reads a whole chunk, so smaller
+    // chunks make it cheaper while larger ones compress better.  Defaults to
+    // 64kB.
+    int chunk_size;
+
+    // Defaults to NO_COMPRESSION.
+    Compression compression;
+
+    Options();  // Initializes with default values.
+  };
+
+  // Writes to `output`, which must be at the start of the file.
+  explicit RecordWriter(io::ZeroCopyOutputStream* output);
+  RecordWriter(io::ZeroCopyOutputStream* output, const Options& options);
+  RecordWriter(const RecordWriter&) = delete;
+  RecordWriter& operator=(const RecordWriter&) = delete;
+
+  // Closes the writer if Close() was not called.
+  ~RecordWriter();
+
+  // Appends a record.  Returns false if writing to the output failed.
+  bool WriteRecord(absl::string_view record);
+
+  // Appends the serialized message, which must be initialized.
+  bool WriteMessage(const MessageLite& message);
+
+  // Writes the records written so far to the output, in a chunk of their own.
+  // Readers of the output see all of them, even if the writer is never
+  // closed.  Doing this often makes the file larger.
+  bool Flush();
+
+  // Writes the remaining records and the index.  Returns true if no error
+  // occurred.
+  bool Close();
+
+  // Number of records written.
+  int64_t record_count() const { return record_count_; }
+
+ private:
+  struct ChunkInfo {
+    int64_t offset;
+    int64_t record_count;
+  };
+
+  // Splits a chunk into fragments and writes them.
+  void WriteChunk(absl::string_view chunk);
+  // Writes the pending records as a chunk.
+  void WriteRecordsChunk();
+  void WriteFragment(int type, absl::string_view data);
+  // Pads the current block with zeros if it has less than `size` bytes left.
+  void PadBlock(int size);
+
+  io::CodedOutputStream output_;
+  const Options options_;
+  bool closed_ = false;
+  // Bytes written, since CodedOutputStream::ByteCount() is an int.
+  int64_t offset_ = 0;
+
+  // The records of the current chunk, each with its size and CRC32C.
+  std::string records_;
+  int64_t records_in_chunk_ = 0;
+  int64_t record_count_ = 0;
+  std::vector<ChunkInfo> chunks_;
+};
+
+// Reads a record file.
+//
+// The whole file is accessed through a string_view, typically a file mapped
+// with io::MmapInputStream.  Readers only read from it, so several of them
+// can read the same file on different threads:
+//
+//   // On each thread, for its share [begin, end) of the records:
+//   RecordReader reader(contents);
+//   reader.Seek(begin);
+//   for (int64_t i = begin; i < end && reader.ReadMessage(&message); i++) {
+//     ...
+//   }
+//
+// Corrupted data is skipped: either a record with a wrong CRC32C, or the rest
+// of a block with a damaged fragment, including the chunks that have
+// fragments in it.  skipped_bytes() tells how much was lost.
+class PROTOBUF_EXPORT RecordReader {
+ public:
+  // Reads `contents`, which must outlive the reader.
+  explicit RecordReader(absl::string_view contents);
+  RecordReader(const RecordReader&) = delete;
+  RecordReader& operator=(const RecordReader&) = delete;
+
+  // Reads the next record, which stays valid until the next call to a
+  // non-const method.  Returns false at the end of the file.
+  bool ReadRecord(absl::string_view* record);
+
+  // Reads the next record into `message`.  Returns false at the end of the
+  // file or if the record does not parse.
+  bool ReadMessage(MessageLite* message);
+
+  // Makes the next read return the record at `index`, counting from zero.
+  // Returns false if `index` is past the end of the file, or if the chunk of
+  // records that holds it is corrupted.
+  bool Seek(int64_t index);
+
+  // Number of records in the file.  This uses the index at the end of the
+  // file, or scans the file once if it has none, for example because the
+  // writer was not closed.
+  int64_t record_count();
+
+  // Number of bytes skipped because of corruption.  This does not count data
+  // that Seek() or record_count() saw while scanning a file without index.
+  int64_t skipped_bytes() const { return cursor_.skipped_bytes; }
+
+ private:
+  // A position in the file, and the fragments of the chunk being read.
+  struct Cursor {
+    int64_t position = 0;
+    std::string fragments;
+    int64_t skipped_bytes = 0;
+  };
+  struct ChunkInfo {
+    int64_t offset;
+    int64_t first_record;
+  };
+
+  // Returns the type of the next fragment, or a negative value at the end of
+  // the file and when corrupted data was skipped.
+  int ReadFragment(Cursor* cursor, absl::string_view* data,
+                   int64_t* offset) const;
+  // Reads the next chunk.  Returns false at the end.
+  bool ReadChunk(Cursor* cursor, absl::string_view* chunk,
+                 int64_t* offset) const;
+  // Moves on to the next valid chunk with records, setting records_ and the
+  // `offset` of the chunk.
+  bool NextRecordsChunk(int64_t* offset);
+  // Sets chunks_ from the index at the end of the file, or by scanning.
+  void LoadIndex();
+  bool ReadIndex();
+
+  const absl::string_view contents_;
+  Cursor cursor_;
+  // The records left in the current chunk, and the buffer it was
+  // decompressed to.
+  absl::string_view records_;
+  std::string uncompressed_;
+
+  bool index_loaded_ = false;
+  std::vector<ChunkInfo> chunks_;
+  int64_t record_count_ = 0;
+};
+
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
+
+#include "google/protobuf/port_undef.inc"
+
+#endif  // GOOGLE_PROTOBUF_UTIL_RECORD_FILE_H__
@@ -0,0 +1,235 @@
+// Protocol Buffers - Google's data interchange format
+// Copyright 2008 Google Inc.  All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file or at
+// https://developers.google.com/open-source/licenses/bsd
+
+#include "google/protobuf/util/record_file.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/unittest.pb.h"
+
+namespace google {
+namespace protobuf {
+namespace util {
+namespace {
+
+constexpr int kRecordCount = 5000;
+
+// Pseudo-random letters, so that the records do not compress too well.
+std::string MakeRecord(int i) {
+  std::string record = absl::StrCat(i, ":");
+  uint32_t state = static_cast<uint32_t>(i) * 2654435761u + 1;
+  for (int j = 0; j < i % 300; j++) {
+    state = state * 1103515245u + 12345u;
+    record.push_back(static_cast<char>('a' + (state >> 16) % 26));
+  }
+  return record;
+}
+
+class RecordFileTest
+    : public testing::TestWithParam<RecordWriter::Compression> {
+ protected:
+  // Writes kRecordCount records in small chunks.
+  std::string WriteFile(bool close) {
+    std::string contents;
+    io::StringOutputStream output(&contents);
+    RecordWriter::Options options;
+    options.chunk_size = 4096;
+    options.compression = GetParam();
+    RecordWriter writer(&output, options);
+    for (int i = 0; i < kRecordCount; i++) {
+      EXPECT_TRUE(writer.WriteRecord(MakeRecord(i)));
+    }
+    EXPECT_EQ(writer.record_count(), kRecordCount);
+    if (close) {
+      EXPECT_TRUE(writer.Close());
+    } else {
+      // Leaves the file without index, as if the process died.
+      EXPECT_TRUE(writer.Flush());
+    }
+    return contents;
+  }
+
+  static void ExpectRecordsFrom(RecordReader* reader, int begin) {
+    absl::string_view record;
+    for (int i = begin; i < kRecordCount; i++) {
+      ASSERT_TRUE(reader->ReadRecord(&record)) << i;
+      ASSERT_EQ(record, MakeRecord(i));
+    }
+    EXPECT_FALSE(reader->ReadRecord(&record));
+  }
+};
+
+TEST_P(RecordFileTest, ReadAll) {
+  const std::string contents = WriteFile(true);
+  RecordReader reader(contents);
+  ExpectRecordsFrom(&reader, 0);
+  EXPECT_EQ(reader.skipped_bytes(), 0);
+  EXPECT_EQ(reader.record_count(), kRecordCount);
+}
+
+TEST_P(RecordFileTest, Empty) {
+  std::string contents;
+  {
+    io::StringOutputStream output(&contents);
+    RecordWriter writer(&output);
+  }
+  RecordReader reader(contents);
+  absl::string_view record;
+  EXPECT_FALSE(reader.ReadRecord(&record));
+  EXPECT_EQ(reader.record_count(), 0);
+  EXPECT_TRUE(reader.Seek(0));
+  EXPECT_FALSE(reader.Seek(1));
+}
+
+TEST_P(RecordFileTest, LargeRecords) {
+  // Records larger than a block are split into several fragments.
+  std::vector<std::string> records = {"", std::string(200000, 'x'), "y",
+                                      std::string(65536 - 7, 'z')};
+  std::string contents;
+  {
+    io::StringOutputStream output(&contents);
+    RecordWriter::Options options;
+    options.compression = GetParam();
+    RecordWriter writer(&output, options);
+    for (const std::string& record : records) {
+      EXPECT_TRUE(writer.WriteRecord(record));
+    }
+    EXPECT_TRUE(writer.Close());
+  }
+  RecordReader reader(contents);
+  absl::string_view record;
+  for (const std::string& expected : records) {
+    ASSERT_TRUE(reader.ReadRecord(&record));
+    EXPECT_EQ(record, expected);
+  }
+  EXPECT_FALSE(reader.ReadRecord(&record));
+}
+
+TEST_P(RecordFileTest, Messages) {
+  std::string contents;
+  {
+    io::StringOutputStream output(&contents);
+    RecordWriter::Options options;
+    options.compression = GetParam();
+    RecordWriter writer(&output, options);
+    protobuf_unittest::TestAllTypes message;
+    for (int i = 0; i < 100; i++) {
+      message.set_optional_int32(i);
+      message.add_repeated_string(MakeRecord(i));
+      EXPECT_TRUE(writer.WriteMessage(message));
+    }
+    EXPECT_TRUE(writer.Close());
+  }
+  RecordReader reader(contents);
+  ASSERT_TRUE(reader.Seek(42));
+  protobuf_unittest::TestAllTypes message;
+  ASSERT_TRUE(reader.ReadMessage(&message));
+  EXPECT_EQ(message.optional_int32(), 42);
+  EXPECT_EQ(message.repeated_string_size(), 43);
+  EXPECT_EQ(message.repeated_string(42), MakeRecord(42));
+}
+
+TEST_P(RecordFileTest, Seek) {
+  const std::string contents = WriteFile(true);
+  RecordReader reader(contents);
+  for (int i : {kRecordCount - 1, 0, 1, 1234, 4321}) {
+    SCOPED_TRACE(i);
+    ASSERT_TRUE(reader.Seek(i));
+    ExpectRecordsFrom(&reader, i);
+  }
+  EXPECT_TRUE(reader.Seek(kRecordCount));
+  absl::string_view record;
+  EXPECT_FALSE(reader.ReadRecord(&record));
+  EXPECT_FALSE(reader.Seek(kRecordCount + 1));
+}
+
+TEST_P(RecordFileTest, SeekWithoutIndex) {
+  const std::string contents = WriteFile(false);
+  RecordReader reader(contents);
+  EXPECT_EQ(reader.record_count(), kRecordCount);
+  ASSERT_TRUE(reader.Seek(2500));
+  ExpectRecordsFrom(&reader, 2500);
+}
+
+TEST_P(RecordFileTest, Corruption) {
+  std::string contents = WriteFile(true);
+  ASSERT_GT(contents.size(), 3 * 65536);
+  // Damages the second block.
+  contents[65536 + 1000] ^= 1;
+
+  RecordReader reader(contents);
+  absl::string_view record;
+  int count = 0;
+  int last = -1;
+  bool ordered = true;
+  while (reader.ReadRecord(&record)) {
+    const int i = std::stoi(std::string(record.substr(0, record.find(':'))));
+    EXPECT_EQ(record, MakeRecord(i));
+    ordered &= i > last;
+    last = i;
+    count++;
+  }
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(last, kRecordCount - 1);
+  EXPECT_LT(count, kRecordCount);
+  EXPECT_GT(count, kRecordCount / 2);
+  EXPECT_GT(reader.skipped_bytes(), 0);
+}
+
+TEST_P(RecordFileTest, Truncated) {
+  std::string contents = WriteFile(true);
+  contents.resize(contents.size() / 2 + 3);
+  RecordReader reader(contents);
+  const int64_t count = reader.record_count();
+  EXPECT_GT(count, 0);
+  EXPECT_LT(count, kRecordCount);
+  ASSERT_TRUE(reader.Seek(count - 1));
+  absl::string_view record;
+  ASSERT_TRUE(reader.ReadRecord(&record));
+  EXPECT_EQ(record, MakeRecord(count - 1));
+  EXPECT_FALSE(reader.ReadRecord(&record));
+}
+
+TEST_P(RecordFileTest, ShardedReaders) {
+  const std::string contents = WriteFile(true);
+  const int kThreads = 4;
+  std::vector<int> mismatches(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      RecordReader reader(contents);
+      const int64_t begin = reader.record_count() * t / kThreads;
+      const int64_t end = reader.record_count() * (t + 1) / kThreads;
+      absl::string_view record;
+      if (!reader.Seek(begin)) mismatches[t]++;
+      for (int64_t i = begin; i < end; i++) {
+        if (!reader.ReadRecord(&record) ||
+            record != MakeRecord(static_cast<int>(i))) {
+          mismatches[t]++;
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_EQ(mismatches, std::vector<int>(kThreads));
+}
+
+INSTANTIATE_TEST_SUITE_P(RecordFileTest, RecordFileTest,
+                         testing::Values(RecordWriter::NO_COMPRESSION,
+                                         RecordWriter::ZLIB));
+
+}  // namespace
+}  // namespace util
+}  // namespace protobuf
+}  // namespace google
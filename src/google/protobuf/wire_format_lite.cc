@@ -23,6 +23,11 @@
 #include "absl/strings/str_format.h"
 #include "utf8_validity.h"
 
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // Must be included last.
 #include "google/protobuf/port_def.inc"
@@ -637,9 +642,45 @@ static size_t VarintSize(const T* data, const int n) {
       "Cannot SignExtended unsigned types");
   static_assert(!(SignExtended && ZigZag),
                 "Cannot SignExtended and ZigZag on the same type");
-  uint32_t sum = n;
-  uint32_t msb_sum = 0;
-  for (int i = 0; i < n; i++) {
+  size_t sum = n;
+  size_t msb_sum = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  // Explicit kernel for compilers that don't vectorize the loop below. SSE2
+  // only has signed compares, so flip the sign bit of both sides first.
+  const __m128i bias = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+  const __m128i limit1 = _mm_set1_epi32(static_cast<int32_t>(0x8000007F));
+  const __m128i limit2 = _mm_set1_epi32(static_cast<int32_t>(0x80003FFF));
+  const __m128i limit3 = _mm_set1_epi32(static_cast<int32_t>(0x801FFFFF));
+  const __m128i limit4 = _mm_set1_epi32(static_cast<int32_t>(0x8FFFFFFF));
+  __m128i lanes = _mm_setzero_si128();
+  __m128i msb_lanes = _mm_setzero_si128();
+  for (; n - i >= 4; i += 4) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (ZigZag) {
+      x = _mm_xor_si128(_mm_slli_epi32(x, 1), _mm_srai_epi32(x, 31));
+    } else if (SignExtended) {
+      msb_lanes = _mm_sub_epi32(msb_lanes, _mm_srai_epi32(x, 31));
+    }
+    x = _mm_xor_si128(x, bias);
+    // A true compare is -1, so subtracting it counts.
+    lanes = _mm_sub_epi32(lanes, _mm_cmpgt_epi32(x, limit1));
+    lanes = _mm_sub_epi32(lanes, _mm_cmpgt_epi32(x, limit2));
+    lanes = _mm_sub_epi32(lanes, _mm_cmpgt_epi32(x, limit3));
+    lanes = _mm_sub_epi32(lanes, _mm_cmpgt_epi32(x, limit4));
+  }
+  // A lane sees a quarter of the elements and counts at most four for each,
+  // so it can't overflow.
+  uint32_t counts[4];
+  uint32_t msb_counts[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(counts), lanes);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(msb_counts), msb_lanes);
+  for (int lane = 0; lane < 4; lane++) {
+    sum += counts[lane];
+    msb_sum += msb_counts[lane];
+  }
+#endif  // __SSE2__
+  for (; i < n; i++) {
     uint32_t x = data[i];
     if (ZigZag) {
       x = WireFormatLite::ZigZagEncode32(x);
@@ -666,7 +707,35 @@ static size_t VarintSize64(const T* data, const int n) {
   static_assert(!ZigZag || !std::is_unsigned<T>::value,
                 "Cannot ZigZag encode unsigned types");
   uint64_t sum = n;
-  for (int i = 0; i < n; i++) {
+  int i = 0;
+#if defined(__SSE4_2__)
+  // Same as above, except that a 64-bit varint has nine size classes and
+  // SSE4.2 is needed for 64-bit compares.
+  const __m128i bias = _mm_set1_epi64x(std::numeric_limits<int64_t>::min());
+  __m128i limits[9];
+  for (int k = 0; k < 9; k++) {
+    limits[k] = _mm_xor_si128(
+        _mm_set1_epi64x(static_cast<int64_t>((uint64_t{1} << (7 * (k + 1))) -
+                                             1)),
+        bias);
+  }
+  __m128i lanes = _mm_setzero_si128();
+  for (; n - i >= 2; i += 2) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    if (ZigZag) {
+      const __m128i sign = _mm_cmpgt_epi64(_mm_setzero_si128(), x);
+      x = _mm_xor_si128(_mm_slli_epi64(x, 1), sign);
+    }
+    x = _mm_xor_si128(x, bias);
+    for (int k = 0; k < 9; k++) {
+      lanes = _mm_sub_epi64(lanes, _mm_cmpgt_epi64(x, limits[k]));
+    }
+  }
+  uint64_t counts[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(counts), lanes);
+  sum += counts[0] + counts[1];
+#endif  // __SSE4_2__
+  for (; i < n; i++) {
     uint64_t x = data[i];
     if (ZigZag) {
       x = WireFormatLite::ZigZagEncode64(x);
@@ -688,8 +757,10 @@ static size_t VarintSize64(const T* data, const int n) {
 // GCC does not recognize the vectorization opportunity
 // and other platforms are untested, in those cases using the optimized
 // varint size routine for each element is faster.
-// Hence we enable it only for clang
-#if (defined(__SSE__) || defined(__aarch64__)) && defined(__clang__)
+// Hence we enable it only for clang, or where the explicit SSE2 kernel is
+// available.
+#if defined(__SSE2__) || \
+    ((defined(__SSE__) || defined(__aarch64__)) && defined(__clang__))
 size_t WireFormatLite::Int32Size(const RepeatedField<int32_t>& value) {
   return VarintSize<false, true>(value.data(), value.size());
 }
@@ -707,7 +778,7 @@ size_t WireFormatLite::EnumSize(const RepeatedField<int>& value) {
   return VarintSize<false, true>(value.data(), value.size());
 }
 
-#else  // !((defined(__SSE__) || defined(__aarch64__) && defined(__clang__))
+#else  // !(__SSE2__ || ((__SSE__ || __aarch64__) && __clang__))
 
 size_t WireFormatLite::Int32Size(const RepeatedField<int32_t>& value) {
   size_t out = 0;
@@ -747,11 +818,15 @@ size_t WireFormatLite::EnumSize(const RepeatedField<int>& value) {
 
 #endif
 
-// Micro benchmarks show that the SSE improved loop only starts beating
-// the normal loop on Haswell platforms and then only for >32 ints. We
-// disable this for now. Some specialized users might find it worthwhile to
-// enable this.
+// Micro benchmarks show that the auto-vectorized loop only starts beating
+// the normal loop on Haswell platforms and then only for >32 ints, so it is
+// only used with the explicit SSE4.2 kernel. Some specialized users might
+// find it worthwhile to enable it regardless.
+#if defined(__SSE4_2__)
+#define USE_SSE_FOR_64_BIT_INTEGER_ARRAYS 1
+#else
 #define USE_SSE_FOR_64_BIT_INTEGER_ARRAYS 0
+#endif
 #if USE_SSE_FOR_64_BIT_INTEGER_ARRAYS
 size_t WireFormatLite::Int64Size(const RepeatedField<int64_t>& value) {
   return VarintSize64<false>(value.data(), value.size());